@@ -16,4 +16,21 @@
 #include "Packets/Peripheral.h"
 #include "Packets/DecodePeripheral.h"
 #include "Packets/Power.h"
-#include "Packets/DecodePower.h"
\ No newline at end of file
+#include "Packets/DecodePower.h"
+
+// Command dispatch, request tracking, segmented transfers and bulk parameters
+#include "CANDispatch.h"
+#include "CANRequest.h"
+#include "CANTransport.h"
+#include "CANParameters.h"
+
+// Periodic transmission and synchronized motor groups
+#include "CANScheduler.h"
+#include "CANMotorGroup.h"
+
+// Device state and liveness
+#include "CANStateCache.h"
+#include "CANLiveness.h"
+
+// Firmware update
+#include "CANFirmware.h"
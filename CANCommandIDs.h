@@ -27,3 +27,11 @@
 #define CAN_COMMAND_ID__SERVO_ANGLE                ((CANCommand_t) 0x18)
 #define CAN_COMMAND_ID__POWER_STATUS              ((CANCommand_t)0x19)
 #define CAN_COMMAND_ID__POWER_STATUS_GET          ((CANCommand_t)0x1a)
+#define CAN_COMMAND_ID__BLDC_APPLY_SETPOINTS      ((CANCommand_t)0x1b)
+#define CAN_COMMAND_ID__TRANSPORT_FIRST           ((CANCommand_t)0x1c)
+#define CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE     ((CANCommand_t)0x1d)
+#define CAN_COMMAND_ID__TRANSPORT_FLOW_CONTROL    ((CANCommand_t)0x1e)
+#define CAN_COMMAND_ID__FIRMWARE_BEGIN            ((CANCommand_t)0x1f)
+#define CAN_COMMAND_ID__FIRMWARE_DATA             ((CANCommand_t)0x20)
+#define CAN_COMMAND_ID__FIRMWARE_COMMIT           ((CANCommand_t)0x21)
+#define CAN_COMMAND_ID__FIRMWARE_STATUS           ((CANCommand_t)0x22)
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "CANPacket.h"
+
+#include <stddef.h>
+
 #define CAN_UUID_BROADCAST             ((CANDeviceUUID_t)0x00)
 #define CAN_UUID_JETSON                ((CANDeviceUUID_t)0x01)
 
@@ -23,3 +27,36 @@
 
 #define CAN_UUID_DEBUG1                ((CANDeviceUUID_t)0x70)
 #define CAN_UUID_DEBUG2                ((CANDeviceUUID_t)0x71)
+
+/**
+ * Every device above except the broadcast address, as X(uuid, name) entries
+ * Used to watch all devices (see CANLiveness.h) and to name them in logs
+ */
+#define CAN_DEVICES(X)                                        \
+    X(CAN_UUID_JETSON,                "Jetson")               \
+    X(CAN_UUID_BLDC_FRONT_TIRE_LEFT,  "BLDC front tire left")  \
+    X(CAN_UUID_BLDC_FRONT_TIRE_RIGHT, "BLDC front tire right") \
+    X(CAN_UUID_BLDC_REAR_TIRE_LEFT,   "BLDC rear tire left")   \
+    X(CAN_UUID_BLDC_REAR_TIRE_RIGHT,  "BLDC rear tire right")  \
+    X(CAN_UUID_BLDC_BASE,             "BLDC base")             \
+    X(CAN_UUID_BLDC_SHOULDER,         "BLDC shoulder")         \
+    X(CAN_UUID_BLDC_ELBOW,            "BLDC elbow")            \
+    X(CAN_UUID_BLDC_FOREARM,          "BLDC forearm")          \
+    X(CAN_UUID_BLDC_WRIST_LEFT,       "BLDC wrist left")       \
+    X(CAN_UUID_BLDC_WRIST_RIGHT,      "BLDC wrist right")      \
+    X(CAN_UUID_TELEMETRY,             "Telemetry")             \
+    X(CAN_UUID_HAND,                  "Hand")                  \
+    X(CAN_UUID_DEBUG1,                "Debug 1")               \
+    X(CAN_UUID_DEBUG2,                "Debug 2")
+
+#define CAN_DEVICE_NAME_CASE(UUID, NAME) case UUID: return NAME;
+
+/**
+ * Returns the name of a device from the list above, or NULL for unknown UUIDs
+ */
+inline static const char *CANDeviceName(CANDeviceUUID_t uuid) {
+    switch (uuid) {
+        CAN_DEVICES(CAN_DEVICE_NAME_CASE)
+        default: return NULL;
+    }
+}
@@ -0,0 +1,59 @@
+#include "CANDispatch.h"
+
+#include <string.h>
+
+/**
+ * Thunk of handlers registered with CANDispatchRegisterRaw
+ */
+static void rawThunk(const CANPacket_t *packet, CANDispatchFunction_t handler, void *context) {
+    ((CANDispatchRawHandler_t)handler)(packet, context);
+}
+
+
+void CANDispatchInit(CANDispatcher_t *dispatcher) {
+    memset(dispatcher, 0, sizeof(CANDispatcher_t));
+}
+
+
+bool CANDispatchRegister(CANDispatcher_t *dispatcher, CANCommand_t command, CANDispatchThunk_t thunk,
+                         CANDispatchFunction_t handler, void *context, uint8_t minLength, uint8_t maxLength) {
+    if (!dispatcher || minLength > maxLength || maxLength > sizeof(((CANPacket_t *)0)->contents)) {
+        return false;
+    }
+
+    CANDispatchEntry_t *entry = &dispatcher->entries[command & 0x7F];
+    entry->thunk = thunk;
+    entry->handler = thunk ? handler : NULL;
+    entry->context = thunk ? context : NULL;
+    entry->minLength = minLength;
+    entry->maxLength = maxLength;
+    return true;
+}
+
+
+bool CANDispatchRegisterRaw(CANDispatcher_t *dispatcher, CANCommand_t command, CANDispatchRawHandler_t handler,
+                            void *context, uint8_t minLength, uint8_t maxLength) {
+    return CANDispatchRegister(dispatcher, command, handler ? rawThunk : NULL,
+                               (CANDispatchFunction_t)handler, context, minLength, maxLength);
+}
+
+
+uint16_t CANDispatchBatch(CANDispatcher_t *dispatcher, const CANPacket_t *packets, uint16_t count) {
+    uint16_t handled = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        handled += CANDispatch(dispatcher, &packets[i]) == CAN_DISPATCH_HANDLED;
+    }
+    return handled;
+}
+
+
+uint16_t CANDispatchDrain(CANDispatcher_t *dispatcher, CANHandle_t CANHandle) {
+    CANPacket_t packets[CAN_DISPATCH_DRAIN_BATCH];
+    uint16_t handled = 0;
+    uint16_t received;
+    do {
+        received = CANReceiveBatch(CANHandle, packets, CAN_DISPATCH_DRAIN_BATCH);
+        handled += CANDispatchBatch(dispatcher, packets, received);
+    } while (received == CAN_DISPATCH_DRAIN_BATCH);
+    return handled;
+}
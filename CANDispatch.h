@@ -0,0 +1,166 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Packets/DecodeUniversal.h"
+#include "Packets/DecodeMotor.h"
+#include "Packets/DecodePeripheral.h"
+#include "Packets/DecodePower.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the command dispatcher
+ * Instead of a switch over packet.command, handlers are registered per command in a table indexed by
+ * the command id (with the acknowledgement bit stripped), so dispatching a packet is one lookup and one call.
+ * The dispatcher checks the contents length the command requires, decodes the packet and calls a typed handler:
+ *
+ *   static void onVelocity(const CANMotorPacket_BLDC_SetInputVelocity_Decoded_t *decoded,
+ *                          const CANPacket_t *packet, void *context) { ... }
+ *
+ *   CANDispatcher_t dispatcher;
+ *   CANDispatchInit(&dispatcher);
+ *   CANMotorPacket_BLDC_SetInputVelocity_Register(&dispatcher, onVelocity, NULL);
+ *   ...
+ *   CANDispatchDrain(&dispatcher, handle);
+ *
+ * The packet is passed along with the decoded struct so the handler can check CAN_ACK and reply to the sender.
+ */
+
+/**
+ * Number of table entries, one per command id without the acknowledgement bit
+ */
+#define CAN_DISPATCH_TABLE_SIZE 128
+
+/**
+ * Number of packets CANDispatchDrain receives per CANReceiveBatch call
+ */
+#ifndef CAN_DISPATCH_DRAIN_BATCH
+#define CAN_DISPATCH_DRAIN_BATCH 16
+#endif
+
+/**
+ * Results of CANDispatch
+ */
+#define CAN_DISPATCH_HANDLED      1
+#define CAN_DISPATCH_UNHANDLED    0  // no handler registered for the command
+#define CAN_DISPATCH_BAD_LENGTH  -1  // contentsLength is not valid for the command, the handler was not called
+
+/**
+ * Generic function pointer the typed handlers are stored as, only ever called after casting back
+ */
+typedef void (*CANDispatchFunction_t)(void);
+
+/**
+ * Decodes the packet and calls the handler with the type it was registered with
+ */
+typedef void (*CANDispatchThunk_t)(const CANPacket_t *packet, CANDispatchFunction_t handler, void *context);
+
+/**
+ * Handler receiving the packet undecoded, see CANDispatchRegisterRaw
+ */
+typedef void (*CANDispatchRawHandler_t)(const CANPacket_t *packet, void *context);
+
+typedef struct {
+    CANDispatchThunk_t thunk; // NULL if no handler is registered
+    CANDispatchFunction_t handler;
+    void *context;
+    uint8_t minLength;
+    uint8_t maxLength;
+} CANDispatchEntry_t;
+
+typedef struct {
+    CANDispatchEntry_t entries[CAN_DISPATCH_TABLE_SIZE];
+    uint32_t handled;
+    uint32_t unhandled;
+    uint32_t badLength;
+} CANDispatcher_t;
+
+/**
+ * Clears every handler and counter
+ */
+void CANDispatchInit(CANDispatcher_t *dispatcher);
+
+/**
+ * Installs a handler for a command, replacing any previous one
+ * Normally called through the typed <packet>_Register functions below
+ * @param dispatcher Dispatcher to register with
+ * @param command Command id, the acknowledgement bit is ignored
+ * @param thunk Function decoding the packet and calling handler, NULL removes the handler
+ * @param handler Passed to the thunk
+ * @param context Passed to the handler
+ * @param minLength Smallest contentsLength accepted
+ * @param maxLength Largest contentsLength accepted
+ * @return false if the arguments are invalid
+ */
+bool CANDispatchRegister(CANDispatcher_t *dispatcher, CANCommand_t command, CANDispatchThunk_t thunk,
+                         CANDispatchFunction_t handler, void *context, uint8_t minLength, uint8_t maxLength);
+
+/**
+ * Installs a handler receiving the packet as is, for commands without a decoder
+ */
+bool CANDispatchRegisterRaw(CANDispatcher_t *dispatcher, CANCommand_t command, CANDispatchRawHandler_t handler,
+                            void *context, uint8_t minLength, uint8_t maxLength);
+
+/**
+ * Removes the handler of a command
+ */
+inline static void CANDispatchUnregister(CANDispatcher_t *dispatcher, CANCommand_t command) {
+    CANDispatchRegister(dispatcher, command, NULL, NULL, NULL, 0, 0);
+}
+
+/**
+ * Calls the handler registered for the packet's command
+ * @return CAN_DISPATCH_HANDLED, CAN_DISPATCH_UNHANDLED or CAN_DISPATCH_BAD_LENGTH
+ */
+inline static int8_t CANDispatch(CANDispatcher_t *dispatcher, const CANPacket_t *packet) {
+    const CANDispatchEntry_t *entry = &dispatcher->entries[packet->command & 0x7F];
+    if (!entry->thunk) {
+        ++dispatcher->unhandled;
+        return CAN_DISPATCH_UNHANDLED;
+    }
+    if (packet->contentsLength < entry->minLength || packet->contentsLength > entry->maxLength) {
+        ++dispatcher->badLength;
+        return CAN_DISPATCH_BAD_LENGTH;
+    }
+    ++dispatcher->handled;
+    entry->thunk(packet, entry->handler, entry->context);
+    return CAN_DISPATCH_HANDLED;
+}
+
+/**
+ * Dispatches every packet of an array, e.g. one filled by CANReceiveBatch
+ * @return Number of packets a handler was called for
+ */
+uint16_t CANDispatchBatch(CANDispatcher_t *dispatcher, const CANPacket_t *packets, uint16_t count);
+
+/**
+ * Receives and dispatches packets until the port has none left
+ * @param dispatcher Dispatcher to use
+ * @param CANHandle Handle previously passed to CANInit
+ * @return Number of packets a handler was called for
+ */
+uint16_t CANDispatchDrain(CANDispatcher_t *dispatcher, CANHandle_t CANHandle);
+
+
+/**
+ * Defines the handler type, thunk and registration function of one packet from Schema.h
+ * For each packet, <packet>_Handler_t is the handler type and <packet>_Register installs one
+ * The accepted contents lengths come from the schema
+ */
+#define CAN_DISPATCH_DEFINE(NAME, COMMAND, KIND, FLAGS, TAIL)                                                      \
+    typedef void (*NAME##_Handler_t)(const NAME##_Decoded_t *decoded, const CANPacket_t *packet, void *context);  \
+                                                                                                                  \
+    inline static void NAME##_DispatchThunk(const CANPacket_t *packet, CANDispatchFunction_t handler, void *context) { \
+        NAME##_Decoded_t decoded = NAME##_Decode(packet);                                                         \
+        ((NAME##_Handler_t)handler)(&decoded, packet, context);                                                   \
+    }                                                                                                             \
+                                                                                                                  \
+    inline static bool NAME##_Register(CANDispatcher_t *dispatcher, NAME##_Handler_t handler, void *context) {    \
+        return CANDispatchRegister(dispatcher, COMMAND, handler ? NAME##_DispatchThunk : NULL,                    \
+                                   (CANDispatchFunction_t)handler, context, NAME##_LENGTH - (TAIL), NAME##_LENGTH); \
+    }
+
+CAN_SCHEMA(CAN_DISPATCH_DEFINE)
@@ -0,0 +1,290 @@
+#include "CANFilter.h"
+
+#include <string.h>
+
+// Bit positions of specific address portions for filter detection
+#define UUID_POS      3
+#define ID_MASK       0x7FF
+
+// A subscription expands to at most one UUID term and one term per domain
+#define MAX_TERMS     (CAN_FILTER_MAX_SUBSCRIPTIONS * 4)
+
+/**
+ * A mask filter: accepts identifiers whose bits selected by mask equal id
+ */
+typedef struct {
+    uint16_t id;
+    uint16_t mask;
+} Term_t;
+
+
+static uint32_t bitCount(uint16_t value) {
+    uint32_t count = 0;
+    for (; value; value &= value - 1) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * Number of identifiers the term accepts
+ */
+static uint32_t termSize(Term_t term) {
+    return 1u << (11 - bitCount(term.mask));
+}
+
+/**
+ * Returns whether every identifier accepted by b is also accepted by a
+ */
+static bool termSubsumes(Term_t a, Term_t b) {
+    return !(a.mask & ~b.mask) && !((a.id ^ b.id) & a.mask);
+}
+
+/**
+ * Returns whether the identifiers not cared about form the low bits, making the term an interval
+ */
+static bool termIsInterval(Term_t term) {
+    uint16_t free = ~term.mask & ID_MASK;
+    return !(free & (free + 1));
+}
+
+/**
+ * Smallest term accepting everything either term accepts
+ */
+static Term_t termMerge(Term_t a, Term_t b) {
+    Term_t merged;
+    merged.mask = a.mask & b.mask & ~(a.id ^ b.id);
+    merged.id = a.id & merged.mask;
+    return merged;
+}
+
+static uint32_t removeTerm(Term_t *terms, uint32_t count, uint32_t index) {
+    terms[index] = terms[count - 1];
+    return count - 1;
+}
+
+/**
+ * Drops terms accepting nothing beyond another term
+ */
+static uint32_t removeSubsumed(Term_t *terms, uint32_t count) {
+    uint32_t i = 0;
+    while (i < count) {
+        bool redundant = false;
+        for (uint32_t j = 0; j < count && !redundant; ++j) {
+            // Of two identical terms only the later one is dropped
+            redundant = j != i && termSubsumes(terms[j], terms[i]) && (j < i || !termSubsumes(terms[i], terms[j]));
+        }
+        if (redundant) {
+            count = removeTerm(terms, count, i);
+        } else {
+            ++i;
+        }
+    }
+    return count;
+}
+
+/**
+ * Repeatedly merges pairs of terms with the same mask whose ids differ in exactly one cared bit
+ * The merged term accepts exactly the union of the pair, so nothing extra gets through
+ */
+static uint32_t mergeAdjacent(Term_t *terms, uint32_t count) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        count = removeSubsumed(terms, count);
+        for (uint32_t i = 0; i < count && !merged; ++i) {
+            for (uint32_t j = i + 1; j < count && !merged; ++j) {
+                uint16_t difference = terms[i].id ^ terms[j].id;
+                if (terms[i].mask == terms[j].mask && bitCount(difference) == 1) {
+                    terms[i] = termMerge(terms[i], terms[j]);
+                    count = removeTerm(terms, count, j);
+                    merged = true;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Merges the pair of terms whose union lets the fewest unsubscribed identifiers through
+ */
+static uint32_t mergeCheapest(Term_t *terms, uint32_t count) {
+    uint32_t bestI = 0;
+    uint32_t bestJ = 1;
+    uint32_t bestCost = UINT32_MAX;
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = i + 1; j < count; ++j) {
+            uint32_t overlap = 0;
+            if (!((terms[i].id ^ terms[j].id) & terms[i].mask & terms[j].mask)) {
+                Term_t intersection = {terms[i].id | terms[j].id, terms[i].mask | terms[j].mask};
+                overlap = termSize(intersection);
+            }
+            uint32_t cost = termSize(termMerge(terms[i], terms[j])) -
+                            (termSize(terms[i]) + termSize(terms[j]) - overlap);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestI = i;
+                bestJ = j;
+            }
+        }
+    }
+    terms[bestI] = termMerge(terms[bestI], terms[bestJ]);
+    return removeTerm(terms, count, bestJ);
+}
+
+/**
+ * Orders interval terms first, by their lowest identifier
+ */
+static void sortTerms(Term_t *terms, uint32_t count) {
+    for (uint32_t i = 1; i < count; ++i) {
+        Term_t term = terms[i];
+        uint32_t j = i;
+        while (j > 0) {
+            Term_t previous = terms[j - 1];
+            bool before = termIsInterval(term) && (!termIsInterval(previous) || term.id < previous.id);
+            if (!before) {
+                break;
+            }
+            terms[j] = previous;
+            --j;
+        }
+        terms[j] = term;
+    }
+}
+
+/**
+ * Converts the terms into filter elements, returns how many are needed
+ * Elements are only written while they fit into plan, so this also sizes a candidate set
+ */
+static uint32_t emitFilters(Term_t *terms, uint32_t count, CANFilterPlan_t *plan) {
+    uint32_t emitted = 0;
+    sortTerms(terms, count);
+
+    // Runs of touching intervals become one range filter
+    bool single[MAX_TERMS];
+    uint32_t i = 0;
+    while (i < count && termIsInterval(terms[i])) {
+        uint16_t low = terms[i].id;
+        uint16_t high = terms[i].id | (~terms[i].mask & ID_MASK);
+        uint32_t run = i + 1;
+        while (run < count && termIsInterval(terms[run]) && terms[run].id <= high + 1) {
+            uint16_t end = terms[run].id | (~terms[run].mask & ID_MASK);
+            high = end > high ? end : high;
+            ++run;
+        }
+        if (run - i > 1) {
+            if (emitted < CAN_FILTER_MAX_FILTERS) {
+                plan->filters[emitted] = (CANFilter_t){CAN_FILTER_RANGE, low, high};
+            }
+            ++emitted;
+            for (; i < run; ++i) {
+                single[i] = false;
+            }
+        } else {
+            single[i++] = true;
+        }
+    }
+    for (; i < count; ++i) {
+        single[i] = true;
+    }
+
+    // Single identifiers share dual filters, everything else is a mask filter
+    int32_t pendingExact = -1;
+    for (i = 0; i < count; ++i) {
+        if (!single[i]) {
+            continue;
+        }
+        if (terms[i].mask == ID_MASK) {
+            if (pendingExact < 0) {
+                pendingExact = (int32_t)i;
+                continue;
+            }
+            if (emitted < CAN_FILTER_MAX_FILTERS) {
+                plan->filters[emitted] = (CANFilter_t){CAN_FILTER_DUAL, terms[pendingExact].id, terms[i].id};
+            }
+            pendingExact = -1;
+        } else if (emitted < CAN_FILTER_MAX_FILTERS) {
+            plan->filters[emitted] = (CANFilter_t){CAN_FILTER_MASK, terms[i].id, terms[i].mask};
+        }
+        ++emitted;
+    }
+    if (pendingExact >= 0) {
+        if (emitted < CAN_FILTER_MAX_FILTERS) {
+            plan->filters[emitted] = (CANFilter_t){CAN_FILTER_MASK, terms[pendingExact].id, ID_MASK};
+        }
+        ++emitted;
+    }
+    return emitted;
+}
+
+
+bool CANFilterPlan(CANFilterPlan_t *plan, const CANDevice_t *subscriptions, uint8_t count, uint8_t maxFilters) {
+    if (!plan || (!subscriptions && count) || count > CAN_FILTER_MAX_SUBSCRIPTIONS ||
+        maxFilters == 0 || maxFilters > CAN_FILTER_MAX_FILTERS) {
+        return false;
+    }
+
+    Term_t terms[MAX_TERMS];
+    uint32_t termCount = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        const CANDevice_t *device = &subscriptions[i];
+        bool anyDomain = device->peripheralDomain || device->motorDomain || device->powerDomain;
+        if (device->deviceUUID || !anyDomain) {
+            terms[termCount++] = (Term_t){device->deviceUUID << UUID_POS, 0x7F << UUID_POS};
+        }
+        if (device->peripheralDomain) {
+            terms[termCount++] = (Term_t){0x01, (0x7F << UUID_POS) | 0x01};
+        }
+        if (device->motorDomain) {
+            terms[termCount++] = (Term_t){0x02, (0x7F << UUID_POS) | 0x02};
+        }
+        if (device->powerDomain) {
+            terms[termCount++] = (Term_t){0x04, (0x7F << UUID_POS) | 0x04};
+        }
+    }
+
+    plan->exact = true;
+    termCount = mergeAdjacent(terms, termCount);
+    while (emitFilters(terms, termCount, plan) > maxFilters) {
+        termCount = mergeAdjacent(terms, mergeCheapest(terms, termCount));
+        plan->exact = false;
+    }
+    plan->count = emitFilters(terms, termCount, plan);
+    return true;
+}
+
+
+bool CANFilterAccepts(const CANFilterPlan_t *plan, uint16_t identifier) {
+    for (uint8_t i = 0; i < plan->count; ++i) {
+        const CANFilter_t *filter = &plan->filters[i];
+        switch (filter->type) {
+            case CAN_FILTER_RANGE:
+                if (identifier >= filter->id1 && identifier <= filter->id2) {
+                    return true;
+                }
+                break;
+            case CAN_FILTER_DUAL:
+                if (identifier == filter->id1 || identifier == filter->id2) {
+                    return true;
+                }
+                break;
+            case CAN_FILTER_MASK:
+                if ((identifier & filter->id2) == filter->id1) {
+                    return true;
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+
+void CANFilterBitmap(const CANFilterPlan_t *plan, uint32_t bitmap[CAN_FILTER_BITMAP_WORDS]) {
+    memset(bitmap, 0, CAN_FILTER_BITMAP_WORDS * sizeof(uint32_t));
+    for (uint16_t identifier = 0; identifier <= ID_MASK; ++identifier) {
+        if (CANFilterAccepts(plan, identifier)) {
+            bitmap[identifier >> 5] |= 1u << (identifier & 0x1F);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CANPacket.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the acceptance filter planner
+ * A node lists the devices it wants to hear (itself first, then any peers) and the planner turns them
+ * into the smallest set of FDCAN standard filters that accepts exactly those identifiers.
+ * The plan is installed with CANConfigureFilters (see Port.h), which replaces the filters set up by CANInit.
+ *
+ * A subscription accepts the same frames a node with that CANDevice_t accepts after CANInit:
+ * frames addressed to its UUID and broadcasts (UUID 0) to each of its declared domains, at either priority.
+ * A subscription with UUID 0 and no domains accepts every broadcast.
+ */
+
+/**
+ * Size of the FDCAN standard filter list on the STM32G4, the largest budget a plan can use
+ */
+#define CAN_FILTER_MAX_FILTERS       28
+
+/**
+ * Maximum number of subscriptions passed to CANFilterPlan at once
+ */
+#define CAN_FILTER_MAX_SUBSCRIPTIONS 32
+
+/**
+ * Number of 32 bit words in a bitmap covering the 11 bit identifier space
+ */
+#define CAN_FILTER_BITMAP_WORDS      (2048 / 32)
+
+/**
+ * Filter element types, the values match the FDCAN standard filter type (SFT) encoding
+ */
+SMALL_ENUM {
+    CAN_FILTER_RANGE = 0, // accepts id1 <= identifier <= id2
+    CAN_FILTER_DUAL,      // accepts identifier == id1 or identifier == id2
+    CAN_FILTER_MASK       // accepts (identifier & id2) == id1
+} CANFilterType_t;
+
+/**
+ * One hardware filter element
+ */
+typedef struct {
+    CANFilterType_t type;
+    uint16_t id1;
+    uint16_t id2;
+} CANFilter_t;
+
+/**
+ * Result of CANFilterPlan
+ * If the subscriptions did not fit the budget, filters were widened until they did and exact is false:
+ * every subscribed identifier is still accepted, but some others are too and need filtering in software
+ */
+typedef struct {
+    uint8_t count;
+    bool exact;
+    CANFilter_t filters[CAN_FILTER_MAX_FILTERS];
+} CANFilterPlan_t;
+
+/**
+ * Computes the filters accepting the given subscriptions
+ * Redundant filters are dropped, filters differing in a single bit are merged (Quine-McCluskey style),
+ * single identifiers are paired into dual filters and adjacent identifier intervals into range filters.
+ * @param plan Filled with the result
+ * @param subscriptions Devices to accept frames for
+ * @param count Number of subscriptions (at most CAN_FILTER_MAX_SUBSCRIPTIONS)
+ * @param maxFilters Number of filter elements available (1 - CAN_FILTER_MAX_FILTERS)
+ * @return false if the arguments are out of range
+ */
+bool CANFilterPlan(CANFilterPlan_t *plan, const CANDevice_t *subscriptions, uint8_t count, uint8_t maxFilters);
+
+/**
+ * Returns whether the plan's filters accept the identifier
+ */
+bool CANFilterAccepts(const CANFilterPlan_t *plan, uint16_t identifier);
+
+/**
+ * Expands the plan into a bitmap with one bit per 11 bit identifier, for ports filtering in software
+ * @param plan Plan to expand
+ * @param bitmap Filled with the accepted identifiers, bit (identifier % 32) of word (identifier / 32)
+ */
+void CANFilterBitmap(const CANFilterPlan_t *plan, uint32_t bitmap[CAN_FILTER_BITMAP_WORDS]);
+
+/**
+ * Looks up an identifier in a bitmap filled by CANFilterBitmap
+ */
+inline static bool CANFilterBitmapAccepts(const uint32_t *bitmap, uint16_t identifier) {
+    return (bitmap[(identifier >> 5) & (CAN_FILTER_BITMAP_WORDS - 1)] >> (identifier & 0x1F)) & 1;
+}
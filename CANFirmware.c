@@ -0,0 +1,363 @@
+#include "CANFirmware.h"
+
+#include <string.h>
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+#include "stm32g4xx_hal.h"
+#endif
+
+// States of the streamer
+#define STREAM_IDLE      0
+#define STREAM_BEGIN     1 // waiting for the status answering FirmwareBegin
+#define STREAM_STREAMING 2
+#define STREAM_DONE      3
+
+// CRC-32 of each nibble value, reflected polynomial 0xEDB88320
+static const uint32_t crcNibbles[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t CANFirmwareCRC(uint32_t crc, const uint8_t *data, uint32_t length) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; ++i) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crcNibbles[crc & 0x0F];
+        crc = (crc >> 4) ^ crcNibbles[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+/**
+ * Length of the block starting at an offset, the last block of an image may be short
+ */
+static uint32_t blockLength(uint32_t imageSize, uint32_t offset) {
+    uint32_t remaining = imageSize - offset;
+    return remaining < CAN_FIRMWARE_BLOCK_SIZE ? remaining : CAN_FIRMWARE_BLOCK_SIZE;
+}
+
+
+// Receiver
+
+static void sendStatus(CANFirmwareReceiver_t *receiver, uint8_t status, uint32_t offset) {
+    receiver->status = status;
+    CANPacket_t packet = CANUniversalPacket_FirmwareStatus(receiver->self, receiver->host, status,
+                                                           CAN_FIRMWARE_WINDOW, offset);
+    receiver->statusPending = CANSend(receiver->handle, &packet) != CAN_OK;
+}
+
+static uint8_t *blockBuffer(CANFirmwareReceiver_t *receiver, uint32_t offset) {
+    return receiver->buffers[(offset / CAN_FIRMWARE_BLOCK_SIZE) % CAN_FIRMWARE_WINDOW];
+}
+
+
+void CANFirmwareReceiverInit(CANFirmwareReceiver_t *receiver, CANHandle_t CANHandle, CANDevice_t self,
+                             CANFirmwareFlash_t flash, uint32_t capacity) {
+    memset(receiver, 0, sizeof(CANFirmwareReceiver_t));
+    receiver->handle = CANHandle;
+    receiver->self = self;
+    receiver->flash = flash;
+    receiver->capacity = capacity;
+}
+
+
+static void handleBegin(CANFirmwareReceiver_t *receiver, const CANPacket_t *packet) {
+    CANUniversalPacket_FirmwareBegin_Decoded_t begin = CANUniversalPacket_FirmwareBegin_Decode(packet);
+    receiver->host = begin.sender;
+    if (begin.imageSize > receiver->capacity) {
+        receiver->active = false;
+        sendStatus(receiver, CAN_FIRMWARE_STATUS_TOO_LARGE, 0);
+        return;
+    }
+
+    if (!receiver->active || begin.imageSize != receiver->imageSize || begin.imageTag != receiver->imageTag) {
+        receiver->active = true;
+        receiver->imageSize = begin.imageSize;
+        receiver->imageTag = begin.imageTag;
+        receiver->flashed = 0;
+        receiver->flashedCRC = 0;
+    }
+    // Blocks verified but not flashed yet are dropped, so the host's window starts out empty
+    receiver->verified = receiver->flashed;
+    receiver->verifiedCRC = receiver->flashedCRC;
+    receiver->received = 0;
+    receiver->synced = true;
+    sendStatus(receiver, CAN_FIRMWARE_STATUS_OK, receiver->flashed);
+}
+
+/**
+ * Rejects the block being received, data is ignored until the host restarts with FirmwareBegin
+ */
+static void rejectBlock(CANFirmwareReceiver_t *receiver) {
+    receiver->synced = false;
+    ++receiver->badBlocks;
+    sendStatus(receiver, CAN_FIRMWARE_STATUS_BAD_BLOCK, receiver->flashed);
+}
+
+static void handleData(CANFirmwareReceiver_t *receiver, const CANPacket_t *packet) {
+    if (!receiver->synced || receiver->verified - receiver->flashed >= CAN_FIRMWARE_WINDOW * CAN_FIRMWARE_BLOCK_SIZE) {
+        return;
+    }
+
+    CANUniversalPacket_FirmwareData_Decoded_t data = CANUniversalPacket_FirmwareData_Decode(packet);
+    uint32_t length = blockLength(receiver->imageSize, receiver->verified);
+    if (data.dataLength > length - receiver->received) {
+        // More data than the block holds, its commit was lost or the host sent too much
+        rejectBlock(receiver);
+        return;
+    }
+    memcpy(blockBuffer(receiver, receiver->verified) + receiver->received, data.data, data.dataLength);
+    receiver->received += data.dataLength;
+}
+
+static void handleCommit(CANFirmwareReceiver_t *receiver, const CANPacket_t *packet) {
+    if (!receiver->synced) {
+        return;
+    }
+
+    CANUniversalPacket_FirmwareCommit_Decoded_t commit = CANUniversalPacket_FirmwareCommit_Decode(packet);
+    uint32_t length = blockLength(receiver->imageSize, receiver->verified);
+    uint8_t *buffer = blockBuffer(receiver, receiver->verified);
+    uint32_t crc = receiver->received == length ? CANFirmwareCRC(receiver->verifiedCRC, buffer, length) : 0;
+    if (length == 0 || commit.block != receiver->verified / CAN_FIRMWARE_BLOCK_SIZE ||
+        receiver->received != length || crc != commit.crc) {
+        rejectBlock(receiver);
+        return;
+    }
+
+    receiver->blockCRC[(receiver->verified / CAN_FIRMWARE_BLOCK_SIZE) % CAN_FIRMWARE_WINDOW] = crc;
+    receiver->verified += length;
+    receiver->verifiedCRC = crc;
+    receiver->received = 0;
+}
+
+
+bool CANFirmwareReceiverHandlePacket(CANFirmwareReceiver_t *receiver, const CANPacket_t *packet) {
+    CANCommand_t command = packet->command & 0x7F;
+    if (command != CAN_COMMAND_ID__FIRMWARE_BEGIN && command != CAN_COMMAND_ID__FIRMWARE_DATA &&
+        command != CAN_COMMAND_ID__FIRMWARE_COMMIT) {
+        return false;
+    }
+    if (packet->contentsLength < CANSchemaMinLength(command)) {
+        return true;
+    }
+
+    if (command == CAN_COMMAND_ID__FIRMWARE_BEGIN) {
+        handleBegin(receiver, packet);
+    } else if (receiver->active && packet->senderUUID == receiver->host.deviceUUID) {
+        if (command == CAN_COMMAND_ID__FIRMWARE_DATA) {
+            handleData(receiver, packet);
+        } else {
+            handleCommit(receiver, packet);
+        }
+    }
+    return true;
+}
+
+
+void CANFirmwareReceiverPoll(CANFirmwareReceiver_t *receiver) {
+    if (receiver->statusPending) {
+        sendStatus(receiver, receiver->status, receiver->flashed);
+    }
+    if (!receiver->active || receiver->flashed == receiver->verified) {
+        return;
+    }
+
+    uint32_t length = blockLength(receiver->imageSize, receiver->flashed);
+    uint8_t *buffer = blockBuffer(receiver, receiver->flashed);
+    if (receiver->flash.write(receiver->flash.context, receiver->flashed, buffer, length) != CAN_OK) {
+        receiver->active = false;
+        receiver->synced = false;
+        sendStatus(receiver, CAN_FIRMWARE_STATUS_FLASH_ERROR, receiver->flashed);
+        return;
+    }
+    receiver->flashedCRC = receiver->blockCRC[(receiver->flashed / CAN_FIRMWARE_BLOCK_SIZE) % CAN_FIRMWARE_WINDOW];
+    receiver->flashed += length;
+    sendStatus(receiver, CAN_FIRMWARE_STATUS_OK, receiver->flashed);
+}
+
+
+// Streamer
+
+static void finishStream(CANFirmwareStreamer_t *streamer, uint8_t status) {
+    streamer->state = STREAM_DONE;
+    if (streamer->callback) {
+        streamer->callback(status, streamer->context);
+    }
+}
+
+static void sendBegin(CANFirmwareStreamer_t *streamer) {
+    CANPacket_t begin = CANUniversalPacket_FirmwareBegin(streamer->self, streamer->device, streamer->size, streamer->tag);
+    streamer->beginPending = CANSend(streamer->handle, &begin) != CAN_OK;
+    streamer->deadline = CANGetTimestamp(streamer->handle) + streamer->timeout;
+}
+
+/**
+ * Goes back to FirmwareBegin, the device answers with the offset to continue at
+ */
+static void restart(CANFirmwareStreamer_t *streamer, uint8_t failure) {
+    if (streamer->retries++ == CAN_FIRMWARE_RETRIES) {
+        finishStream(streamer, failure);
+        return;
+    }
+    ++streamer->resumes;
+    streamer->state = STREAM_BEGIN;
+    sendBegin(streamer);
+}
+
+
+void CANFirmwareStreamStart(CANFirmwareStreamer_t *streamer, CANHandle_t CANHandle, CANDevice_t self,
+                            CANDevice_t device, const uint8_t *image, uint32_t size, uint16_t tag,
+                            uint32_t timeoutMicros, CANFirmwareStreamCallback_t callback, void *context) {
+    memset(streamer, 0, sizeof(CANFirmwareStreamer_t));
+    streamer->handle = CANHandle;
+    streamer->self = self;
+    streamer->device = device;
+    streamer->image = image;
+    streamer->size = size;
+    streamer->tag = tag;
+    streamer->timeout = (CANTimestamp_t)timeoutMicros * CANGetTimestampFrequency(CANHandle) / 1000000u;
+    streamer->callback = callback;
+    streamer->context = context;
+    streamer->state = STREAM_BEGIN;
+    sendBegin(streamer);
+}
+
+
+bool CANFirmwareStreamHandlePacket(CANFirmwareStreamer_t *streamer, const CANPacket_t *packet) {
+    if ((packet->command & 0x7F) != CAN_COMMAND_ID__FIRMWARE_STATUS ||
+        packet->senderUUID != streamer->device.deviceUUID ||
+        packet->contentsLength < CANUniversalPacket_FirmwareStatus_LENGTH) {
+        return false;
+    }
+    if (streamer->state != STREAM_BEGIN && streamer->state != STREAM_STREAMING) {
+        return true;
+    }
+
+    CANUniversalPacket_FirmwareStatus_Decoded_t status = CANUniversalPacket_FirmwareStatus_Decode(packet);
+    switch (status.status) {
+        case CAN_FIRMWARE_STATUS_OK:
+            if (status.offset > streamer->size || (status.offset % CAN_FIRMWARE_BLOCK_SIZE && status.offset != streamer->size)) {
+                finishStream(streamer, CAN_ERROR);
+                break;
+            }
+            streamer->deadline = CANGetTimestamp(streamer->handle) + streamer->timeout;
+            streamer->flashed = status.offset;
+            if (streamer->state == STREAM_BEGIN) {
+                // Continue right after what the device has flashed
+                streamer->state = STREAM_STREAMING;
+                streamer->window = status.window ? status.window : 1;
+                streamer->sent = status.offset;
+                streamer->crc = CANFirmwareCRC(0, streamer->image, status.offset);
+                streamer->commitPending = false;
+            } else {
+                // Progress, a later stall gets the full number of retries again
+                streamer->retries = 0;
+            }
+            if (streamer->flashed == streamer->size) {
+                finishStream(streamer, CAN_OK);
+            }
+            break;
+        case CAN_FIRMWARE_STATUS_BAD_BLOCK:
+            if (streamer->state == STREAM_STREAMING) {
+                restart(streamer, CAN_ERROR);
+            }
+            break;
+        default:
+            finishStream(streamer, CAN_ERROR);
+            break;
+    }
+    return true;
+}
+
+
+bool CANFirmwareStreamPoll(CANFirmwareStreamer_t *streamer) {
+    if (streamer->state != STREAM_BEGIN && streamer->state != STREAM_STREAMING) {
+        return false;
+    }
+
+    if (CANGetTimestamp(streamer->handle) >= streamer->deadline) {
+        restart(streamer, CAN_TIMEOUT);
+        return streamer->state != STREAM_DONE;
+    }
+    if (streamer->state == STREAM_BEGIN) {
+        if (streamer->beginPending) {
+            sendBegin(streamer);
+        }
+        return true;
+    }
+
+    uint32_t limit = streamer->flashed + (uint32_t)streamer->window * CAN_FIRMWARE_BLOCK_SIZE;
+    for (;;) {
+        if (streamer->commitPending) {
+            uint16_t block = (uint16_t)((streamer->sent - 1) / CAN_FIRMWARE_BLOCK_SIZE);
+            CANPacket_t commit = CANUniversalPacket_FirmwareCommit(streamer->self, streamer->device, block, streamer->crc);
+            if (CANSend(streamer->handle, &commit) != CAN_OK) {
+                break;
+            }
+            streamer->commitPending = false;
+        }
+        if (streamer->sent == streamer->size || streamer->sent >= limit) {
+            break;
+        }
+
+        // Frames never span two blocks
+        uint32_t blockEnd = streamer->sent - streamer->sent % CAN_FIRMWARE_BLOCK_SIZE +
+                            blockLength(streamer->size, streamer->sent - streamer->sent % CAN_FIRMWARE_BLOCK_SIZE);
+        uint32_t remaining = blockEnd - streamer->sent;
+        uint8_t length = remaining < CAN_FIRMWARE_DATA_LEN ? (uint8_t)remaining : CAN_FIRMWARE_DATA_LEN;
+        const uint8_t *data = streamer->image + streamer->sent;
+        CANPacket_t frame = CANUniversalPacket_FirmwareData(streamer->self, streamer->device, data, length);
+        if (CANSend(streamer->handle, &frame) != CAN_OK) {
+            break;
+        }
+        streamer->crc = CANFirmwareCRC(streamer->crc, data, length);
+        streamer->sent += length;
+        streamer->commitPending = streamer->sent == blockEnd;
+    }
+    return true;
+}
+
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+
+uint8_t CANFirmwareFlashWriteSTM32(void *context, uint32_t offset, const uint8_t *data, uint32_t length) {
+    const CANFirmwareSTM32Flash_t *region = (const CANFirmwareSTM32Flash_t *)context;
+    uint32_t address = region->baseAddress + offset;
+
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks = FLASH_BANK_1,
+        .Page = (address - FLASH_BASE) / FLASH_PAGE_SIZE,
+        .NbPages = (length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE
+    };
+#if defined(FLASH_BANK_2)
+    if (address - FLASH_BASE >= FLASH_BANK_SIZE) {
+        erase.Banks = FLASH_BANK_2;
+        erase.Page -= FLASH_BANK_SIZE / FLASH_PAGE_SIZE;
+    }
+#endif
+
+    uint8_t status = CAN_OK;
+    uint32_t pageError;
+    HAL_FLASH_Unlock();
+    if (HAL_FLASHEx_Erase(&erase, &pageError) != HAL_OK) {
+        status = CAN_ERROR;
+    }
+    // Programmed in double words, the tail of the last one is left erased
+    for (uint32_t i = 0; status == CAN_OK && i < length; i += 8) {
+        uint64_t doubleWord = UINT64_MAX;
+        memcpy(&doubleWord, data + i, length - i < 8 ? length - i : 8);
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + i, doubleWord) != HAL_OK) {
+            status = CAN_ERROR;
+        }
+    }
+    HAL_FLASH_Lock();
+
+    if (status == CAN_OK && memcmp((const void *)(uintptr_t)address, data, length) != 0) {
+        status = CAN_ERROR;
+    }
+    return status;
+}
+
+#endif // defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Packets/DecodeUniversal.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the firmware update over CAN: a streamer sending an image from the host,
+ * and a receiver writing it to flash on the device (e.g. from its bootloader)
+ *
+ *   host                                          device
+ *   FirmwareBegin (size, tag)                   ->
+ *                                               <- FirmwareStatus (ok, window, offset to continue at)
+ *   FirmwareData x 342 (6 bytes each)           ->
+ *   FirmwareCommit (block 0, running crc)       ->
+ *   FirmwareData ... (up to window blocks ahead) ->
+ *                                               <- FirmwareStatus (ok, window, bytes flashed) after each block
+ *
+ * The image travels in blocks of CAN_FIRMWARE_BLOCK_SIZE (a flash page). Data frames carry no header,
+ * so the stream runs at 6 image bytes per frame, with a commit frame per block and no per frame acknowledgement.
+ * The receiver buffers up to window blocks, so the host keeps sending while a previous block is flashed.
+ *
+ * Each commit carries the CRC-32 of the image up to the end of its block. A block whose CRC does not match
+ * (e.g. after a frame was dropped) is rejected, and the host restarts with FirmwareBegin. The receiver then
+ * answers with the offset it has flashed so far, so the update resumes there instead of starting over.
+ * The same happens after a timeout, or when an interrupted update of the same image (same size and tag) is started again.
+ *
+ *   // host
+ *   CANFirmwareStreamer_t streamer;
+ *   CANFirmwareStreamStart(&streamer, handle, jetson, bldc, image, size, tag, 200000, onDone, NULL);
+ *   while (CANFirmwareStreamPoll(&streamer)) {
+ *       while (CANPollAndReceive(handle, &packet) > 0) {
+ *           CANFirmwareStreamHandlePacket(&streamer, &packet);
+ *       }
+ *   }
+ *
+ *   // device
+ *   CANFirmwareReceiver_t receiver;
+ *   CANFirmwareSTM32Flash_t region = {.baseAddress = APPLICATION_ADDRESS};
+ *   CANFirmwareReceiverInit(&receiver, handle, self, CANFirmwareFlashSTM32(&region), APPLICATION_SIZE);
+ *   while (!CANFirmwareReceiverComplete(&receiver)) {
+ *       while (CANPollAndReceive(handle, &packet) > 0) {
+ *           CANFirmwareReceiverHandlePacket(&receiver, &packet);
+ *       }
+ *       CANFirmwareReceiverPoll(&receiver);
+ *   }
+ *
+ * Flash is written from CANFirmwareReceiverPoll, never from the receive path. Programming stalls code running
+ * from the same flash bank, so frames arriving meanwhile are only kept if the port has a receive ring
+ * (CAN_RX_RING_SIZE) filled from an interrupt running from RAM or the other bank, or the window is 1.
+ */
+
+/**
+ * Size of a block in bytes, a multiple of the flash page size of the receiver
+ */
+#ifndef CAN_FIRMWARE_BLOCK_SIZE
+#define CAN_FIRMWARE_BLOCK_SIZE 2048
+#endif
+
+/**
+ * Number of blocks the receiver buffers
+ */
+#ifndef CAN_FIRMWARE_WINDOW
+#define CAN_FIRMWARE_WINDOW 2
+#endif
+
+/**
+ * Times the streamer restarts a stalled update before giving up
+ */
+#ifndef CAN_FIRMWARE_RETRIES
+#define CAN_FIRMWARE_RETRIES 5
+#endif
+
+/**
+ * Status of FirmwareStatus packets
+ */
+#define CAN_FIRMWARE_STATUS_OK          0
+#define CAN_FIRMWARE_STATUS_BAD_BLOCK   1 // the block's length or CRC did not match, restart with FirmwareBegin
+#define CAN_FIRMWARE_STATUS_TOO_LARGE   2 // the image does not fit
+#define CAN_FIRMWARE_STATUS_FLASH_ERROR 3 // erasing or programming failed, the update is aborted
+
+/**
+ * Continues a CRC-32 (IEEE 802.3) over more data, start with crc 0
+ */
+uint32_t CANFirmwareCRC(uint32_t crc, const uint8_t *data, uint32_t length);
+
+
+// Receiver
+
+/**
+ * Flash the receiver writes to
+ * write erases the pages of a block and programs it, offset is relative to the start of the image
+ * and always a multiple of CAN_FIRMWARE_BLOCK_SIZE. Returns CAN_OK or CAN_ERROR.
+ */
+typedef struct {
+    uint8_t (*write)(void *context, uint32_t offset, const uint8_t *data, uint32_t length);
+    void *context;
+} CANFirmwareFlash_t;
+
+typedef struct {
+    CANHandle_t handle;
+    CANDevice_t self;
+    CANDevice_t host;
+    CANFirmwareFlash_t flash;
+    uint32_t capacity;
+    bool active;
+    bool synced;        // data is accepted, cleared after a bad block until the next FirmwareBegin
+    bool statusPending; // the last status still has to be sent
+    uint8_t status;
+    uint16_t imageTag;
+    uint32_t imageSize;
+    uint32_t flashed;   // bytes written to flash
+    uint32_t verified;  // bytes whose block matched its commit, flashed or waiting in a buffer
+    uint32_t received;  // bytes of the block being received
+    uint32_t flashedCRC;
+    uint32_t verifiedCRC;
+    uint32_t badBlocks;
+    uint32_t blockCRC[CAN_FIRMWARE_WINDOW]; // running CRC at the end of each buffered block
+    uint8_t buffers[CAN_FIRMWARE_WINDOW][CAN_FIRMWARE_BLOCK_SIZE];
+} CANFirmwareReceiver_t;
+
+/**
+ * Clears the receiver
+ * @param receiver Receiver to initialize
+ * @param CANHandle Handle previously passed to CANInit
+ * @param self This device
+ * @param flash Flash to write the image to
+ * @param capacity Largest image that fits, in bytes
+ */
+void CANFirmwareReceiverInit(CANFirmwareReceiver_t *receiver, CANHandle_t CANHandle, CANDevice_t self,
+                             CANFirmwareFlash_t flash, uint32_t capacity);
+
+/**
+ * Handles a received firmware packet
+ * @return true if the packet was a firmware packet
+ */
+bool CANFirmwareReceiverHandlePacket(CANFirmwareReceiver_t *receiver, const CANPacket_t *packet);
+
+/**
+ * Flashes the next verified block, if any, and reports it to the host
+ * Should be called regularly
+ */
+void CANFirmwareReceiverPoll(CANFirmwareReceiver_t *receiver);
+
+/**
+ * Returns true once a whole image has been flashed
+ */
+inline static bool CANFirmwareReceiverComplete(const CANFirmwareReceiver_t *receiver) {
+    return receiver->active && receiver->imageSize && receiver->flashed == receiver->imageSize;
+}
+
+
+// Streamer
+
+/**
+ * Called once the update finished: CAN_OK, CAN_TIMEOUT, or CAN_ERROR if the device refused the image
+ */
+typedef void (*CANFirmwareStreamCallback_t)(uint8_t status, void *context);
+
+typedef struct {
+    CANHandle_t handle;
+    CANDevice_t self;
+    CANDevice_t device;
+    const uint8_t *image;
+    uint32_t size;
+    uint16_t tag;
+    uint8_t state;
+    uint8_t window;
+    bool beginPending;  // FirmwareBegin still has to be sent
+    bool commitPending; // the data of a block is sent, its commit is not
+    uint8_t retries;
+    uint32_t flashed;   // acknowledged by the device
+    uint32_t sent;
+    uint32_t crc;       // running CRC of the bytes sent
+    uint32_t resumes;
+    CANTimestamp_t timeout;
+    CANTimestamp_t deadline;
+    CANFirmwareStreamCallback_t callback;
+    void *context;
+} CANFirmwareStreamer_t;
+
+/**
+ * Starts sending an image to a device
+ * @param streamer Streamer to start, must stay in place until finished
+ * @param CANHandle Handle previously passed to CANInit
+ * @param self This device
+ * @param device Device to update
+ * @param image Image to send, must stay valid until the callback ran
+ * @param size Size of the image in bytes
+ * @param tag Identifies the image (e.g. the low bits of its CRC), an update is only resumed for the same tag
+ * @param timeoutMicros Time without progress before the update is restarted
+ * @param callback Called when the update finished, may be NULL
+ * @param context Passed to the callback
+ */
+void CANFirmwareStreamStart(CANFirmwareStreamer_t *streamer, CANHandle_t CANHandle, CANDevice_t self,
+                            CANDevice_t device, const uint8_t *image, uint32_t size, uint16_t tag,
+                            uint32_t timeoutMicros, CANFirmwareStreamCallback_t callback, void *context);
+
+/**
+ * Handles a received firmware status
+ * @return true if the packet was a firmware status from the device being updated
+ */
+bool CANFirmwareStreamHandlePacket(CANFirmwareStreamer_t *streamer, const CANPacket_t *packet);
+
+/**
+ * Sends as much of the image as the device's window allows and restarts a stalled update
+ * Should be called as often as possible while the update runs
+ * @return true while the update is running
+ */
+bool CANFirmwareStreamPoll(CANFirmwareStreamer_t *streamer);
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+
+/**
+ * Flash region of the STM32G4 an image is written to
+ */
+typedef struct {
+    uint32_t baseAddress; // page aligned, not overlapping the running code
+} CANFirmwareSTM32Flash_t;
+
+/**
+ * Writes a block to the region, erasing its pages and verifying it afterwards
+ */
+uint8_t CANFirmwareFlashWriteSTM32(void *context, uint32_t offset, const uint8_t *data, uint32_t length);
+
+/**
+ * Returns the flash of a region for CANFirmwareReceiverInit
+ */
+inline static CANFirmwareFlash_t CANFirmwareFlashSTM32(CANFirmwareSTM32Flash_t *region) {
+    return (CANFirmwareFlash_t){.write = CANFirmwareFlashWriteSTM32, .context = region};
+}
+
+#endif
@@ -26,6 +26,38 @@
     #define SMALL_ENUM typedef enum
 #endif
 
+/**
+ * Fails compilation if the condition does not hold
+ */
+#if defined(__cplusplus)
+    #define CAN_STATIC_ASSERT(condition, message) static_assert(condition, message)
+#else
+    #define CAN_STATIC_ASSERT(condition, message) _Static_assert(condition, message)
+#endif
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && defined(__ORDER_BIG_ENDIAN__)
+
+// GCC and clang know the byte order, so the tests below are constants even without optimization
+CAN_STATIC_ASSERT(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__,
+                  "mixed endian platforms are not supported");
+
+/**
+ * Indicates if bit fields are ordered from lsb to msb
+ * GCC and clang allocate bit fields from the lsb exactly on LE platforms
+ */
+inline static bool little_endian_bitfields() {
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+/**
+ * Indicates whether the platform is LE
+ */
+inline static bool little_endian() {
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+#else
+
 // There may be a cleaner way to do these tests this was the most compatible way I could devise
 // Obviously on any optimization level other than O0 this gets optimized away
 // Done to ensure that the memcpys don't break things in any reasonable environment
@@ -56,6 +88,8 @@ inline static bool little_endian() {
     return tester.y;
 }
 
+#endif
+
 
 #ifdef __GNUC__
 
@@ -70,9 +104,9 @@ inline static bool little_endian() {
 #define bswap16 __builtin_bswap16
 
 /**
- * Counts the number of leading zeros in a 16 bit number
+ * Counts the number of leading zeros in a non zero 16 bit number
  */
-#define clz16 __builtin_clz
+#define clz16(input) ((uint8_t)__builtin_clz((uint32_t)(input) << 16))
 
 #else
 
@@ -87,9 +121,7 @@ inline static uint16_t bswap16(uint16_t input) {
 
 inline static uint8_t clz16(uint16_t input) {
     uint8_t count = 0;
-    for (int i = 0; i < 16; ++i, input <<= 1) {
-        count += (input & 0x8000) != 0;
-    }
+    for (; count < 16 && !(input & 0x8000); ++count, input <<= 1);
     return count;
 }
 
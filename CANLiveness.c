@@ -0,0 +1,169 @@
+#include "CANLiveness.h"
+
+#include <string.h>
+
+#define WHEEL_MASK (CAN_LIVENESS_WHEEL_SLOTS - 1)
+
+typedef char WheelSlotsArePowerOfTwo_t[(CAN_LIVENESS_WHEEL_SLOTS & WHEEL_MASK) == 0 ? 1 : -1];
+
+static uint32_t wheelTick(const CANLivenessMonitor_t *monitor, CANTimestamp_t timestamp) {
+    return (uint32_t)((timestamp - monitor->start) / monitor->tickLength);
+}
+
+static void unlinkDevice(CANLivenessMonitor_t *monitor, uint8_t index) {
+    CANLivenessDevice_t *device = &monitor->devices[index];
+    if (!device->scheduled) {
+        return;
+    }
+    if (device->previous != CAN_LIVENESS_NONE) {
+        monitor->devices[device->previous].next = device->next;
+    } else {
+        monitor->wheel[device->deadline & WHEEL_MASK] = device->next;
+    }
+    if (device->next != CAN_LIVENESS_NONE) {
+        monitor->devices[device->next].previous = device->previous;
+    }
+    device->scheduled = false;
+}
+
+/**
+ * Moves a device to the wheel slot of the deadline following a heartbeat (or watch) at the given time
+ * The deadline is rounded up to a whole tick, so a device is never reported lost before its timeout
+ */
+static void scheduleDevice(CANLivenessMonitor_t *monitor, uint8_t index, CANTimestamp_t seen) {
+    unlinkDevice(monitor, index);
+
+    CANLivenessDevice_t *device = &monitor->devices[index];
+    CANTimestamp_t expiry = seen - monitor->start + device->timeout + monitor->tickLength - 1;
+    device->deadline = (uint32_t)(expiry / monitor->tickLength);
+    // A slot already visited by CANLivenessTick would only be seen again a full turn later
+    if ((int32_t)(device->deadline - monitor->processedTick) <= 0) {
+        device->deadline = monitor->processedTick + 1;
+    }
+
+    uint8_t *slot = &monitor->wheel[device->deadline & WHEEL_MASK];
+    device->previous = CAN_LIVENESS_NONE;
+    device->next = *slot;
+    if (*slot != CAN_LIVENESS_NONE) {
+        monitor->devices[*slot].previous = index;
+    }
+    *slot = index;
+    device->scheduled = true;
+}
+
+static void notify(CANLivenessMonitor_t *monitor, uint8_t index, uint8_t event) {
+    if (monitor->callback) {
+        monitor->callback((CANDeviceUUID_t)index, event, &monitor->devices[index].status, monitor->callbackContext);
+    }
+}
+
+
+void CANLivenessInit(CANLivenessMonitor_t *monitor, CANHandle_t CANHandle, uint32_t tickMicros) {
+    memset(monitor, 0, sizeof(CANLivenessMonitor_t));
+    monitor->handle = CANHandle;
+    monitor->start = CANGetTimestamp(CANHandle);
+    monitor->tickLength = (CANTimestamp_t)tickMicros * CANGetTimestampFrequency(CANHandle) / 1000000u;
+    if (monitor->tickLength == 0) {
+        monitor->tickLength = 1;
+    }
+    memset(monitor->wheel, CAN_LIVENESS_NONE, sizeof(monitor->wheel));
+}
+
+
+void CANLivenessSetCallback(CANLivenessMonitor_t *monitor, CANLivenessCallback_t callback, void *context) {
+    monitor->callback = callback;
+    monitor->callbackContext = context;
+}
+
+
+bool CANLivenessWatch(CANLivenessMonitor_t *monitor, CANDeviceUUID_t device, uint32_t timeoutMicros) {
+    if (!monitor || device == CAN_UUID_BROADCAST || device >= CAN_LIVENESS_DEVICES || timeoutMicros == 0) {
+        return false;
+    }
+
+    CANLivenessDevice_t *entry = &monitor->devices[device];
+    entry->timeout = (CANTimestamp_t)timeoutMicros * CANGetTimestampFrequency(monitor->handle) / 1000000u;
+    if (entry->status.liveness == CAN_LIVENESS_UNWATCHED) {
+        memset(&entry->status, 0, sizeof(CANLivenessStatus_t));
+        entry->status.liveness = CAN_LIVENESS_UNKNOWN;
+        // A device that never sends a heartbeat is reported lost after one timeout
+        scheduleDevice(monitor, device, CANGetTimestamp(monitor->handle));
+    } else if (entry->status.liveness == CAN_LIVENESS_ALIVE) {
+        scheduleDevice(monitor, device, entry->status.lastSeen);
+    }
+    return true;
+}
+
+
+#define CAN_LIVENESS_WATCH_DEVICE(UUID, NAME) CANLivenessWatch(monitor, UUID, timeoutMicros);
+
+void CANLivenessWatchAll(CANLivenessMonitor_t *monitor, uint32_t timeoutMicros) {
+    CAN_DEVICES(CAN_LIVENESS_WATCH_DEVICE)
+}
+
+
+void CANLivenessUnwatch(CANLivenessMonitor_t *monitor, CANDeviceUUID_t device) {
+    if (!monitor || device >= CAN_LIVENESS_DEVICES) {
+        return;
+    }
+    unlinkDevice(monitor, device);
+    monitor->devices[device].status.liveness = CAN_LIVENESS_UNWATCHED;
+}
+
+
+void CANLivenessOnHeartbeat(const CANUniversalPacket_HeartBeat_Decoded_t *decoded, const CANPacket_t *packet,
+                            void *context) {
+    (void)packet;
+    CANLivenessMonitor_t *monitor = (CANLivenessMonitor_t *)context;
+    uint8_t index = decoded->sender.deviceUUID;
+    CANLivenessStatus_t *status = &monitor->devices[index].status;
+    if (status->liveness == CAN_LIVENESS_UNWATCHED) {
+        return;
+    }
+
+    uint8_t previous = status->liveness;
+    bool changed = status->error != decoded->error || status->state != decoded->state;
+    status->liveness = CAN_LIVENESS_ALIVE;
+    status->error = decoded->error;
+    status->state = decoded->state;
+    status->lastSeen = CANGetTimestamp(monitor->handle);
+    scheduleDevice(monitor, index, status->lastSeen);
+
+    if (previous != CAN_LIVENESS_ALIVE) {
+        notify(monitor, index, CAN_LIVENESS_EVENT_ALIVE);
+    } else if (changed) {
+        notify(monitor, index, CAN_LIVENESS_EVENT_STATE_CHANGED);
+    }
+}
+
+
+uint16_t CANLivenessTick(CANLivenessMonitor_t *monitor) {
+    uint32_t now = wheelTick(monitor, CANGetTimestamp(monitor->handle));
+    uint32_t elapsed = now - monitor->processedTick;
+    if (elapsed > CAN_LIVENESS_WHEEL_SLOTS) {
+        // Late by more than a turn, every slot is visited once
+        elapsed = CAN_LIVENESS_WHEEL_SLOTS;
+    }
+
+    uint16_t lost = 0;
+    for (uint32_t tick = now - elapsed + 1; elapsed > 0; ++tick, --elapsed) {
+        uint8_t index = monitor->wheel[tick & WHEEL_MASK];
+        while (index != CAN_LIVENESS_NONE) {
+            CANLivenessDevice_t *device = &monitor->devices[index];
+            // Devices whose deadline is a later turn of the wheel share the slot and stay in it
+            if ((int32_t)(now - device->deadline) < 0) {
+                index = device->next;
+                continue;
+            }
+            unlinkDevice(monitor, index);
+            device->status.liveness = CAN_LIVENESS_LOST;
+            ++device->status.lossCount;
+            ++lost;
+            notify(monitor, index, CAN_LIVENESS_EVENT_LOST);
+            // The callback may have watched or unwatched devices of this slot, so it is walked again
+            index = monitor->wheel[tick & WHEEL_MASK];
+        }
+    }
+    monitor->processedTick = now;
+    return lost;
+}
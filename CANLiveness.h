@@ -0,0 +1,150 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANDevices.h"
+#include "Packets/DecodeUniversal.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the liveness monitor, which tracks the heartbeats of devices and reports
+ * when a device goes silent, comes back, or changes its error or state fields:
+ *
+ *   CANLivenessMonitor_t liveness;
+ *   CANLivenessInit(&liveness, handle, 1000);          // 1 ms wheel tick
+ *   CANLivenessWatchAll(&liveness, 110000);            // heartbeats every 100 ms, 10 ms of slack
+ *   CANLivenessSetCallback(&liveness, onLiveness, NULL);
+ *   CANUniversalPacket_HeartBeat_Register(&dispatcher, CANLivenessOnHeartbeat, &liveness);
+ *   ...
+ *   CANDispatchDrain(&dispatcher, handle);
+ *   CANLivenessTick(&liveness);
+ *
+ * Deadlines are kept in a hashed timer wheel: every heartbeat moves its device to the wheel slot of its
+ * new deadline, and a tick only visits the slots that elapsed since the previous one. A tick therefore
+ * costs the number of devices whose deadline falls into those slots, not the number of devices watched.
+ * A device is reported lost at most one wheel tick after its timeout, so a timeout slightly above the
+ * heartbeat period detects a dead device within one missed heartbeat.
+ */
+
+/**
+ * Number of slots in the timer wheel, a power of two
+ * Timeouts longer than the wheel (slots * tick) still work, their devices are just visited once per turn
+ */
+#ifndef CAN_LIVENESS_WHEEL_SLOTS
+#define CAN_LIVENESS_WHEEL_SLOTS 64
+#endif
+
+/**
+ * Number of device UUIDs (7 bit)
+ */
+#define CAN_LIVENESS_DEVICES 128
+
+/**
+ * Liveness of a device
+ */
+#define CAN_LIVENESS_UNWATCHED 0 // not monitored
+#define CAN_LIVENESS_UNKNOWN   1 // monitored, no heartbeat received yet
+#define CAN_LIVENESS_ALIVE     2
+#define CAN_LIVENESS_LOST      3 // no heartbeat within the timeout
+
+/**
+ * Events passed to the callback
+ */
+#define CAN_LIVENESS_EVENT_ALIVE         0 // first heartbeat, or first heartbeat after being lost
+#define CAN_LIVENESS_EVENT_LOST          1
+#define CAN_LIVENESS_EVENT_STATE_CHANGED 2 // the error or state field of the heartbeat changed
+
+typedef struct {
+    uint8_t liveness;          // one of the CAN_LIVENESS_ macros
+    uint8_t state;             // state field of the last heartbeat
+    uint32_t error;            // error field of the last heartbeat
+    CANTimestamp_t lastSeen;   // when the last heartbeat was handled
+    uint32_t lossCount;        // number of times the device was lost
+} CANLivenessStatus_t;
+
+/**
+ * Called on every event, may watch and unwatch devices (including the one reported)
+ */
+typedef void (*CANLivenessCallback_t)(CANDeviceUUID_t device, uint8_t event, const CANLivenessStatus_t *status,
+                                      void *context);
+
+/**
+ * No device, terminates the wheel lists
+ */
+#define CAN_LIVENESS_NONE 0xFF
+
+typedef struct {
+    CANLivenessStatus_t status;
+    CANTimestamp_t timeout;
+    uint32_t deadline;     // wheel tick at which the device is lost
+    uint8_t previous;      // neighbours in the wheel slot list, CAN_LIVENESS_NONE at the ends
+    uint8_t next;
+    bool scheduled;        // in the wheel (watched and not lost)
+} CANLivenessDevice_t;
+
+typedef struct {
+    CANHandle_t handle;
+    CANTimestamp_t start;
+    CANTimestamp_t tickLength; // wheel tick in timestamp ticks
+    uint32_t processedTick;    // last wheel tick handled by CANLivenessTick
+    CANLivenessCallback_t callback;
+    void *callbackContext;
+    uint8_t wheel[CAN_LIVENESS_WHEEL_SLOTS]; // first device of each slot
+    CANLivenessDevice_t devices[CAN_LIVENESS_DEVICES];
+} CANLivenessMonitor_t;
+
+/**
+ * Clears the monitor, no device is watched afterwards
+ * @param monitor Monitor to initialize
+ * @param CANHandle Handle previously passed to CANInit, the monitor uses its clock
+ * @param tickMicros Resolution of the timer wheel, the lateness of a loss report is at most one tick
+ */
+void CANLivenessInit(CANLivenessMonitor_t *monitor, CANHandle_t CANHandle, uint32_t tickMicros);
+
+/**
+ * Sets the function called on every event, NULL removes it
+ * Called from CANLivenessOnHeartbeat and CANLivenessTick
+ */
+void CANLivenessSetCallback(CANLivenessMonitor_t *monitor, CANLivenessCallback_t callback, void *context);
+
+/**
+ * Starts monitoring a device, it is lost if no heartbeat arrives within the timeout
+ * Watching an already watched device only changes its timeout
+ * @return false if the arguments are invalid
+ */
+bool CANLivenessWatch(CANLivenessMonitor_t *monitor, CANDeviceUUID_t device, uint32_t timeoutMicros);
+
+/**
+ * Watches every device listed in CANDevices.h, including this node (remove it with CANLivenessUnwatch)
+ */
+void CANLivenessWatchAll(CANLivenessMonitor_t *monitor, uint32_t timeoutMicros);
+
+/**
+ * Stops monitoring a device
+ */
+void CANLivenessUnwatch(CANLivenessMonitor_t *monitor, CANDeviceUUID_t device);
+
+/**
+ * Handles a decoded heartbeat, matches CANUniversalPacket_HeartBeat_Handler_t so it can be registered directly
+ * @param decoded Decoded heartbeat
+ * @param packet Heartbeat packet, unused
+ * @param context The CANLivenessMonitor_t
+ */
+void CANLivenessOnHeartbeat(const CANUniversalPacket_HeartBeat_Decoded_t *decoded, const CANPacket_t *packet,
+                            void *context);
+
+/**
+ * Reports every device whose timeout has passed since the last call
+ * Should be called at least every few wheel ticks, e.g. from the receive loop
+ * @return Number of devices reported lost
+ */
+uint16_t CANLivenessTick(CANLivenessMonitor_t *monitor);
+
+/**
+ * Returns the status of a device
+ */
+inline static const CANLivenessStatus_t *CANLivenessGet(const CANLivenessMonitor_t *monitor, CANDeviceUUID_t device) {
+    return &monitor->devices[device & 0x7F].status;
+}
@@ -0,0 +1,117 @@
+#include "CANMotorGroup.h"
+#include "Packets/Schema.h"
+#include "CANDevices.h"
+
+#include <string.h>
+
+/**
+ * Motor domain broadcast the apply trigger is addressed to
+ */
+static const CANDevice_t motorBroadcast = {
+    .motorDomain = true,
+    .deviceUUID = CAN_UUID_BROADCAST
+};
+
+typedef CANPacket_t (*SetpointBuilder_t)(CANDevice_t sender, CANDevice_t device, float setpoint, float feedForward);
+
+/**
+ * Encodes the setpoints in chunks on the stack and hands each chunk to CANSendBatch
+ * The trigger rides in the last chunk so it is queued right behind the last setpoint
+ */
+static uint16_t sendGroup(CANHandle_t CANHandle, CANDevice_t sender, const CANMotorSetpoint_t *setpoints,
+                          uint16_t count, uint8_t applyGroup, SetpointBuilder_t build) {
+    if (!setpoints) {
+        return 0;
+    }
+
+    CANPacket_t packets[CAN_MOTOR_GROUP_BATCH];
+    bool apply = applyGroup != CAN_MOTOR_GROUP_NO_APPLY;
+    uint16_t sent = 0;
+    while (sent < count || apply) {
+        uint16_t chunk = 0;
+        while (chunk < CAN_MOTOR_GROUP_BATCH && sent + chunk < count) {
+            const CANMotorSetpoint_t *axis = &setpoints[sent + chunk];
+            packets[chunk++] = build(sender, axis->device, axis->setpoint, axis->feedForward);
+        }
+        // If the last chunk is full the trigger goes out in a chunk of its own
+        bool trigger = apply && sent + chunk == count && chunk < CAN_MOTOR_GROUP_BATCH;
+        if (trigger) {
+            packets[chunk++] = CANMotorPacket_BLDC_ApplySetpoints(sender, motorBroadcast, applyGroup);
+        }
+
+        uint16_t accepted = CANSendBatch(CANHandle, packets, chunk);
+        if (trigger) {
+            // The trigger is not counted, and a partial burst leaves it unsent
+            return sent + (accepted == chunk ? chunk - 1 : accepted);
+        }
+        sent += accepted;
+        if (accepted < chunk) {
+            break;
+        }
+    }
+    return sent;
+}
+
+static CANPacket_t buildVelocity(CANDevice_t sender, CANDevice_t device, float setpoint, float feedForward) {
+    return CANMotorPacket_BLDC_SetInputVelocity(sender, device, setpoint, feedForward);
+}
+
+static CANPacket_t buildPosition(CANDevice_t sender, CANDevice_t device, float setpoint, float feedForward) {
+    return CANMotorPacket_BLDC_SetInputPosition(sender, device, setpoint, feedForward);
+}
+
+
+uint16_t CANMotorGroupSendVelocity(CANHandle_t CANHandle, CANDevice_t sender,
+                                   const CANMotorSetpoint_t *setpoints, uint16_t count, uint8_t applyGroup) {
+    return sendGroup(CANHandle, sender, setpoints, count, applyGroup, buildVelocity);
+}
+
+
+uint16_t CANMotorGroupSendPosition(CANHandle_t CANHandle, CANDevice_t sender,
+                                   const CANMotorSetpoint_t *setpoints, uint16_t count, uint8_t applyGroup) {
+    return sendGroup(CANHandle, sender, setpoints, count, applyGroup, buildPosition);
+}
+
+
+uint8_t CANMotorGroupApply(CANHandle_t CANHandle, CANDevice_t sender, uint8_t groupID) {
+    CANPacket_t trigger = CANMotorPacket_BLDC_ApplySetpoints(sender, motorBroadcast, groupID);
+    return CANSend(CANHandle, &trigger);
+}
+
+
+void CANMotorLatchInit(CANMotorLatch_t *latch, uint8_t groupID) {
+    memset(latch, 0, sizeof(CANMotorLatch_t));
+    latch->groupID = groupID;
+}
+
+
+bool CANMotorLatchReceive(CANMotorLatch_t *latch, const CANPacket_t *packet, CANPacket_t *out) {
+    switch (packet->command & 0x7F) {
+        case CAN_COMMAND_ID__BLDC_INPUT_VELOCITY:
+        case CAN_COMMAND_ID__BLDC_INPUT_POSITION:
+            if (latch->staged) {
+                ++latch->overwritten;
+            }
+            latch->setpoint = *packet;
+            latch->staged = true;
+            return false;
+        case CAN_COMMAND_ID__BLDC_APPLY_SETPOINTS: {
+            if (packet->contentsLength < CANMotorPacket_BLDC_ApplySetpoints_LENGTH) {
+                return false;
+            }
+            uint8_t groupID = packet->contents[CAN_SCHEMA_OFFSET(CANMotorPacket_BLDC_ApplySetpoints, groupID)];
+            if (!latch->staged || (groupID != CAN_MOTOR_GROUP_ALL && groupID != latch->groupID)) {
+                return false;
+            }
+            latch->staged = false;
+            ++latch->applied;
+            *out = latch->setpoint;
+            return true;
+        }
+        default:
+            if (out != packet) {
+                *out = *packet;
+            }
+            return true;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Packets/Motor.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the group motor API, for updating several axes (the four tires, the arm joints) together
+ * The setpoints of a group are encoded in one loop and handed to the port as a single CANSendBatch burst:
+ *
+ *   CANMotorSetpoint_t tires[4] = {
+ *       {frontLeft, left, 0}, {frontRight, right, 0}, {rearLeft, left, 0}, {rearRight, right, 0}
+ *   };
+ *   CANMotorGroupSendVelocity(handle, jetson, tires, 4, TIRE_GROUP);
+ *
+ * A burst still takes one frame time per axis on the bus. To remove that skew, devices can latch their
+ * setpoints instead of applying them on arrival, and apply them together when the broadcast
+ * CANMotorPacket_BLDC_ApplySetpoints trigger of their group arrives (see CANMotorLatch_t).
+ *
+ * The trigger is appended to the burst, which keeps it behind the setpoints when the port sends in order.
+ * With the STM32 software queue or CAN_TX_QUEUE_ID_ORDERED, frames go out by identifier and the broadcast
+ * trigger outranks the setpoints. In that case pass CAN_MOTOR_GROUP_NO_APPLY and send the trigger with
+ * CANMotorGroupApply once the setpoints have left, e.g. on the next control tick.
+ */
+
+/**
+ * Group id of an apply trigger addressed to every latching device
+ */
+#define CAN_MOTOR_GROUP_ALL      0x00
+
+/**
+ * Group id passed to the send functions to not append an apply trigger
+ */
+#define CAN_MOTOR_GROUP_NO_APPLY 0xFF
+
+/**
+ * Number of packets encoded on the stack per CANSendBatch call
+ */
+#ifndef CAN_MOTOR_GROUP_BATCH
+#define CAN_MOTOR_GROUP_BATCH 16
+#endif
+
+/**
+ * Setpoint of one axis
+ * For velocity control, setpoint is in rev/s and feedForward is a torque in Nm
+ * For position control, setpoint is in rev and feedForward is a velocity in rev/s
+ */
+typedef struct {
+    CANDevice_t device;
+    float setpoint;
+    float feedForward;
+} CANMotorSetpoint_t;
+
+/**
+ * Sends a CANMotorPacket_BLDC_SetInputVelocity to every axis of a group in one burst
+ * @param CANHandle Handle previously passed to CANInit
+ * @param sender Device sending the setpoints
+ * @param setpoints Setpoint of each axis
+ * @param count Number of setpoints
+ * @param applyGroup Group id of the apply trigger to append, or CAN_MOTOR_GROUP_NO_APPLY
+ * @return Number of setpoints accepted by the port, the trigger is only sent if all of them were
+ */
+uint16_t CANMotorGroupSendVelocity(CANHandle_t CANHandle, CANDevice_t sender,
+                                   const CANMotorSetpoint_t *setpoints, uint16_t count, uint8_t applyGroup);
+
+/**
+ * Sends a CANMotorPacket_BLDC_SetInputPosition to every axis of a group in one burst
+ * Same as CANMotorGroupSendVelocity otherwise
+ */
+uint16_t CANMotorGroupSendPosition(CANHandle_t CANHandle, CANDevice_t sender,
+                                   const CANMotorSetpoint_t *setpoints, uint16_t count, uint8_t applyGroup);
+
+/**
+ * Broadcasts the apply trigger of a group to the motor domain
+ * @return Result of CANSend
+ */
+uint8_t CANMotorGroupApply(CANHandle_t CANHandle, CANDevice_t sender, uint8_t groupID);
+
+
+/**
+ * Receiving side: holds the last setpoint packet until the apply trigger of the device's group arrives
+ *
+ *   CANMotorLatch_t latch;
+ *   CANMotorLatchInit(&latch, TIRE_GROUP);
+ *   ...
+ *   if (!CANMotorLatchReceive(&latch, &packet, &packet)) {
+ *       continue; // staged, or a trigger with nothing staged
+ *   }
+ *   CANDispatch(&dispatcher, &packet); // any other packet, or the setpoint released by a trigger
+ *
+ * A device that does not use a latch applies setpoints on arrival and ignores the trigger
+ */
+typedef struct {
+    uint8_t groupID;
+    bool staged;
+    CANPacket_t setpoint;
+    uint32_t applied;
+    uint32_t overwritten; // setpoints replaced by a newer one before any trigger arrived
+} CANMotorLatch_t;
+
+/**
+ * Clears the latch
+ * @param latch Latch to initialize
+ * @param groupID Group of this device, must not be CAN_MOTOR_GROUP_ALL or CAN_MOTOR_GROUP_NO_APPLY
+ */
+void CANMotorLatchInit(CANMotorLatch_t *latch, uint8_t groupID);
+
+/**
+ * Stages setpoint packets and releases the staged one when the group's trigger arrives
+ * @param latch Latch of this device
+ * @param packet Received packet
+ * @param out Packet to handle, may be the same as packet
+ * @return true if out holds a packet to handle (the packet itself if it is neither a setpoint nor a trigger,
+ *         or the staged setpoint if it is a matching trigger), false if it was staged or consumed
+ */
+bool CANMotorLatchReceive(CANMotorLatch_t *latch, const CANPacket_t *packet, CANPacket_t *out);
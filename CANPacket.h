@@ -2,6 +2,7 @@
 
 #include "CANHelpers.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -70,6 +71,33 @@ typedef struct {
     uint8_t contents[6];
 } CANPacket_t;
 
+/**
+ * Maximum number of content bytes in a CAN FD packet
+ * A CAN FD frame carries up to 64 data bytes, 2 of which are the command and senderUUID
+ */
+#define CAN_FD_MAX_CONTENTS_LENGTH 62
+
+/**
+ * Represents a CAN FD packet to be sent on the CAN network
+ * Identical to CANPacket_t except for the size of the contents
+ *
+ * CAN FD only supports the data lengths 0-8, 12, 16, 20, 24, 32, 48 and 64
+ * Other lengths are padded with zeros up to the next supported length when sent,
+ * so the receiver sees the padded contentsLength
+ */
+typedef struct {
+    CANDevice_t device;
+    CANPriority_t priority;
+
+    // data length - 2
+    uint8_t contentsLength;
+
+    // note that this part forms a contiguous section of up to 64 bytes representing the data
+    CANCommand_t command;
+    CANDeviceUUID_t senderUUID;
+    uint8_t contents[CAN_FD_MAX_CONTENTS_LENGTH];
+} CANFDPacket_t;
+
 // Note about struct initializers: C allows any order, C++ requires them to be in order
 
 /**
@@ -105,6 +133,12 @@ typedef struct {
  */
 uint16_t CANGetPacketHeader(const CANPacket_t *packet);
 
+/**
+ * Sets the device and priority of the CAN packet from a received 11 bit header
+ * Inverse of CANGetPacketHeader, used by the ports on receive
+ */
+void CANSetPacketHeader(CANPacket_t *packet, uint16_t header);
+
 /**
  * Returns the true data length of the CAN packet (including command id and sender id)
  */
@@ -121,6 +155,70 @@ uint8_t *CANGetData(CANPacket_t *packet);
  */
 const uint8_t *CANGetDataConst(const CANPacket_t *packet);
 
+// Functions for retrieving CAN FD packet components
+
+/**
+ * Returns the 11 bit structure representing the CAN FD packet header
+ * Identical to CANGetPacketHeader
+ */
+uint16_t CANFDGetPacketHeader(const CANFDPacket_t *packet);
+
+/**
+ * Sets the device and priority of the CAN FD packet from a received 11 bit header
+ * Identical to CANSetPacketHeader
+ */
+void CANFDSetPacketHeader(CANFDPacket_t *packet, uint16_t header);
+
+/**
+ * Returns the number of data bytes the CAN FD frame carries (including command id and sender id)
+ * This is rounded up to the next length CAN FD supports
+ */
+uint8_t CANFDGetDataLength(const CANFDPacket_t *packet);
+
+/**
+ * Returns a pointer to the 64 byte data section of the CAN FD packet (including command id and sender id)
+ */
+uint8_t *CANFDGetData(CANFDPacket_t *packet);
+
+/**
+ * Returns a const pointer to the 64 byte data section of the CAN FD packet
+ */
+const uint8_t *CANFDGetDataConst(const CANFDPacket_t *packet);
+
+/**
+ * Returns the 4 bit DLC code that encodes the given data length (rounding up to the next supported length)
+ */
+uint8_t CANFDLengthToDlc(uint8_t length);
+
+/**
+ * Returns the data length in bytes that the given 4 bit DLC code stands for
+ */
+uint8_t CANFDDlcToLength(uint8_t dlc);
+
+/**
+ * Linkage of the CANLoad and CANStore functions
+ * Defining CAN_HEADER_ONLY defines them in this header as inline functions (see CANPacketCodec.h),
+ * so the builders and decoders compile down to plain loads and stores instead of a call per field
+ * Otherwise they are compiled once into CANPacket.c
+ * CAN_HEADER_ONLY has to be defined for the whole build, CANPacket.c then no longer exports them
+ */
+#if defined(CAN_HEADER_ONLY)
+#define CAN_CODEC inline static
+#else
+#define CAN_CODEC
+#endif
+
+/**
+ * Linkage of CANStoreFloat16, which CAN_HEADER_ONLY keeps out of line
+ * Inlined, its branches grow every builder storing a Float16, and the packet is copied out right after its
+ * narrow field stores, which stalls store forwarding. A call hides that stall (compare the builds in bench/)
+ */
+#if defined(CAN_HEADER_ONLY) && defined(__GNUC__)
+#define CAN_CODEC_OUT_OF_LINE static __attribute__((noinline, unused))
+#else
+#define CAN_CODEC_OUT_OF_LINE CAN_CODEC
+#endif
+
 // Functions for reading packet data
 /* Overview of available formats
  * name     - size - type
@@ -140,44 +238,77 @@ const uint8_t *CANGetDataConst(const CANPacket_t *packet);
  *
  * All values are rounded to nearest (ties away from 0) when applicable
  * All data is little endian
+ *
+ * Defining CAN_HARDWARE_FLOAT16 converts Float16 with the half precision instructions of the target when it has them
+ * (VCVTB on Cortex-M4F and other ARM FPUs, needs -mfp16-format=ieee, and F16C on x86, needs -mf16c)
+ * Results are identical, ties the hardware rounds to even are corrected afterwards
+ * On x86 this speeds up loads, stores cost about the same as the tie correction eats the gain (see bench/)
  */
 
-uint32_t CANLoadUInt32(const uint8_t *ptr);
-int32_t CANLoadInt32(const uint8_t *ptr);
+CAN_CODEC uint32_t CANLoadUInt32(const uint8_t *ptr);
+CAN_CODEC int32_t CANLoadInt32(const uint8_t *ptr);
 
-uint32_t CANLoadUInt24(const uint8_t *ptr);
-int32_t CANLoadInt24(const uint8_t *ptr);
+CAN_CODEC uint32_t CANLoadUInt24(const uint8_t *ptr);
+CAN_CODEC int32_t CANLoadInt24(const uint8_t *ptr);
 
-uint16_t CANLoadUInt16(const uint8_t *ptr);
-int16_t CANLoadInt16(const uint8_t *ptr);
+CAN_CODEC uint16_t CANLoadUInt16(const uint8_t *ptr);
+CAN_CODEC int16_t CANLoadInt16(const uint8_t *ptr);
 
-float CANLoadFloat32(const uint8_t *ptr);
-float CANLoadFloat16(const uint8_t *ptr);
+CAN_CODEC float CANLoadFloat32(const uint8_t *ptr);
+CAN_CODEC float CANLoadFloat16(const uint8_t *ptr);
 
-float CANLoadBFloat24(const uint8_t *ptr);
-float CANLoadBFloat16(const uint8_t *ptr);
+CAN_CODEC float CANLoadBFloat24(const uint8_t *ptr);
+CAN_CODEC float CANLoadBFloat16(const uint8_t *ptr);
 
-float CANLoadUNorm24(const uint8_t *ptr);
-float CANLoadUNorm16(const uint8_t *ptr);
-float CANLoadUNorm8(const uint8_t *ptr);
+CAN_CODEC float CANLoadUNorm24(const uint8_t *ptr);
+CAN_CODEC float CANLoadUNorm16(const uint8_t *ptr);
+CAN_CODEC float CANLoadUNorm8(const uint8_t *ptr);
 
 // Functions for writing packet data
 
-void CANStoreUInt32(uint8_t *ptr, uint32_t value);
-void CANStoreInt32(uint8_t *ptr, int32_t value);
+CAN_CODEC void CANStoreUInt32(uint8_t *ptr, uint32_t value);
+CAN_CODEC void CANStoreInt32(uint8_t *ptr, int32_t value);
+
+CAN_CODEC void CANStoreUInt24(uint8_t *ptr, int32_t value);
+CAN_CODEC void CANStoreInt24(uint8_t *ptr, int32_t value);
+
+CAN_CODEC void CANStoreUInt16(uint8_t *ptr, uint16_t value);
+CAN_CODEC void CANStoreInt16(uint8_t *ptr, int16_t value);
+
+CAN_CODEC void CANStoreFloat32(uint8_t *ptr, float value);
+CAN_CODEC_OUT_OF_LINE void CANStoreFloat16(uint8_t *ptr, float value);
+
+CAN_CODEC void CANStoreBFloat24(uint8_t *ptr, float value);
+CAN_CODEC void CANStoreBFloat16(uint8_t *ptr, float value);
+
+CAN_CODEC void CANStoreUNorm24(uint8_t *ptr, float value);
+CAN_CODEC void CANStoreUNorm16(uint8_t *ptr, float value);
+CAN_CODEC void CANStoreUNorm8(uint8_t *ptr, float value);
+
+#if defined(CAN_HEADER_ONLY)
+#include "CANPacketCodec.h"
+#endif
+
+// Functions for converting arrays of values, e.g. when decoding logs on the host
+// src and dst point at the first value, stride is the distance in bytes between consecutive encoded values
+// (2 for a packed Float16 array, sizeof(CANPacket_t) for a field of consecutive packets)
+// Results are identical to the functions above
+// Vectorized with AVX2 and F16C when compiled for them (e.g. -mavx2 -mf16c or -march=native) and with NEON on aarch64
+
+void CANLoadFloat16Array(const uint8_t *src, size_t stride, float *dst, size_t n);
 
-void CANStoreUInt24(uint8_t *ptr, int32_t value);
-void CANStoreInt24(uint8_t *ptr, int32_t value);
+void CANLoadBFloat24Array(const uint8_t *src, size_t stride, float *dst, size_t n);
+void CANLoadBFloat16Array(const uint8_t *src, size_t stride, float *dst, size_t n);
 
-void CANStoreUInt16(uint8_t *ptr, uint16_t value);
-void CANStoreInt16(uint8_t *ptr, int16_t value);
+void CANLoadUNorm24Array(const uint8_t *src, size_t stride, float *dst, size_t n);
+void CANLoadUNorm16Array(const uint8_t *src, size_t stride, float *dst, size_t n);
+void CANLoadUNorm8Array(const uint8_t *src, size_t stride, float *dst, size_t n);
 
-void CANStoreFloat32(uint8_t *ptr, float value);
-void CANStoreFloat16(uint8_t *ptr, float value);
+void CANStoreFloat16Array(uint8_t *dst, size_t stride, const float *src, size_t n);
 
-void CANStoreBFloat24(uint8_t *ptr, float value);
-void CANStoreBFloat16(uint8_t *ptr, float value);
+void CANStoreBFloat24Array(uint8_t *dst, size_t stride, const float *src, size_t n);
+void CANStoreBFloat16Array(uint8_t *dst, size_t stride, const float *src, size_t n);
 
-void CANStoreUNorm24(uint8_t *ptr, float value);
-void CANStoreUNorm16(uint8_t *ptr, float value);
-void CANStoreUNorm8(uint8_t *ptr, float value);
+void CANStoreUNorm24Array(uint8_t *dst, size_t stride, const float *src, size_t n);
+void CANStoreUNorm16Array(uint8_t *dst, size_t stride, const float *src, size_t n);
+void CANStoreUNorm8Array(uint8_t *dst, size_t stride, const float *src, size_t n);
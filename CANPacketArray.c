@@ -0,0 +1,374 @@
+#include "CANPacket.h"
+
+#include <string.h>
+
+/*
+ * The vectorized paths gather a few encoded values into a small buffer, convert them with
+ * integer and float vector operations reproducing the scalar functions step by step, and scatter the results.
+ * Every path finishes the last n % LANES values with the scalar functions.
+ *
+ * Hardware half precision conversion is only used for loading: it is exact except for signaling NaNs,
+ * which get quieted and are patched back. Stores round ties away from 0, while the hardware rounds ties to even,
+ * so Float16 stores are done with integer operations.
+ */
+#if defined(__AVX2__) && defined(__F16C__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CAN_ARRAY_AVX2
+#elif defined(__ARM_NEON) && defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CAN_ARRAY_NEON
+#endif
+
+
+#if defined(CAN_ARRAY_AVX2)
+
+#include <immintrin.h>
+
+#define LANES 8
+
+typedef __m256i VecU32;
+typedef __m256 VecF32;
+
+#define vecShl(v, n) _mm256_slli_epi32(v, n)
+#define vecShr(v, n) _mm256_srli_epi32(v, n)
+
+static inline VecU32 vecSplat(uint32_t value) { return _mm256_set1_epi32((int32_t)value); }
+static inline VecU32 vecLoadU16(const uint16_t *raw) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)raw)); }
+static inline VecU32 vecLoadU32(const uint32_t *raw) { return _mm256_loadu_si256((const __m256i *)raw); }
+static inline VecU32 vecAnd(VecU32 a, VecU32 b) { return _mm256_and_si256(a, b); }
+static inline VecU32 vecOr(VecU32 a, VecU32 b) { return _mm256_or_si256(a, b); }
+static inline VecU32 vecAdd(VecU32 a, VecU32 b) { return _mm256_add_epi32(a, b); }
+static inline VecU32 vecSub(VecU32 a, VecU32 b) { return _mm256_sub_epi32(a, b); }
+static inline VecU32 vecShlVar(VecU32 v, VecU32 count) { return _mm256_sllv_epi32(v, count); }
+static inline VecU32 vecShrVar(VecU32 v, VecU32 count) { return _mm256_srlv_epi32(v, count); }
+static inline VecU32 vecMin(VecU32 a, VecU32 b) { return _mm256_min_epu32(a, b); }
+// Signed comparison, all ones where a > b
+static inline VecU32 vecGreater(VecU32 a, VecU32 b) { return _mm256_cmpgt_epi32(a, b); }
+static inline VecU32 vecSelect(VecU32 mask, VecU32 a, VecU32 b) { return _mm256_blendv_epi8(b, a, mask); }
+
+static inline void vecStoreU16(uint16_t *raw, VecU32 v) {
+    // Values are below 0x10000, so the saturating pack keeps them as they are
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+    _mm_storeu_si128((__m128i *)raw, _mm256_castsi256_si128(packed));
+}
+static inline void vecStoreU32(uint32_t *raw, VecU32 v) { _mm256_storeu_si256((__m256i *)raw, v); }
+
+static inline VecF32 vecLoadF32(const float *values) { return _mm256_loadu_ps(values); }
+static inline void vecStoreF32(float *values, VecF32 v) { _mm256_storeu_ps(values, v); }
+static inline VecF32 vecAsFloat(VecU32 v) { return _mm256_castsi256_ps(v); }
+static inline VecU32 vecAsBits(VecF32 v) { return _mm256_castps_si256(v); }
+// Values are below 2^24, so the conversions are exact
+static inline VecF32 vecToFloat(VecU32 v) { return _mm256_cvtepi32_ps(v); }
+static inline VecF32 vecDiv(VecF32 a, float b) { return _mm256_div_ps(a, _mm256_set1_ps(b)); }
+static inline VecF32 vecHalfToFloat(const uint16_t *raw) { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)raw)); }
+
+#elif defined(CAN_ARRAY_NEON)
+
+#include <arm_neon.h>
+
+#define LANES 4
+
+typedef uint32x4_t VecU32;
+typedef float32x4_t VecF32;
+
+#define vecShl(v, n) vshlq_n_u32(v, n)
+#define vecShr(v, n) vshrq_n_u32(v, n)
+
+static inline VecU32 vecSplat(uint32_t value) { return vdupq_n_u32(value); }
+static inline VecU32 vecLoadU16(const uint16_t *raw) { return vmovl_u16(vld1_u16(raw)); }
+static inline VecU32 vecLoadU32(const uint32_t *raw) { return vld1q_u32(raw); }
+static inline VecU32 vecAnd(VecU32 a, VecU32 b) { return vandq_u32(a, b); }
+static inline VecU32 vecOr(VecU32 a, VecU32 b) { return vorrq_u32(a, b); }
+static inline VecU32 vecAdd(VecU32 a, VecU32 b) { return vaddq_u32(a, b); }
+static inline VecU32 vecSub(VecU32 a, VecU32 b) { return vsubq_u32(a, b); }
+static inline VecU32 vecShlVar(VecU32 v, VecU32 count) { return vshlq_u32(v, vreinterpretq_s32_u32(count)); }
+static inline VecU32 vecShrVar(VecU32 v, VecU32 count) { return vshlq_u32(v, vnegq_s32(vreinterpretq_s32_u32(count))); }
+static inline VecU32 vecMin(VecU32 a, VecU32 b) { return vminq_u32(a, b); }
+// Signed comparison, all ones where a > b
+static inline VecU32 vecGreater(VecU32 a, VecU32 b) { return vcgtq_s32(vreinterpretq_s32_u32(a), vreinterpretq_s32_u32(b)); }
+static inline VecU32 vecSelect(VecU32 mask, VecU32 a, VecU32 b) { return vbslq_u32(mask, a, b); }
+
+static inline void vecStoreU16(uint16_t *raw, VecU32 v) { vst1_u16(raw, vmovn_u32(v)); }
+static inline void vecStoreU32(uint32_t *raw, VecU32 v) { vst1q_u32(raw, v); }
+
+static inline VecF32 vecLoadF32(const float *values) { return vld1q_f32(values); }
+static inline void vecStoreF32(float *values, VecF32 v) { vst1q_f32(values, v); }
+static inline VecF32 vecAsFloat(VecU32 v) { return vreinterpretq_f32_u32(v); }
+static inline VecU32 vecAsBits(VecF32 v) { return vreinterpretq_u32_f32(v); }
+// Values are below 2^24, so the conversions are exact
+static inline VecF32 vecToFloat(VecU32 v) { return vcvtq_f32_u32(v); }
+static inline VecF32 vecDiv(VecF32 a, float b) { return vdivq_f32(a, vdupq_n_f32(b)); }
+static inline VecF32 vecHalfToFloat(const uint16_t *raw) { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(raw))); }
+
+#endif
+
+
+#if defined(CAN_ARRAY_AVX2) || defined(CAN_ARRAY_NEON)
+
+// Moving values between the encoded array and the lane buffers, the target is little endian
+
+static inline void gather16(uint16_t *raw, const uint8_t *src, size_t stride) {
+    if (stride == sizeof(uint16_t)) {
+        memcpy(raw, src, sizeof(uint16_t) * LANES);
+        return;
+    }
+    for (int lane = 0; lane < LANES; ++lane) {
+        memcpy(&raw[lane], src + lane * stride, sizeof(uint16_t));
+    }
+}
+
+static inline void gather24(uint32_t *raw, const uint8_t *src, size_t stride) {
+    for (int lane = 0; lane < LANES; ++lane) {
+        const uint8_t *ptr = src + lane * stride;
+        raw[lane] = (uint32_t)ptr[2] << 16 | (uint32_t)ptr[1] << 8 | ptr[0];
+    }
+}
+
+static inline void gather8(uint32_t *raw, const uint8_t *src, size_t stride) {
+    for (int lane = 0; lane < LANES; ++lane) {
+        raw[lane] = src[lane * stride];
+    }
+}
+
+static inline void scatter16(uint8_t *dst, size_t stride, const uint16_t *raw) {
+    if (stride == sizeof(uint16_t)) {
+        memcpy(dst, raw, sizeof(uint16_t) * LANES);
+        return;
+    }
+    for (int lane = 0; lane < LANES; ++lane) {
+        memcpy(dst + lane * stride, &raw[lane], sizeof(uint16_t));
+    }
+}
+
+static inline void scatter24(uint8_t *dst, size_t stride, const uint32_t *raw) {
+    for (int lane = 0; lane < LANES; ++lane) {
+        memcpy(dst + lane * stride, &raw[lane], 3);
+    }
+}
+
+static inline void scatter8(uint8_t *dst, size_t stride, const uint32_t *raw) {
+    for (int lane = 0; lane < LANES; ++lane) {
+        dst[lane * stride] = (uint8_t)raw[lane];
+    }
+}
+
+
+// Vectorized counterparts of the scalar functions
+
+static inline VecF32 decodeFloat16(const uint16_t *raw) {
+    VecU32 half = vecLoadU16(raw);
+    VecF32 converted = vecHalfToFloat(raw);
+    // The scalar function keeps signaling NaNs signaling
+    VecU32 nan = vecGreater(vecAnd(half, vecSplat(0x7FFF)), vecSplat(0x7C00));
+    VecU32 exact = vecOr(vecOr(vecShl(vecAnd(half, vecSplat(0x8000)), 16), vecSplat(0x7F800000)),
+                         vecShl(vecAnd(half, vecSplat(0x3FF)), 13));
+    return vecAsFloat(vecSelect(nan, exact, vecAsBits(converted)));
+}
+
+static inline VecF32 decodeBFloat24(const uint32_t *raw) {
+    return vecAsFloat(vecShl(vecLoadU32(raw), 8));
+}
+
+static inline VecF32 decodeBFloat16(const uint16_t *raw) {
+    return vecAsFloat(vecShl(vecLoadU16(raw), 16));
+}
+
+static inline VecF32 decodeUNorm24(const uint32_t *raw) {
+    return vecDiv(vecToFloat(vecLoadU32(raw)), 16777215.0f);
+}
+
+static inline VecF32 decodeUNorm16(const uint16_t *raw) {
+    return vecDiv(vecToFloat(vecLoadU16(raw)), 65535.0f);
+}
+
+static inline VecF32 decodeUNorm8(const uint32_t *raw) {
+    return vecDiv(vecToFloat(vecLoadU32(raw)), 255.0f);
+}
+
+static inline void encodeFloat16(uint16_t *raw, VecF32 values) {
+    VecU32 bits = vecAsBits(values);
+    VecU32 sign = vecAnd(vecShr(bits, 16), vecSplat(0x8000));
+    VecU32 exp = vecAnd(vecShr(bits, 23), vecSplat(0xFF)); // biased by 127
+    VecU32 mantissa = vecAnd(bits, vecSplat(0x7FFFFF));
+
+    // normal number, the rounding may carry into the exponent
+    VecU32 normal = vecAdd(vecAdd(vecShl(vecSub(exp, vecSplat(127 - 15)), 10), vecShr(mantissa, 13)),
+                           vecAnd(vecShr(mantissa, 12), vecSplat(1)));
+    // subnormal in half precision, shifted right by 13 + -14 - (exp - 127)
+    VecU32 implicit = vecOr(mantissa, vecSplat(1 << 23));
+    VecU32 shift = vecSub(vecSplat(126), exp);
+    VecU32 subnormal = vecAdd(vecShrVar(implicit, shift),
+                              vecAnd(vecShrVar(implicit, vecSub(shift, vecSplat(1))), vecSplat(1)));
+    // Clamped to infinity, NaN is positive with all mantissa bits set
+    VecU32 nan = vecGreater(vecAnd(bits, vecSplat(0x7FFFFFFF)), vecSplat(0x7F800000));
+    VecU32 large = vecSelect(nan, vecSplat(0x7FFF), vecOr(sign, vecSplat(0x7C00)));
+
+    VecU32 result = vecAdd(sign, normal);
+    result = vecSelect(vecGreater(vecSplat(127 - 14), exp), vecAdd(sign, subnormal), result);
+    result = vecSelect(vecGreater(vecSplat(127 - 25), exp), sign, result);
+    result = vecSelect(vecGreater(exp, vecSplat(127 + 15)), large, result);
+    vecStoreU16(raw, result);
+}
+
+static inline void encodeBFloat24(uint32_t *raw, VecF32 values) {
+    VecU32 bits = vecAsBits(values);
+    vecStoreU32(raw, vecAdd(vecShr(bits, 8), vecAnd(vecShr(bits, 7), vecSplat(1))));
+}
+
+static inline void encodeBFloat16(uint16_t *raw, VecF32 values) {
+    VecU32 bits = vecAsBits(values);
+    // The scalar function wraps 0xFFFF rounded up to 0
+    VecU32 rounded = vecAdd(vecShr(bits, 16), vecAnd(vecShr(bits, 15), vecSplat(1)));
+    vecStoreU16(raw, vecAnd(rounded, vecSplat(0xFFFF)));
+}
+
+static inline VecU32 encodeUNorm(VecF32 values, uint8_t maxBits) {
+    // The rounding of unormScale in 32 bits: value * (2^maxBits - 1) is (mantissa - mantissa / 2^maxBits) * 2^-shift
+    // with shift = 150 - exp - maxBits, rounding mantissa * 2^-shift and correcting for the fraction
+    // mantissa / 2^maxBits, which is below 2^shift and so takes at most 1 off
+    VecU32 bits = vecAsBits(values);
+    VecU32 mantissa = vecOr(vecAnd(bits, vecSplat(0x7FFFFF)), vecSplat(1 << 23));
+    // From a shift of 25 on the result rounds to 0, as the mantissa is below 2^24
+    VecU32 shift = vecMin(vecSub(vecSplat(150 - maxBits), vecShr(bits, 23)), vecSplat(25));
+    VecU32 biased = vecAdd(mantissa, vecShlVar(vecSplat(1), vecSub(shift, vecSplat(1))));
+    VecU32 quotient = vecShrVar(biased, shift);
+    VecU32 remainder = vecSub(biased, vecShlVar(quotient, shift));
+    // Rounded up mantissa / 2^maxBits, the remainder is an integer
+    VecU32 fraction = vecShrVar(vecAdd(mantissa, vecSplat((1u << maxBits) - 1)), vecSplat(maxBits));
+    // The comparison is all ones (-1) where the fraction takes 1 off
+    VecU32 scaled = vecAdd(quotient, vecGreater(fraction, remainder));
+
+    // 0 < value < 1 is scaled, 1 up to infinity clamps to the maximum, the rest (negative, 0 and NaN) to 0
+    VecU32 inRange = vecAnd(vecGreater(bits, vecSplat(0)), vecGreater(vecSplat(0x3F800000), bits));
+    VecU32 large = vecAnd(vecGreater(bits, vecSplat(0x3F7FFFFF)), vecGreater(vecSplat(0x7F800001), bits));
+    return vecSelect(inRange, scaled, vecAnd(large, vecSplat((1u << maxBits) - 1)));
+}
+
+static inline void encodeUNorm16(uint16_t *raw, VecF32 values) {
+    vecStoreU16(raw, encodeUNorm(values, 16));
+}
+
+static inline void encodeUNorm8(uint32_t *raw, VecF32 values) {
+    vecStoreU32(raw, encodeUNorm(values, 8));
+}
+
+/**
+ * Loads LANES values at a time while enough are left, uses i, src, stride, dst and n of the array function
+ */
+#define CAN_ARRAY_LOAD_LANES(FORMAT, RAW_T, GATHER)         \
+    for (; i + LANES <= n; i += LANES) {                    \
+        RAW_T raw[LANES];                                   \
+        GATHER(raw, src + i * stride, stride);              \
+        vecStoreF32(dst + i, decode##FORMAT(raw));          \
+    }
+
+/**
+ * Stores LANES values at a time while enough are left, uses i, dst, stride, src and n of the array function
+ */
+#define CAN_ARRAY_STORE_LANES(FORMAT, RAW_T, SCATTER)       \
+    for (; i + LANES <= n; i += LANES) {                    \
+        RAW_T raw[LANES];                                   \
+        encode##FORMAT(raw, vecLoadF32(src + i));           \
+        SCATTER(dst + i * stride, stride, raw);             \
+    }
+
+#else
+
+#define CAN_ARRAY_LOAD_LANES(FORMAT, RAW_T, GATHER)
+#define CAN_ARRAY_STORE_LANES(FORMAT, RAW_T, SCATTER)
+
+#endif
+
+
+void CANLoadFloat16Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(Float16, uint16_t, gather16)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadFloat16(src + i * stride);
+    }
+}
+
+void CANLoadBFloat24Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(BFloat24, uint32_t, gather24)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadBFloat24(src + i * stride);
+    }
+}
+
+void CANLoadBFloat16Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(BFloat16, uint16_t, gather16)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadBFloat16(src + i * stride);
+    }
+}
+
+void CANLoadUNorm24Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(UNorm24, uint32_t, gather24)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadUNorm24(src + i * stride);
+    }
+}
+
+void CANLoadUNorm16Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(UNorm16, uint16_t, gather16)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadUNorm16(src + i * stride);
+    }
+}
+
+void CANLoadUNorm8Array(const uint8_t *src, size_t stride, float *dst, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_LOAD_LANES(UNorm8, uint32_t, gather8)
+    for (; i < n; ++i) {
+        dst[i] = CANLoadUNorm8(src + i * stride);
+    }
+}
+
+void CANStoreFloat16Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_STORE_LANES(Float16, uint16_t, scatter16)
+    for (; i < n; ++i) {
+        CANStoreFloat16(dst + i * stride, src[i]);
+    }
+}
+
+void CANStoreBFloat24Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_STORE_LANES(BFloat24, uint32_t, scatter24)
+    for (; i < n; ++i) {
+        CANStoreBFloat24(dst + i * stride, src[i]);
+    }
+}
+
+void CANStoreBFloat16Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_STORE_LANES(BFloat16, uint16_t, scatter16)
+    for (; i < n; ++i) {
+        CANStoreBFloat16(dst + i * stride, src[i]);
+    }
+}
+
+void CANStoreUNorm24Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    // Not vectorized, CANStoreUNorm24 rounds with a 48 bit product
+    for (size_t i = 0; i < n; ++i) {
+        CANStoreUNorm24(dst + i * stride, src[i]);
+    }
+}
+
+void CANStoreUNorm16Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_STORE_LANES(UNorm16, uint16_t, scatter16)
+    for (; i < n; ++i) {
+        CANStoreUNorm16(dst + i * stride, src[i]);
+    }
+}
+
+void CANStoreUNorm8Array(uint8_t *dst, size_t stride, const float *src, size_t n) {
+    size_t i = 0;
+    CAN_ARRAY_STORE_LANES(UNorm8, uint32_t, scatter8)
+    for (; i < n; ++i) {
+        CANStoreUNorm8(dst + i * stride, src[i]);
+    }
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANHelpers.h"
+
+#include <string.h>
+
+/**
+ * This header defines the CANLoad and CANStore functions declared in CANPacket.h
+ * It is compiled once into CANPacket.c, or included by CANPacket.h when CAN_HEADER_ONLY is defined,
+ * so the functions are inlined into the packet builders and decoders (except CANStoreFloat16, see CAN_CODEC_OUT_OF_LINE)
+ * There should probably be no reason to include this file directly
+ */
+
+CAN_STATIC_ASSERT(sizeof(float) == sizeof(uint32_t), "floats are expected to be IEEE 754 single precision");
+
+// Half precision conversion instructions used by CANLoadFloat16 and CANStoreFloat16, see CAN_HARDWARE_FLOAT16
+#if defined(CAN_HARDWARE_FLOAT16)
+#if defined(__ARM_FP) && (__ARM_FP & 2) && defined(__ARM_FP16_FORMAT_IEEE)
+#define CAN_FLOAT16_HARDWARE
+#elif defined(__F16C__)
+#include <immintrin.h>
+#define CAN_FLOAT16_HARDWARE
+#define CAN_FLOAT16_F16C
+#endif
+#endif
+
+/**
+ * Returns the 32 bit unsigned value stored at the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC uint32_t CANLoadUInt32(const uint8_t *ptr) {
+    uint32_t result;
+    memcpy(&result, ptr, sizeof(uint32_t));
+    if (!little_endian()) {
+        result = bswap32(result);
+    }
+    return result;
+}
+
+/**
+ * Returns the 32 bit signed value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC int32_t CANLoadInt32(const uint8_t *ptr) {
+    return (int32_t)CANLoadUInt32(ptr);
+}
+
+/**
+ * Returns the 24 bit unsigned value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC uint32_t CANLoadUInt24(const uint8_t *ptr) {
+    return ptr[2] << 16 | ptr[1] << 8 | ptr[0];
+}
+
+/**
+ * Returns the 24 bit unsigned value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ * The value is sign extended to 32 bits
+ */
+CAN_CODEC int32_t CANLoadInt24(const uint8_t *ptr) {
+    uint32_t zeroExtended = CANLoadUInt24(ptr);
+    uint32_t negative = -(zeroExtended & 0x800000);
+    // Sign extended upper bits of the result
+    uint32_t upperBits = 0xFF000000 & negative;
+    return (int32_t)(zeroExtended | upperBits);
+}
+
+/**
+ * Returns the 16 bit unsigned value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC uint16_t CANLoadUInt16(const uint8_t *ptr) {
+    uint16_t result;
+    memcpy(&result, ptr, sizeof(uint16_t));
+    if (!little_endian()) {
+        result = bswap16(result);
+    }
+    return result;
+}
+
+/**
+ * Returns the 16 bit signed value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC int16_t CANLoadInt16(const uint8_t *ptr) {
+    return (int16_t)CANLoadUInt16(ptr);
+}
+
+/**
+ * Returns the 32 bit float value stored in the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes floats are 4 bytes in size
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes floats use the same endianness as ints
+ */
+CAN_CODEC float CANLoadFloat32(const uint8_t *ptr) {
+    uint32_t intVal = CANLoadUInt32(ptr);
+    float floatVal;
+    memcpy(&floatVal, &intVal, sizeof(float));
+    return floatVal;
+}
+
+/**
+ * Returns the 24 bit float value stored in the given memory location
+ * The 24 bit floats are truncated 32 bit floats
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes floats are 4 bytes in size
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes floats use the same endianness as ints
+ */
+CAN_CODEC float CANLoadBFloat24(const uint8_t *ptr) {
+    uint32_t intVal = CANLoadUInt24(ptr) << 8;
+    float floatVal;
+    memcpy(&floatVal, &intVal, sizeof(float));
+    return floatVal;
+}
+
+/**
+ * Returns the 16 bit brain float value stored in the given memory location
+ * 16 bit brain floats are truncated 32 bit floats
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes floats are 4 bytes in size
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes floats use the same endianness as ints
+ */
+CAN_CODEC float CANLoadBFloat16(const uint8_t *ptr) {
+    uint32_t intVal = (uint32_t)CANLoadUInt16(ptr) << 16;
+    float floatVal;
+    memcpy(&floatVal, &intVal, sizeof(float));
+    return floatVal;
+}
+
+#if defined(CAN_FLOAT16_HARDWARE)
+
+#if defined(CAN_FLOAT16_F16C)
+static inline float hardwareHalfToFloat(uint16_t half) {
+    return _cvtsh_ss(half);
+}
+
+static inline uint16_t hardwareFloatToHalf(float value) {
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+}
+#else
+static inline float hardwareHalfToFloat(uint16_t half) {
+    __fp16 value;
+    memcpy(&value, &half, sizeof(uint16_t));
+    return value;
+}
+
+static inline uint16_t hardwareFloatToHalf(float value) {
+    // Uses the rounding mode of the FPU, which is round to nearest (ties to even) unless changed
+    __fp16 half = value;
+    uint16_t result;
+    memcpy(&result, &half, sizeof(uint16_t));
+    return result;
+}
+#endif
+
+/**
+ * Indicates if converting a float to half precision is a tie that rounding to even leaves rounded towards 0,
+ * i.e. the bits dropped are exactly half of the last bit kept, and the last bit kept is 0
+ */
+static inline bool float16TieRoundedDown(uint32_t intVal) {
+    int16_t exp = ((intVal & 0x7F800000) >> 23) - 127;
+    if (exp < -25 || exp >= 0x10) {
+        return false;
+    }
+    uint32_t mantissa = (intVal & 0x7FFFFF) | 1 << 23;
+    // 13 bits are dropped for normal results, more for subnormal ones
+    uint8_t dropped = exp < -14 ? -1 - exp : 13;
+    uint32_t mask = (2u << dropped) - 1;
+    return (mantissa & mask) == 1u << (dropped - 1);
+}
+
+#endif
+
+/**
+ * Returns the 16 bit float value stored in the given memory location
+ * 16 bit floats are IEEE 754 half precision floats
+ * Correctly handles subnormals
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes floats are 4 bytes in size
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes floats use the same endianness as ints
+ */
+CAN_CODEC float CANLoadFloat16(const uint8_t *ptr) {
+    uint16_t intVal = CANLoadUInt16(ptr);
+#if defined(CAN_FLOAT16_HARDWARE)
+    // The conversion is exact, but quiets signaling NaNs, so NaNs are left to the code below
+    if ((intVal & 0x7FFF) <= 0x7C00) {
+        return hardwareHalfToFloat(intVal);
+    }
+#endif
+    int16_t exp = ((intVal & 0x7C00) >> 10) - 15;
+    uint8_t sign = intVal >= 0x8000;
+    uint16_t mantissa = intVal & 0x3FF;
+
+    if (exp == 0x10) {
+        // handle inf/nan
+        exp = 128;
+    } else if (exp == -15) {
+        // handle subnormals
+        if (mantissa == 0) {
+            exp = -127;
+        } else {
+            uint8_t lz = clz16(mantissa) - 5;
+            exp -= lz - 1;
+            mantissa <<= lz;
+            mantissa &= 0x3FF;
+        }
+    }
+
+    uint32_t newIntVal = sign << 31 | (exp + 127) << 23 | mantissa << 13;
+    float result;
+    memcpy(&result, &newIntVal, sizeof(float));
+    return result;
+}
+
+/**
+ * Returns the 24 bit unsigned normalized value stored at the given memory location
+ * 24 bit UNorm values map the range 0x000000-0xFFFFFF to the range 0.0-1.0
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC float CANLoadUNorm24(const uint8_t *ptr) {
+    uint32_t intVal = CANLoadUInt24(ptr);
+    return intVal / 16777215.0f;
+}
+
+/**
+ * Returns the 16 bit unsigned normalized value stored in the given memory location
+ * 16 bit UNorm values map the range 0-65535 to the range 0.0-1.0
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC float CANLoadUNorm16(const uint8_t *ptr) {
+    uint16_t intVal = CANLoadUInt16(ptr);
+    return intVal / 65535.0f;
+}
+
+/**
+ * Returns the 8 bit unsigned normalized value stored in the given memory location
+ * 8 bit UNorm values map the range 0-255 to the range 0.0-1.0
+ */
+CAN_CODEC float CANLoadUNorm8(const uint8_t *ptr) {
+    return *ptr / 255.0f;
+}
+
+/**
+ * Stores a 32 bit unsigned integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreUInt32(uint8_t *ptr, uint32_t value) {
+    if (!little_endian()) {
+        value = bswap32(value);
+    }
+    memcpy(ptr, &value, sizeof(uint32_t));
+}
+
+/**
+ * Stores a 32 bit signed integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreInt32(uint8_t *ptr, int32_t value) {
+    CANStoreUInt32(ptr, (uint32_t)value);
+}
+
+/**
+ * Stores a 24 bit unsigned integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ * Ignores the upper 8 bits of the 32 bit value
+ * Assumes sizeof(int32_t) == 4
+ */
+CAN_CODEC void CANStoreUInt24(uint8_t *ptr, int32_t value) {
+    if (!little_endian()) {
+        value = bswap32(value);
+    }
+    memcpy(ptr, (char *)&value, 3);
+}
+
+/**
+ * Stores a 24 bit signed integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ * Ignores the upper 8 bits of the 32 bit value
+ * Assumes sizeof(int32_t) == 4
+ */
+CAN_CODEC void CANStoreInt24(uint8_t *ptr, int32_t value) {
+    CANStoreUInt24(ptr, (uint32_t)value);
+}
+
+/**
+ * Stores a 16 bit unsigned integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreUInt16(uint8_t *ptr, uint16_t value) {
+    if (!little_endian()) {
+        value = bswap16(value);
+    }
+    memcpy(ptr, &value, sizeof(uint16_t));
+}
+
+/**
+ * Stores a 16 bit signed integer into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreInt16(uint8_t *ptr, int16_t value) {
+    CANStoreUInt16(ptr, (uint16_t)value);
+}
+
+/**
+ * Stores a 32 bit float into the given memory location
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes sizeof(float) == sizeof(uint32_t)
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes the float endianness is the same as int endianness
+ */
+CAN_CODEC void CANStoreFloat32(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    memcpy(&intVal, &value, sizeof(float));
+    CANStoreUInt32(ptr, intVal);
+}
+
+/**
+ * Stores a 24 bit float into the given memory location
+ * The 24 bit float is a truncated IEEE 754 single precision float
+ * Non standard float format
+ * Uses the round to nearest (ties away from 0) rounding mode
+ * Clamps out of range values
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes sizeof(float) == sizeof(uint32_t)
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes the float endianness is the same as int endianness
+ */
+CAN_CODEC void CANStoreBFloat24(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    memcpy(&intVal, &value, sizeof(float));
+    uint32_t rounded = (intVal >> 8) + ((intVal >> 7) & 1);
+    CANStoreUInt24(ptr, rounded);
+}
+
+/**
+ * Stores a 16 bit brain float into the given memory location
+ * Brain floats are truncated IEEE 754 single precision floats
+ * Uses the round to nearest (ties away from 0) rounding mode
+ * Clamps out of range values
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes sizeof(float) == sizeof(uint32_t)
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes the float endianness is the same as int endianness
+ */
+CAN_CODEC void CANStoreBFloat16(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    memcpy(&intVal, &value, sizeof(float));
+    uint16_t rounded = (uint16_t)((intVal >> 16) + ((intVal >> 15) & 1));
+    CANStoreUInt16(ptr, rounded);
+}
+
+/**
+ * Stores a 16 bit float into the given memory location
+ * 16 bit floats are IEEE 754 half precision floats
+ * Uses the round to nearest (ties away from 0) rounding mode
+ * Enforces LE and the location is allowed to be misaligned
+ * Assumes sizeof(float) == sizeof(uint32_t)
+ * Assumes all parties use IEEE 754 single precision floats
+ * Assumes the float endianness is the same as int endianness
+ */
+CAN_CODEC_OUT_OF_LINE void CANStoreFloat16(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    memcpy(&intVal, &value, sizeof(float));
+#if defined(CAN_FLOAT16_HARDWARE)
+    // The conversion rounds ties to even, NaNs are left to the code below to get the canonical 0x7FFF
+    if (value == value) {
+        uint16_t half = hardwareFloatToHalf(value);
+        if (float16TieRoundedDown(intVal)) {
+            // Magnitude rounded away from 0 instead
+            ++half;
+        }
+        CANStoreUInt16(ptr, half);
+        return;
+    }
+#endif
+    uint8_t sign = intVal >> 31;
+    int16_t exp = ((intVal & 0x7F800000) >> 23) - 127;
+    uint32_t mantissa = intVal & 0x7FFFFF;
+
+    uint8_t newExp;
+    uint16_t newMantissa;
+    if (exp >= 0x10) {
+        if (value == value) {
+            // Clamp to infinity
+            newExp = 0x1F;
+            newMantissa = 0;
+        } else {
+            // NaN
+            sign = 0;
+            newExp = 0x1F;
+            newMantissa = 0x3FF;
+        }
+    } else if (exp < -25) { // Clamped to 0
+        newExp = 0;
+        newMantissa = 0;
+    } else if (exp < -14) {
+        // subnormal in half precision
+        mantissa |= 1 << 23;
+        // round to nearest, ties away from 0
+        newMantissa = (mantissa >> (13 + -14 - exp)) + ((mantissa >> (12 + -14 - exp)) & 1);
+        newExp = 0;
+    } else {
+        // normal number
+        newExp = exp + 15;
+        // round to nearest, ties away from 0
+        newMantissa = (mantissa >> 13) + ((mantissa >> 12) & 1);
+    }
+    // Added rather than or'ed, so a mantissa rounded up to 0x400 carries into the exponent
+    uint16_t resultValue = (sign << 15) + (newExp << 10) + newMantissa;
+    CANStoreUInt16(ptr, resultValue);
+}
+
+/**
+ * Returns value * max rounded to nearest, ties away from 0, for 0 < value < 1
+ * max has maxBits bits, the product is computed with integers as a float one would round before the rounding to an integer
+ */
+static inline uint32_t unormScale(float value, uint32_t max, uint8_t maxBits) {
+    uint32_t floatBits;
+    memcpy(&floatBits, &value, sizeof(float));
+    // value is mantissa * 2^-shift, shift is at least 24 as value < 1
+    uint8_t shift = 150 - (floatBits >> 23);
+    uint64_t scaled = (uint64_t)((floatBits & 0x7FFFFF) | 1 << 23) * max;
+    // scaled has 24 + maxBits bits, with a larger shift the result rounds to 0
+    return shift < 25 + maxBits ? (uint32_t)((scaled + ((uint64_t)1 << (shift - 1))) >> shift) : 0;
+}
+
+/**
+ * Stores a 24 bit unsigned normalized value into the given memory location
+ * 24 bit UNorms map the range 0x000000-0xFFFFFF into the range 0.0-1.0
+ * Rounds to nearest representable value, with ties away from 0
+ * Clamps out of range values, NaN is stored as 0
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreUNorm24(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    if (value >= 1.0f) {
+        intVal = 0xFFFFFF;
+    } else if (!(value > 0.0f)) {
+        // Negative or NaN
+        intVal = 0;
+    } else {
+        intVal = unormScale(value, 0xFFFFFF, 24);
+    }
+    CANStoreUInt24(ptr, intVal);
+}
+
+/**
+ * Stores a 16 bit unsigned normalized value into the given memory location
+ * 16 bit UNorms map the range 0-65535 into the range 0.0-1.0
+ * Rounds to nearest representable value, with ties away from 0
+ * Clamps out of range values, NaN is stored as 0
+ * Enforces LE and the location is allowed to be misaligned
+ */
+CAN_CODEC void CANStoreUNorm16(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    if (value >= 1.0f) {
+        intVal = 0xFFFF;
+    } else if (!(value > 0.0f)) {
+        // Negative or NaN
+        intVal = 0;
+    } else {
+        intVal = unormScale(value, 0xFFFF, 16);
+    }
+    CANStoreUInt16(ptr, (uint16_t)intVal);
+}
+
+/**
+ * Stores an 8 bit unsigned normalized value into the given memory location
+ * 8 bit UNorms map the range 0-255 into the range 0.0-1.0
+ * Rounds to nearest representable value, with ties away from 0
+ * Clamps out of range values, NaN is stored as 0
+ */
+CAN_CODEC void CANStoreUNorm8(uint8_t *ptr, float value) {
+    uint32_t intVal;
+    if (value >= 1.0f) {
+        intVal = 0xFF;
+    } else if (!(value > 0.0f)) {
+        // Negative or NaN
+        intVal = 0;
+    } else {
+        intVal = unormScale(value, 0xFF, 8);
+    }
+    *ptr = (uint8_t)intVal;
+}
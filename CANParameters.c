@@ -0,0 +1,110 @@
+#include "CANParameters.h"
+
+#include <string.h>
+
+static void startBatch(CANParameterBatch_t *batch, bool write, CANRequestTracker_t *tracker, CANDevice_t sender,
+                       CANDevice_t device, CANParameter_t *parameters, uint16_t count,
+                       uint8_t maxInFlight, uint32_t timeoutMicros) {
+    memset(batch, 0, sizeof(CANParameterBatch_t));
+    batch->tracker = tracker;
+    batch->sender = sender;
+    batch->device = device;
+    batch->parameters = parameters;
+    batch->count = parameters ? count : 0;
+    batch->write = write;
+    batch->maxInFlight = maxInFlight == 0 ? 1 : maxInFlight > CAN_PARAMETER_MAX_IN_FLIGHT ? CAN_PARAMETER_MAX_IN_FLIGHT : maxInFlight;
+    batch->timeoutMicros = timeoutMicros;
+    for (uint16_t i = 0; i < batch->count; ++i) {
+        parameters[i].status = CAN_PARAMETER_PENDING;
+    }
+}
+
+
+void CANParameterWriteStart(CANParameterBatch_t *batch, CANRequestTracker_t *tracker, CANDevice_t sender,
+                            CANDevice_t device, CANParameter_t *parameters, uint16_t count,
+                            uint8_t maxInFlight, uint32_t timeoutMicros) {
+    startBatch(batch, true, tracker, sender, device, parameters, count, maxInFlight, timeoutMicros);
+}
+
+
+void CANParameterReadStart(CANParameterBatch_t *batch, CANRequestTracker_t *tracker, CANDevice_t sender,
+                           CANDevice_t device, CANParameter_t *parameters, uint16_t count,
+                           uint8_t maxInFlight, uint32_t timeoutMicros) {
+    startBatch(batch, false, tracker, sender, device, parameters, count, maxInFlight, timeoutMicros);
+}
+
+
+static void onResult(uint8_t status, const CANPacket_t *response, void *context) {
+    CANParameterRequest_t *request = (CANParameterRequest_t *)context;
+    CANParameterBatch_t *batch = request->batch;
+    CANParameter_t *parameter = &batch->parameters[request->index];
+    request->batch = NULL;
+    --batch->inFlight;
+
+    if (status == CAN_OK) {
+        uint32_t value = CANMotorPacket_BLDC_DirectReadResult_Decode(response).value;
+        if (batch->write && value != parameter->value) {
+            status = CAN_ERROR;
+        }
+        parameter->value = value;
+    }
+    parameter->status = status;
+    if (status == CAN_OK) {
+        ++batch->succeeded;
+    } else {
+        ++batch->failed;
+    }
+}
+
+
+/**
+ * Finishes the next parameter without a response, after its request could not be sent
+ */
+static void skipNext(CANParameterBatch_t *batch, uint8_t status) {
+    batch->parameters[batch->next].status = status;
+    ++batch->failed;
+    ++batch->next;
+    batch->nextWritten = false;
+}
+
+
+bool CANParameterPoll(CANParameterBatch_t *batch) {
+    while (batch->next < batch->count && batch->inFlight < batch->maxInFlight) {
+        CANParameter_t *parameter = &batch->parameters[batch->next];
+        uint8_t status;
+        if (batch->write && !batch->nextWritten) {
+            CANPacket_t write = CANMotorPacket_BLDC_DirectWrite(batch->sender, batch->device,
+                                                                parameter->endpointID, parameter->value);
+            status = CANSend(batch->tracker->handle, &write);
+            if (status == CAN_BUSY) {
+                break;
+            } else if (status != CAN_OK) {
+                skipNext(batch, status);
+                continue;
+            }
+            batch->nextWritten = true;
+        }
+
+        CANParameterRequest_t *request = batch->requests;
+        while (request->batch) {
+            ++request;
+        }
+        request->batch = batch;
+        request->index = batch->next;
+        CANPacket_t read = CANMotorPacket_BLDC_DirectRead(batch->sender, batch->device, parameter->endpointID);
+        status = CANRequestSend(batch->tracker, &read, batch->timeoutMicros, onResult, request);
+        if (status != CAN_OK) {
+            request->batch = NULL;
+            if (status == CAN_BUSY) {
+                // The tracker or the port is full, retried on the next poll
+                break;
+            }
+            skipNext(batch, status);
+            continue;
+        }
+        ++batch->inFlight;
+        ++batch->next;
+        batch->nextWritten = false;
+    }
+    return batch->next == batch->count && batch->inFlight == 0;
+}
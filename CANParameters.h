@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANRequest.h"
+#include "Packets/DecodeMotor.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the bulk parameter API, reading or writing many ODrive endpoints of a BLDC
+ * with a bounded number of requests in flight instead of one round trip per endpoint:
+ *
+ *   CANParameter_t config[] = {
+ *       {.endpointID = 0x0123, .value = 40},
+ *       {.endpointID = 0x0124, .value = CANParameterFloat(10.0f)},
+ *       ...
+ *   };
+ *   CANParameterBatch_t batch;
+ *   CANParameterWriteStart(&batch, &requests, jetson, bldc, config, count, 4, 20000);
+ *   while (!CANParameterPoll(&batch)) {
+ *       while (CANPollAndReceive(handle, &packet) > 0) {
+ *           CANRequestHandleResponse(&requests, &packet);
+ *       }
+ *       CANRequestPoll(&requests);
+ *   }
+ *   // config[i].status is CAN_OK for every endpoint written and read back unchanged
+ *
+ * A write sends BLDC_DirectWrite followed by BLDC_DirectRead of the same endpoint, and the DirectReadResult
+ * (matched by its endpoint through the request tracker) confirms the value. Frames from one sender to one device
+ * keep their order on the bus, so the read always sees the write.
+ * Batches for several devices can share a tracker and run at the same time, so all BLDCs configure in parallel.
+ */
+
+/**
+ * Largest number of requests one batch keeps in flight
+ */
+#ifndef CAN_PARAMETER_MAX_IN_FLIGHT
+#define CAN_PARAMETER_MAX_IN_FLIGHT 8
+#endif
+
+/**
+ * Status of a parameter not finished yet
+ */
+#define CAN_PARAMETER_PENDING 0xFF
+
+typedef struct {
+    uint16_t endpointID;
+    uint32_t value;  // value to write, or the value read
+    uint8_t status;  // CAN_OK, CAN_ERROR if the value read back differs, CAN_TIMEOUT, or CAN_PARAMETER_PENDING
+} CANParameter_t;
+
+struct CANParameterBatch;
+
+typedef struct {
+    struct CANParameterBatch *batch;
+    uint16_t index; // of the parameter the request is for
+} CANParameterRequest_t;
+
+typedef struct CANParameterBatch {
+    CANRequestTracker_t *tracker;
+    CANDevice_t sender;
+    CANDevice_t device;
+    CANParameter_t *parameters;
+    uint16_t count;
+    uint16_t next;       // next parameter to request
+    bool nextWritten;    // the write of the next parameter is sent, its read is not
+    bool write;
+    uint8_t maxInFlight;
+    uint8_t inFlight;
+    uint16_t succeeded;
+    uint16_t failed;
+    uint32_t timeoutMicros;
+    CANParameterRequest_t requests[CAN_PARAMETER_MAX_IN_FLIGHT];
+} CANParameterBatch_t;
+
+/**
+ * Starts writing parameters to a device, each is read back to confirm it
+ * @param batch Batch to start, must stay in place until finished
+ * @param tracker Tracker the read backs are matched with, its responses have to be handled as usual
+ * @param sender This device
+ * @param device BLDC to configure
+ * @param parameters Endpoints and values, status is filled in as the batch progresses
+ * @param count Number of parameters
+ * @param maxInFlight Number of parameters in flight at once, at most CAN_PARAMETER_MAX_IN_FLIGHT
+ * @param timeoutMicros Time to wait for each read back
+ */
+void CANParameterWriteStart(CANParameterBatch_t *batch, CANRequestTracker_t *tracker, CANDevice_t sender,
+                            CANDevice_t device, CANParameter_t *parameters, uint16_t count,
+                            uint8_t maxInFlight, uint32_t timeoutMicros);
+
+/**
+ * Starts reading parameters from a device, each value is filled in when its result arrives
+ * Same arguments as CANParameterWriteStart
+ */
+void CANParameterReadStart(CANParameterBatch_t *batch, CANRequestTracker_t *tracker, CANDevice_t sender,
+                           CANDevice_t device, CANParameter_t *parameters, uint16_t count,
+                           uint8_t maxInFlight, uint32_t timeoutMicros);
+
+/**
+ * Sends requests until maxInFlight are in flight
+ * Should be called regularly until it returns true
+ * @return true once every parameter has finished, see the succeeded and failed counts
+ */
+bool CANParameterPoll(CANParameterBatch_t *batch);
+
+/**
+ * Returns the raw value of a float parameter
+ */
+inline static uint32_t CANParameterFloat(float value) {
+    union { float f; uint32_t u; } raw = {.f = value};
+    return raw.u;
+}
@@ -0,0 +1,168 @@
+#include "CANRequest.h"
+#include "Packets/Schema.h"
+
+#include <string.h>
+
+/**
+ * Converts a timeout to ticks of the handle's timestamp clock
+ */
+static CANTimestamp_t timeoutTicks(const CANRequestTracker_t *tracker, uint32_t timeoutMicros) {
+    return (CANTimestamp_t)timeoutMicros * tracker->timestampFrequency / 1000000u;
+}
+
+
+void CANRequestInit(CANRequestTracker_t *tracker, CANHandle_t CANHandle) {
+    memset(tracker, 0, sizeof(CANRequestTracker_t));
+    tracker->handle = CANHandle;
+    tracker->timestampFrequency = CANGetTimestampFrequency(CANHandle);
+}
+
+
+bool CANRequestResponseKey(const CANPacket_t *response, uint16_t *key) {
+    switch (response->command & 0x7F) {
+        case CAN_COMMAND_ID__ACKNOWLEDGE:
+            *key = response->contents[CAN_SCHEMA_OFFSET(CANUniversalPacket_Acknowledge, commandID)] & 0x7F;
+            return true;
+        case CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT:
+            *key = CANLoadUInt16(response->contents + CAN_SCHEMA_OFFSET(CANMotorPacket_BLDC_DirectReadResult, endpointID));
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * Adds a pending request, returns NULL if the tracker is full
+ */
+static CANRequest_t *addRequest(CANRequestTracker_t *tracker, CANDeviceUUID_t peer, CANCommand_t responseCommand,
+                                bool keyed, uint16_t key, uint32_t timeoutMicros,
+                                CANRequestCallback_t callback, void *context) {
+    if (tracker->pending == CAN_REQUEST_MAX_PENDING) {
+        return NULL;
+    }
+
+    CANRequest_t *request = tracker->requests;
+    while (request->active) {
+        ++request;
+    }
+    request->active = true;
+    request->keyed = keyed;
+    request->peer = peer;
+    request->responseCommand = responseCommand & 0x7F;
+    request->key = key;
+    request->sequence = tracker->sequence++;
+    request->deadline = CANGetTimestamp(tracker->handle) + timeoutTicks(tracker, timeoutMicros);
+    request->callback = callback;
+    request->context = context;
+    ++tracker->pending;
+    return request;
+}
+
+
+uint8_t CANRequestExpect(CANRequestTracker_t *tracker, CANDeviceUUID_t peer, CANCommand_t responseCommand,
+                         bool keyed, uint16_t key, uint32_t timeoutMicros,
+                         CANRequestCallback_t callback, void *context) {
+    if (!tracker || !callback) {
+        return CAN_ERROR;
+    }
+
+    return addRequest(tracker, peer, responseCommand, keyed, key, timeoutMicros, callback, context) ? CAN_OK : CAN_BUSY;
+}
+
+
+uint8_t CANRequestSend(CANRequestTracker_t *tracker, const CANPacket_t *request, uint32_t timeoutMicros,
+                       CANRequestCallback_t callback, void *context) {
+    if (!tracker || !request || !callback) {
+        return CAN_ERROR;
+    }
+
+    CANCommand_t responseCommand;
+    bool keyed = false;
+    uint16_t key = 0;
+    switch (request->command & 0x7F) {
+        case CAN_COMMAND_ID__BLDC_DIRECT_READ:
+            responseCommand = CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT;
+            keyed = true;
+            key = CANLoadUInt16(request->contents + CAN_SCHEMA_OFFSET(CANMotorPacket_BLDC_DirectRead, endpointID));
+            break;
+        case CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE_GET:
+            responseCommand = CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE;
+            break;
+        case CAN_COMMAND_ID__VERSION_GET:
+            responseCommand = CAN_COMMAND_ID__VERSION;
+            break;
+        default:
+            if (!(request->command & 0x80)) {
+                return CAN_ERROR;
+            }
+            responseCommand = CAN_COMMAND_ID__ACKNOWLEDGE;
+            keyed = true;
+            key = request->command & 0x7F;
+            break;
+    }
+    if (!request->device.deviceUUID) {
+        // Broadcasts have no single peer to answer them
+        return CAN_ERROR;
+    }
+
+    CANRequest_t *entry = addRequest(tracker, request->device.deviceUUID, responseCommand, keyed, key,
+                                     timeoutMicros, callback, context);
+    if (!entry) {
+        return CAN_BUSY;
+    }
+    uint8_t status = CANSend(tracker->handle, request);
+    if (status != CAN_OK) {
+        entry->active = false;
+        --tracker->pending;
+    }
+    return status;
+}
+
+
+bool CANRequestHandleResponse(CANRequestTracker_t *tracker, const CANPacket_t *packet) {
+    CANCommand_t command = packet->command & 0x7F;
+    uint16_t key = 0;
+    bool keyed = CANRequestResponseKey(packet, &key);
+    CANRequest_t *match = NULL;
+    for (CANRequest_t *request = tracker->requests; request < tracker->requests + CAN_REQUEST_MAX_PENDING; ++request) {
+        if (!request->active || request->responseCommand != command || request->peer != packet->senderUUID ||
+            (request->keyed && (!keyed || request->key != key))) {
+            continue;
+        }
+        // Sequence numbers only wrap after 2^32 requests, compare their distance to stay correct across it
+        if (!match || (int32_t)(request->sequence - match->sequence) < 0) {
+            match = request;
+        }
+    }
+    if (!match) {
+        if (command == CAN_COMMAND_ID__ACKNOWLEDGE || command == CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT ||
+            command == CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE || command == CAN_COMMAND_ID__VERSION) {
+            ++tracker->unmatched;
+        }
+        return false;
+    }
+
+    match->active = false;
+    --tracker->pending;
+    ++tracker->completed;
+    match->callback(CAN_OK, packet, match->context);
+    return true;
+}
+
+
+void CANRequestPoll(CANRequestTracker_t *tracker) {
+    if (!tracker->pending) {
+        return;
+    }
+
+    CANTimestamp_t now = CANGetTimestamp(tracker->handle);
+    for (CANRequest_t *request = tracker->requests; request < tracker->requests + CAN_REQUEST_MAX_PENDING; ++request) {
+        if (request->active && now >= request->deadline) {
+            request->active = false;
+            --tracker->pending;
+            ++tracker->timedOut;
+            request->callback(CAN_TIMEOUT, NULL, request->context);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the request tracker, which matches responses to outstanding requests
+ * Requests are sent without waiting, so any number can be in flight across devices at once:
+ *
+ *   CANRequestTracker_t requests;
+ *   CANRequestInit(&requests, handle);
+ *   for (int i = 0; i < 10; ++i) {
+ *       CANPacket_t get = CANMotorPacket_BLDC_GetEncoderEstimates(jetson, bldcs[i], 0);
+ *       CANRequestSend(&requests, &get, 5000, onEstimates, &bldcs[i]);
+ *   }
+ *   ...
+ *   while (CANPollAndReceive(handle, &packet) > 0) {
+ *       if (!CANRequestHandleResponse(&requests, &packet)) {
+ *           CANDispatch(&dispatcher, &packet);
+ *       }
+ *   }
+ *   CANRequestPoll(&requests);
+ *
+ * A pending request is keyed by the peer's UUID, the response command and, where the response carries one,
+ * a key identifying the request (the endpoint of a direct read, the command id of an acknowledgement).
+ * Responses without a key complete the oldest matching request from that peer.
+ */
+
+/**
+ * Maximum number of requests in flight per tracker
+ */
+#ifndef CAN_REQUEST_MAX_PENDING
+#define CAN_REQUEST_MAX_PENDING 32
+#endif
+
+/**
+ * Called once per request, with status CAN_OK and the response, or CAN_TIMEOUT and NULL
+ */
+typedef void (*CANRequestCallback_t)(uint8_t status, const CANPacket_t *response, void *context);
+
+typedef struct {
+    bool active;
+    bool keyed;
+    CANDeviceUUID_t peer;
+    CANCommand_t responseCommand;
+    uint16_t key;
+    uint32_t sequence;
+    CANTimestamp_t deadline;
+    CANRequestCallback_t callback;
+    void *context;
+} CANRequest_t;
+
+typedef struct {
+    CANHandle_t handle;
+    uint32_t timestampFrequency;
+    uint32_t sequence;
+    uint16_t pending;
+    uint32_t completed;
+    uint32_t timedOut;
+    uint32_t unmatched; // responses of the kinds listed at CANRequestSend that matched no pending request
+    CANRequest_t requests[CAN_REQUEST_MAX_PENDING];
+} CANRequestTracker_t;
+
+/**
+ * Clears the tracker, requests are sent through and timed with the clock of the given handle
+ * @param tracker Tracker to initialize
+ * @param CANHandle Handle previously passed to CANInit
+ */
+void CANRequestInit(CANRequestTracker_t *tracker, CANHandle_t CANHandle);
+
+/**
+ * Sends a request and tracks its response
+ * The expected response follows from the request:
+ *   BLDC_DirectRead           - BLDC_DirectReadResult with the same endpoint
+ *   BLDC_GetEncoderEstimates  - BLDC_EncoderEstimates
+ *   GetFirmwareVersion        - FirmwareVersion
+ *   any other command with the acknowledgement bit set - Acknowledge of that command
+ * @param tracker Tracker to use
+ * @param request Packet to send, addressed to a single device
+ * @param timeoutMicros Time to wait for the response
+ * @param callback Called when the response arrives or the request times out
+ * @param context Passed to the callback
+ * @return CAN_OK, CAN_BUSY if the tracker or the port is full, CAN_ERROR if the packet expects no response
+ */
+uint8_t CANRequestSend(CANRequestTracker_t *tracker, const CANPacket_t *request, uint32_t timeoutMicros,
+                       CANRequestCallback_t callback, void *context);
+
+/**
+ * Tracks a response to a request sent some other way, e.g. a command pair not listed at CANRequestSend
+ * @param tracker Tracker to use
+ * @param peer UUID of the device expected to respond
+ * @param responseCommand Command of the response (without the acknowledgement bit)
+ * @param keyed Whether the response carries a key, see CANRequestResponseKey
+ * @param key Key of the response if keyed
+ * @param timeoutMicros Time to wait for the response
+ * @param callback Called when the response arrives or the request times out
+ * @param context Passed to the callback
+ * @return CAN_OK, or CAN_BUSY if the tracker is full
+ */
+uint8_t CANRequestExpect(CANRequestTracker_t *tracker, CANDeviceUUID_t peer, CANCommand_t responseCommand,
+                         bool keyed, uint16_t key, uint32_t timeoutMicros,
+                         CANRequestCallback_t callback, void *context);
+
+/**
+ * Completes the pending request a received packet answers
+ * @return true if the packet was a tracked response (its callback has run)
+ */
+bool CANRequestHandleResponse(CANRequestTracker_t *tracker, const CANPacket_t *packet);
+
+/**
+ * Times out every pending request whose deadline has passed
+ * Should be called regularly, e.g. after each receive loop
+ */
+void CANRequestPoll(CANRequestTracker_t *tracker);
+
+/**
+ * Returns the key a response packet is matched on
+ * @return false if responses with this command carry no key
+ */
+bool CANRequestResponseKey(const CANPacket_t *response, uint16_t *key);
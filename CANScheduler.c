@@ -0,0 +1,228 @@
+// For timerfd in the Linux build
+#define _GNU_SOURCE
+
+#include "CANScheduler.h"
+
+#include <string.h>
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SOCKETCAN
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#elif defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+#include "stm32g4xx_hal.h"
+#endif
+
+// 2^32 / golden ratio, consecutive multiples of it are spread evenly over the 32 bit range
+#define GOLDEN_RATIO_32 0x9E3779B9u
+
+/**
+ * Converts microseconds to ticks of the handle's timestamp clock
+ */
+static CANTimestamp_t microsToTicks(const CANScheduler_t *scheduler, uint32_t micros) {
+    return (CANTimestamp_t)micros * scheduler->timestampFrequency / 1000000u;
+}
+
+static uint32_t ticksToMicros(const CANScheduler_t *scheduler, CANTimestamp_t ticks) {
+    if (scheduler->timestampFrequency == 0) {
+        return 0;
+    }
+    return (uint32_t)(ticks * 1000000u / scheduler->timestampFrequency);
+}
+
+void CANSchedulerInit(CANScheduler_t *scheduler, CANHandle_t CANHandle, CANDeviceUUID_t nodeUUID) {
+    memset(scheduler, 0, sizeof(CANScheduler_t));
+    scheduler->handle = CANHandle;
+    scheduler->nodeUUID = nodeUUID;
+    scheduler->timestampFrequency = CANGetTimestampFrequency(CANHandle);
+}
+
+
+uint32_t CANSchedulerAutoOffset(CANDeviceUUID_t nodeUUID, int8_t slot, uint32_t periodMicros) {
+    uint32_t index = (uint32_t)nodeUUID * CAN_SCHEDULER_MAX_ENTRIES + (uint32_t)slot;
+    uint32_t fraction = index * GOLDEN_RATIO_32;
+    return (uint32_t)(((uint64_t)fraction * periodMicros) >> 32);
+}
+
+
+int8_t CANSchedulerAdd(CANScheduler_t *scheduler, uint32_t periodMicros, uint32_t offsetMicros,
+                       CANSchedulerBuilder_t builder, void *context) {
+    if (!scheduler || !builder || periodMicros == 0 || scheduler->timestampFrequency == 0 ||
+        (offsetMicros != CAN_SCHEDULER_AUTO_OFFSET && offsetMicros >= periodMicros)) {
+        return -1;
+    }
+
+    for (int8_t slot = 0; slot < CAN_SCHEDULER_MAX_ENTRIES; ++slot) {
+        CANSchedulerEntry_t *entry = &scheduler->entries[slot];
+        if (entry->builder) {
+            continue;
+        }
+        if (offsetMicros == CAN_SCHEDULER_AUTO_OFFSET) {
+            offsetMicros = CANSchedulerAutoOffset(scheduler->nodeUUID, slot, periodMicros);
+        }
+        memset(entry, 0, sizeof(CANSchedulerEntry_t));
+        entry->context = context;
+        entry->period = microsToTicks(scheduler, periodMicros);
+        entry->nextRelease = CANGetTimestamp(scheduler->handle) + microsToTicks(scheduler, offsetMicros);
+        if (entry->period == 0) {
+            entry->period = 1;
+        }
+        // Set last, an interrupt running the scheduler may look at the slot at any time
+        entry->builder = builder;
+        return slot;
+    }
+    return -1;
+}
+
+
+void CANSchedulerRemove(CANScheduler_t *scheduler, int8_t slot) {
+    if (scheduler && slot >= 0 && slot < CAN_SCHEDULER_MAX_ENTRIES) {
+        scheduler->entries[slot].builder = NULL;
+    }
+}
+
+
+uint16_t CANSchedulerRun(CANScheduler_t *scheduler) {
+    uint16_t sent = 0;
+    CANTimestamp_t now = CANGetTimestamp(scheduler->handle);
+    for (CANSchedulerEntry_t *entry = scheduler->entries; entry < scheduler->entries + CAN_SCHEDULER_MAX_ENTRIES; ++entry) {
+        if (!entry->builder || now < entry->nextRelease) {
+            continue;
+        }
+
+        // Releases more than a period late are dropped rather than sent in a burst
+        CANTimestamp_t late = now - entry->nextRelease;
+        if (late >= entry->period) {
+            CANTimestamp_t skipped = late / entry->period;
+            entry->missed += (uint32_t)skipped;
+            entry->nextRelease += skipped * entry->period;
+            late -= skipped * entry->period;
+        }
+        entry->nextRelease += entry->period;
+
+        CANPacket_t packet = {0};
+        if (!entry->builder(&packet, entry->context)) {
+            continue;
+        }
+        if (CANSend(scheduler->handle, &packet) != CAN_OK) {
+            ++entry->dropped;
+            continue;
+        }
+        ++sent;
+        ++entry->releases;
+        entry->totalJitter += late;
+        if (late > entry->maxJitter) {
+            entry->maxJitter = late;
+        }
+    }
+    return sent;
+}
+
+
+CANTimestamp_t CANSchedulerNextRelease(const CANScheduler_t *scheduler) {
+    CANTimestamp_t next = UINT64_MAX;
+    for (const CANSchedulerEntry_t *entry = scheduler->entries; entry < scheduler->entries + CAN_SCHEDULER_MAX_ENTRIES; ++entry) {
+        if (entry->builder && entry->nextRelease < next) {
+            next = entry->nextRelease;
+        }
+    }
+    return next;
+}
+
+
+bool CANSchedulerGetStats(const CANScheduler_t *scheduler, int8_t slot, CANSchedulerStats_t *stats) {
+    if (!scheduler || !stats || slot < 0 || slot >= CAN_SCHEDULER_MAX_ENTRIES || !scheduler->entries[slot].builder) {
+        return false;
+    }
+
+    const CANSchedulerEntry_t *entry = &scheduler->entries[slot];
+    stats->releases = entry->releases;
+    stats->missed = entry->missed;
+    stats->dropped = entry->dropped;
+    stats->maxJitterMicros = ticksToMicros(scheduler, entry->maxJitter);
+    stats->meanJitterMicros = entry->releases ? ticksToMicros(scheduler, entry->totalJitter / entry->releases) : 0;
+    return true;
+}
+
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SOCKETCAN
+
+int CANSchedulerTimerfdOpen(uint32_t tickMicros) {
+    if (tickMicros == 0) {
+        return -1;
+    }
+
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerfd < 0) {
+        return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = tickMicros / 1000000u;
+    spec.it_interval.tv_nsec = (long)(tickMicros % 1000000u) * 1000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(timerfd, 0, &spec, NULL) < 0) {
+        close(timerfd);
+        return -1;
+    }
+    return timerfd;
+}
+
+
+int CANSchedulerTimerfdRun(CANScheduler_t *scheduler, int timerfd) {
+    uint64_t expirations;
+    ssize_t result;
+    do {
+        result = read(timerfd, &expirations, sizeof(expirations));
+    } while (result < 0 && errno == EINTR);
+    if (result != sizeof(expirations)) {
+        return -1;
+    }
+    return CANSchedulerRun(scheduler);
+}
+
+#elif defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+
+// Schedulers driven by hardware timers, a slot is in use while htim is set
+static struct {
+    TIM_HandleTypeDef *volatile htim;
+    CANScheduler_t *volatile scheduler;
+} timers[CAN_SCHEDULER_MAX_TIMERS];
+
+
+uint8_t CANSchedulerTimerStart(CANScheduler_t *scheduler, void *htim) {
+    if (!scheduler || !htim) {
+        return CAN_ERROR;
+    }
+
+    // Restarting a timer keeps its slot
+    int slot = -1;
+    for (int i = 0; i < CAN_SCHEDULER_MAX_TIMERS; ++i) {
+        if (timers[i].htim == htim) {
+            slot = i;
+            break;
+        }
+        if (!timers[i].htim && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return CAN_ERROR;
+    }
+    // The update interrupt may already be running, so the scheduler is published before the timer
+    timers[slot].scheduler = scheduler;
+    timers[slot].htim = (TIM_HandleTypeDef *)htim;
+    return HAL_TIM_Base_Start_IT((TIM_HandleTypeDef *)htim) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
+
+void CANSchedulerTimerElapsed(void *htim) {
+    for (int i = 0; i < CAN_SCHEDULER_MAX_TIMERS; ++i) {
+        if (timers[i].htim == htim) {
+            CANSchedulerRun(timers[i].scheduler);
+            return;
+        }
+    }
+}
+
+#endif
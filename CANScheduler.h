@@ -0,0 +1,178 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the cyclic transmit scheduler for periodic messages (heartbeats, telemetry, ...)
+ * Each message is registered once with a period, an offset and a builder, and CANSchedulerRun sends
+ * every message whose release time has come:
+ *
+ *   static bool buildHeartbeat(CANPacket_t *packet, void *context) {
+ *       *packet = CANUniversalPacket_HeartBeat(self, jetson, errors, state);
+ *       return true;
+ *   }
+ *
+ *   CANScheduler_t scheduler;
+ *   CANSchedulerInit(&scheduler, handle, self.deviceUUID);
+ *   CANSchedulerAdd(&scheduler, 100000, CAN_SCHEDULER_AUTO_OFFSET, buildHeartbeat, NULL);
+ *
+ * CANSchedulerRun is meant to be called from a periodic tick: a hardware timer interrupt on the STM32
+ * (every CANSend is then made from that interrupt, see CANSchedulerTimerStart), or a timerfd on Linux
+ * (see CANSchedulerTimerfdOpen). The STM32 port sends with interrupts disabled around its queue and
+ * the hardware, so the main loop may keep sending on the same handle.
+ *
+ * Releases are timed with the handle's timestamp clock, which never steps (on Linux it is CLOCK_MONOTONIC,
+ * the clock of the timerfd).
+ * The tick period bounds the release jitter, CANSchedulerGetStats reports the jitter actually seen.
+ *
+ * Messages with the same period on different nodes would otherwise all be released at the same instant
+ * after power up. CAN_SCHEDULER_AUTO_OFFSET derives the offset from the node's UUID and the message's slot
+ * so releases are spread evenly over the period across the bus, without any coordination between nodes.
+ */
+
+/**
+ * Maximum number of messages per scheduler
+ */
+#ifndef CAN_SCHEDULER_MAX_ENTRIES
+#define CAN_SCHEDULER_MAX_ENTRIES 16
+#endif
+
+/**
+ * Offset value requesting an offset derived from the node UUID and the entry's slot
+ */
+#define CAN_SCHEDULER_AUTO_OFFSET UINT32_MAX
+
+/**
+ * Fills the packet to send, returns false to skip this release
+ */
+typedef bool (*CANSchedulerBuilder_t)(CANPacket_t *packet, void *context);
+
+typedef struct {
+    CANSchedulerBuilder_t builder; // NULL if the slot is free
+    void *context;
+    CANTimestamp_t period;
+    CANTimestamp_t nextRelease;
+    // Jitter is the delay between the scheduled release and the actual send, in timestamp ticks
+    CANTimestamp_t maxJitter;
+    CANTimestamp_t totalJitter;
+    uint32_t releases;
+    uint32_t missed;  // releases skipped because the scheduler ran more than a period late
+    uint32_t dropped; // releases whose CANSend failed
+} CANSchedulerEntry_t;
+
+typedef struct {
+    CANHandle_t handle;
+    CANDeviceUUID_t nodeUUID;
+    uint32_t timestampFrequency;
+    CANSchedulerEntry_t entries[CAN_SCHEDULER_MAX_ENTRIES];
+} CANScheduler_t;
+
+/**
+ * Release statistics of one message, in microseconds
+ */
+typedef struct {
+    uint32_t releases;
+    uint32_t missed;
+    uint32_t dropped;
+    uint32_t maxJitterMicros;
+    uint32_t meanJitterMicros;
+} CANSchedulerStats_t;
+
+/**
+ * Clears the scheduler
+ * @param scheduler Scheduler to initialize
+ * @param CANHandle Handle previously passed to CANInit, messages are sent through it
+ * @param nodeUUID UUID of this node, used to spread automatic offsets
+ */
+void CANSchedulerInit(CANScheduler_t *scheduler, CANHandle_t CANHandle, CANDeviceUUID_t nodeUUID);
+
+/**
+ * Registers a periodic message, its first release is offset after the current time
+ * @param scheduler Scheduler to add to
+ * @param periodMicros Period of the message
+ * @param offsetMicros Delay of the first release (below periodMicros), or CAN_SCHEDULER_AUTO_OFFSET
+ * @param builder Called at each release to build the packet
+ * @param context Passed to the builder
+ * @return Slot of the message, or -1 if the scheduler is full, the arguments are invalid
+ *         or the handle's timestamp frequency is unknown
+ */
+int8_t CANSchedulerAdd(CANScheduler_t *scheduler, uint32_t periodMicros, uint32_t offsetMicros,
+                       CANSchedulerBuilder_t builder, void *context);
+
+/**
+ * Unregisters the message in a slot
+ */
+void CANSchedulerRemove(CANScheduler_t *scheduler, int8_t slot);
+
+/**
+ * Sends every message whose release time has passed
+ * @return Number of packets sent
+ */
+uint16_t CANSchedulerRun(CANScheduler_t *scheduler);
+
+/**
+ * Returns the earliest upcoming release, for programming a one-shot timer instead of a fixed tick
+ * @return Time of the release on the scheduler's clock, or UINT64_MAX if no message is registered
+ */
+CANTimestamp_t CANSchedulerNextRelease(const CANScheduler_t *scheduler);
+
+/**
+ * Returns the release statistics of a slot
+ * @return false if the slot is not in use
+ */
+bool CANSchedulerGetStats(const CANScheduler_t *scheduler, int8_t slot, CANSchedulerStats_t *stats);
+
+/**
+ * Returns the automatic offset of a message, spread by the golden ratio over nodes and slots
+ * @param nodeUUID UUID of the sending node
+ * @param slot Slot of the message on that node
+ * @param periodMicros Period of the message
+ */
+uint32_t CANSchedulerAutoOffset(CANDeviceUUID_t nodeUUID, int8_t slot, uint32_t periodMicros);
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SOCKETCAN
+
+/**
+ * Opens a timerfd firing every tickMicros, to drive the scheduler from a Linux event loop
+ * @return File descriptor (poll it for POLLIN), or -1 on error
+ */
+int CANSchedulerTimerfdOpen(uint32_t tickMicros);
+
+/**
+ * Consumes the expirations of the timerfd and runs the scheduler
+ * Blocks until the next tick if none has expired yet
+ * @return Number of packets sent, or -1 on error
+ */
+int CANSchedulerTimerfdRun(CANScheduler_t *scheduler, int timerfd);
+
+#elif defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+
+/**
+ * Maximum number of hardware timers driving schedulers at the same time
+ */
+#ifndef CAN_SCHEDULER_MAX_TIMERS
+#define CAN_SCHEDULER_MAX_TIMERS 2
+#endif
+
+/**
+ * Starts the update interrupt of a hardware timer that runs the scheduler on every period
+ * The timer must already be initialized with the tick period (e.g. by CubeMX) and its interrupt enabled in the NVIC.
+ * HAL_TIM_PeriodElapsedCallback is usually shared with other timers, so the application's callback has to
+ * call CANSchedulerTimerElapsed.
+ * @param scheduler Scheduler to run
+ * @param htim Pointer to the timer's TIM_HandleTypeDef
+ * @return 0 on success, error codes otherwise (including when CAN_SCHEDULER_MAX_TIMERS timers are in use)
+ */
+uint8_t CANSchedulerTimerStart(CANScheduler_t *scheduler, void *htim);
+
+/**
+ * Runs the scheduler started on the timer, to be called from HAL_TIM_PeriodElapsedCallback
+ * Does nothing for timers that were not passed to CANSchedulerTimerStart
+ */
+void CANSchedulerTimerElapsed(void *htim);
+
+#endif
@@ -0,0 +1,90 @@
+#include "CANStateCache.h"
+#include "Packets/Schema.h"
+
+#include <string.h>
+
+#define CAN_STATE_CACHE_SLOT_CASE(NAME, COMMAND) case COMMAND: return NAME##_CacheSlot;
+
+/**
+ * Returns the entry slot of a command, or -1 if it is not cached
+ */
+static int8_t cacheSlot(CANCommand_t command) {
+    switch (command & 0x7F) {
+        CAN_STATE_CACHE_PACKETS(CAN_STATE_CACHE_SLOT_CASE)
+        default: return -1;
+    }
+}
+
+
+void CANStateCacheInit(CANStateCache_t *cache) {
+    for (uint16_t device = 0; device < CAN_STATE_CACHE_DEVICES; ++device) {
+        for (uint8_t slot = 0; slot < CAN_STATE_CACHE_SLOTS; ++slot) {
+            CANStateCacheEntry_t *entry = &cache->entries[device][slot];
+            atomic_init(&entry->sequence, 0);
+            for (uint8_t word = 0; word < CAN_STATE_CACHE_WORDS; ++word) {
+                atomic_init(&entry->words[word], 0);
+            }
+        }
+    }
+}
+
+
+bool CANStateCacheUpdate(CANStateCache_t *cache, const CANPacket_t *packet, CANTimestamp_t timestamp) {
+    int8_t slot = cacheSlot(packet->command);
+    if (slot < 0 || packet->contentsLength < CANSchemaMinLength(packet->command)) {
+        return false;
+    }
+
+    uint32_t words[CAN_STATE_CACHE_WORDS] = {0};
+    memcpy(words, packet, sizeof(CANPacket_t));
+    memcpy((uint8_t *)words + sizeof(CANPacket_t), &timestamp, sizeof(CANTimestamp_t));
+
+    CANStateCacheEntry_t *entry = &cache->entries[packet->senderUUID & 0x7F][slot];
+    uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+    atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+    // Keeps the odd sequence ahead of the data, a reader seeing any new word also sees the write in progress
+    atomic_thread_fence(memory_order_release);
+    for (uint8_t word = 0; word < CAN_STATE_CACHE_WORDS; ++word) {
+        atomic_store_explicit(&entry->words[word], words[word], memory_order_relaxed);
+    }
+    // Skips 0 when the sequence wraps, it marks entries never written
+    atomic_store_explicit(&entry->sequence, sequence + 2 ? sequence + 2 : 2, memory_order_release);
+    return true;
+}
+
+
+bool CANStateCacheRead(const CANStateCache_t *cache, CANDeviceUUID_t deviceUUID, CANCommand_t command,
+                       CANPacket_t *packet, CANTimestamp_t *timestamp) {
+    int8_t slot = cacheSlot(command);
+    if (slot < 0) {
+        return false;
+    }
+
+    // The atomics are only read, the casts drop const for C11 implementations lacking const atomic loads
+    CANStateCacheEntry_t *entry = (CANStateCacheEntry_t *)&cache->entries[deviceUUID & 0x7F][slot];
+    uint32_t words[CAN_STATE_CACHE_WORDS];
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if (before == 0) {
+            return false;
+        }
+        if (before & 1) {
+            // The writer is in the middle of an update, which only takes a few stores
+            after = before + 1;
+            continue;
+        }
+        for (uint8_t word = 0; word < CAN_STATE_CACHE_WORDS; ++word) {
+            words[word] = atomic_load_explicit(&entry->words[word], memory_order_relaxed);
+        }
+        // Keeps the data loads ahead of the second sequence load
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+    } while (before != after);
+
+    memcpy(packet, words, sizeof(CANPacket_t));
+    if (timestamp) {
+        memcpy(timestamp, (const uint8_t *)words + sizeof(CANPacket_t), sizeof(CANTimestamp_t));
+    }
+    return true;
+}
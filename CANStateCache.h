@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Packets/DecodeUniversal.h"
+#include "Packets/DecodeMotor.h"
+#include "Packets/DecodePower.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+#define CAN_ATOMIC(T) std::atomic<T>
+#else
+#include <stdatomic.h>
+#define CAN_ATOMIC(T) _Atomic T
+#endif
+
+/**
+ * This header declares the device state cache, holding the latest status packet of each kind from every device
+ * One thread (the receive loop) writes it, any number of threads read it without ever blocking:
+ *
+ *   // receive thread
+ *   while (CANPollAndReceiveTimestamped(handle, &packet, &timestamp) > 0) {
+ *       if (!CANStateCacheUpdate(&cache, &packet, timestamp)) {
+ *           CANDispatch(&dispatcher, &packet);
+ *       }
+ *   }
+ *
+ *   // control thread
+ *   CANMotorPacket_BLDC_EncoderEstimates_Decoded_t estimates;
+ *   CANTimestamp_t updated;
+ *   if (CANMotorPacket_BLDC_EncoderEstimates_Cached(&cache, CAN_UUID_BLDC_BASE, &estimates, &updated)) { ... }
+ *
+ * Each entry is guarded by a sequence lock: the writer makes the sequence odd while it copies the packet in,
+ * a reader copies the packet out and retries if the sequence was odd or changed meanwhile.
+ * Readers never write shared memory, so they do not slow down each other or the writer.
+ * The writer must be a single thread, several writers need a lock between them.
+ */
+
+/**
+ * Packets kept in the cache, one entry per device for each, indexed by the sender's UUID
+ */
+#define CAN_STATE_CACHE_PACKETS(X)                                              \
+    X(CANMotorPacket_BLDC_EncoderEstimates, CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE) \
+    X(CANUniversalPacket_HeartBeat,         CAN_COMMAND_ID__HEARTBEAT)             \
+    X(CANPowerPacket_PowerStatus,           CAN_COMMAND_ID__POWER_STATUS)          \
+    X(CANMotorPacket_LimitSwitchAlert,      CAN_COMMAND_ID__LIMIT_SWITCH_ALERT)
+
+#define CAN_STATE_CACHE_SLOT(NAME, COMMAND) NAME##_CacheSlot,
+
+enum {
+    CAN_STATE_CACHE_PACKETS(CAN_STATE_CACHE_SLOT)
+    CAN_STATE_CACHE_SLOTS
+};
+
+/**
+ * Number of device UUIDs (7 bit)
+ */
+#define CAN_STATE_CACHE_DEVICES 128
+
+/**
+ * Words holding the packet and its timestamp inside an entry
+ */
+#define CAN_STATE_CACHE_WORDS ((sizeof(CANPacket_t) + sizeof(CANTimestamp_t) + 3) / 4)
+
+typedef struct {
+    CAN_ATOMIC(uint32_t) sequence; // 0 if never written, odd while being written
+    CAN_ATOMIC(uint32_t) words[CAN_STATE_CACHE_WORDS];
+} CANStateCacheEntry_t;
+
+typedef struct {
+    CANStateCacheEntry_t entries[CAN_STATE_CACHE_DEVICES][CAN_STATE_CACHE_SLOTS];
+} CANStateCache_t;
+
+/**
+ * Clears every entry, must not run concurrently with readers or the writer
+ */
+void CANStateCacheInit(CANStateCache_t *cache);
+
+/**
+ * Stores a received packet if it is one of CAN_STATE_CACHE_PACKETS
+ * Must only be called from the single writer thread
+ * @param cache Cache to update
+ * @param packet Received packet
+ * @param timestamp Receive timestamp of the packet (see CANPollAndReceiveTimestamped)
+ * @return true if the packet was stored
+ */
+bool CANStateCacheUpdate(CANStateCache_t *cache, const CANPacket_t *packet, CANTimestamp_t timestamp);
+
+/**
+ * Copies the latest packet of a kind from a device, safe from any thread
+ * @param cache Cache to read
+ * @param deviceUUID Device that sent the packet
+ * @param command Command of the packet, must be one of CAN_STATE_CACHE_PACKETS
+ * @param packet Receives the packet
+ * @param timestamp Receives the receive timestamp of the packet, may be NULL
+ * @return false if no such packet was received yet or the command is not cached
+ */
+bool CANStateCacheRead(const CANStateCache_t *cache, CANDeviceUUID_t deviceUUID, CANCommand_t command,
+                       CANPacket_t *packet, CANTimestamp_t *timestamp);
+
+/**
+ * Defines <packet>_Cached(cache, deviceUUID, decoded, timestamp), reading and decoding the latest packet of a device
+ */
+#define CAN_STATE_CACHE_DEFINE_READER(NAME, COMMAND)                                                          \
+    inline static bool NAME##_Cached(const CANStateCache_t *cache, CANDeviceUUID_t deviceUUID,                \
+                                     NAME##_Decoded_t *decoded, CANTimestamp_t *timestamp) {                  \
+        CANPacket_t packet;                                                                                   \
+        if (!CANStateCacheRead(cache, deviceUUID, COMMAND, &packet, timestamp)) {                             \
+            return false;                                                                                     \
+        }                                                                                                     \
+        *decoded = NAME##_Decode(&packet);                                                                    \
+        return true;                                                                                          \
+    }
+
+CAN_STATE_CACHE_PACKETS(CAN_STATE_CACHE_DEFINE_READER)
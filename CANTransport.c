@@ -0,0 +1,334 @@
+#include "CANTransport.h"
+
+#include <string.h>
+
+static CANTimestamp_t microsToTicks(const CANTransport_t *transport, uint32_t micros) {
+    return (CANTimestamp_t)micros * transport->timestampFrequency / 1000000u;
+}
+
+/**
+ * Sends flow control to the sender of a session, left pending if the port is full
+ * CANTransportPoll retries it until the deadline of the session, also once the session closed
+ */
+static void sendFlow(CANTransport_t *transport, CANTransportRxSession_t *session, uint8_t status) {
+    CANDevice_t peer = {.deviceUUID = session->peer};
+    CANPacket_t flow = CANUniversalPacket_TransportFlowControl(transport->self, peer, status,
+                                                               transport->blockSize, transport->separationMicros);
+    session->flowStatus = status;
+    session->flowPending = CANSend(transport->handle, &flow) != CAN_OK;
+}
+
+static void sendRefusal(CANTransport_t *transport) {
+    CANDevice_t peer = {.deviceUUID = transport->refusalPeer};
+    CANPacket_t flow = CANUniversalPacket_TransportFlowControl(transport->self, peer, CAN_TRANSPORT_FLOW_OVERFLOW, 0, 0);
+    transport->refusalPending = CANSend(transport->handle, &flow) != CAN_OK;
+}
+
+static void refuse(CANTransport_t *transport, CANDeviceUUID_t peer) {
+    transport->refusalPeer = peer;
+    transport->refusalDeadline = CANGetTimestamp(transport->handle) + transport->timeout;
+    sendRefusal(transport);
+    ++transport->refused;
+}
+
+static void deliver(CANTransport_t *transport, CANTransportRxSession_t *session) {
+    session->active = false;
+    ++transport->received;
+    if (transport->receiveCallback) {
+        transport->receiveCallback(session->peer, session->tag, session->data, session->length,
+                                   transport->receiveContext);
+    }
+}
+
+static void finishSend(CANTransport_t *transport, CANTransportTxSession_t *session, uint8_t status) {
+    session->active = false;
+    if (status == CAN_OK) {
+        ++transport->sent;
+    } else {
+        ++transport->aborted;
+    }
+    if (session->callback) {
+        session->callback(status, session->context);
+    }
+}
+
+/**
+ * Sends the consecutive frames of a session that are due, until a block ends or the port is full
+ */
+static void pump(CANTransport_t *transport, CANTransportTxSession_t *session, CANTimestamp_t now) {
+    while (session->active && !session->waiting && now >= session->nextFrame) {
+        uint16_t remaining = session->length - session->sent;
+        uint8_t chunk = remaining > CAN_TRANSPORT_CONSECUTIVE_DATA_LEN ? CAN_TRANSPORT_CONSECUTIVE_DATA_LEN : (uint8_t)remaining;
+        CANPacket_t frame = CANUniversalPacket_TransportConsecutive(transport->self, session->destination,
+                                                                    (uint8_t)(session->sequence + 1),
+                                                                    session->data + session->sent, chunk);
+        if (CANSend(transport->handle, &frame) != CAN_OK) {
+            return;
+        }
+        ++session->sequence;
+        session->sent += chunk;
+        session->nextFrame = now + session->separation;
+
+        // After the last frame the sender waits for the receiver to confirm the payload
+        if (session->sent == session->length || (session->blockSize && --session->blockRemaining == 0)) {
+            session->waiting = true;
+            session->deadline = now + transport->timeout;
+        }
+    }
+}
+
+
+void CANTransportInit(CANTransport_t *transport, CANHandle_t CANHandle, CANDevice_t self,
+                      uint8_t blockSize, uint16_t separationMicros, uint32_t timeoutMicros) {
+    memset(transport, 0, sizeof(CANTransport_t));
+    transport->handle = CANHandle;
+    transport->self = self;
+    transport->timestampFrequency = CANGetTimestampFrequency(CANHandle);
+    transport->blockSize = blockSize;
+    transport->separationMicros = separationMicros;
+    transport->timeout = microsToTicks(transport, timeoutMicros);
+}
+
+
+void CANTransportSetReceiveCallback(CANTransport_t *transport, CANTransportReceiveCallback_t callback, void *context) {
+    transport->receiveCallback = callback;
+    transport->receiveContext = context;
+}
+
+
+uint8_t CANTransportSend(CANTransport_t *transport, CANDevice_t destination, uint8_t tag,
+                         const uint8_t *data, uint16_t length, CANTransportSendCallback_t callback, void *context) {
+    if (!transport || (!data && length) || !destination.deviceUUID) {
+        return CAN_ERROR;
+    }
+
+    CANTransportTxSession_t *session = NULL;
+    for (CANTransportTxSession_t *candidate = transport->tx; candidate < transport->tx + CAN_TRANSPORT_TX_SESSIONS; ++candidate) {
+        if (candidate->active && candidate->destination.deviceUUID == destination.deviceUUID) {
+            // Flow control only names the receiver, so one transfer per destination at a time
+            return CAN_BUSY;
+        }
+        if (!candidate->active && !session) {
+            session = candidate;
+        }
+    }
+    if (!session) {
+        return CAN_BUSY;
+    }
+
+    CANPacket_t first = CANUniversalPacket_TransportFirst(transport->self, destination, length, tag, data);
+    uint8_t status = CANSend(transport->handle, &first);
+    if (status != CAN_OK) {
+        return status;
+    }
+
+    memset(session, 0, sizeof(CANTransportTxSession_t));
+    session->destination = destination;
+    session->data = data;
+    session->length = length;
+    session->sent = length > CAN_TRANSPORT_FIRST_DATA_LEN ? CAN_TRANSPORT_FIRST_DATA_LEN : length;
+    session->callback = callback;
+    session->context = context;
+    session->active = true;
+    if (session->sent == length) {
+        finishSend(transport, session, CAN_OK);
+    } else {
+        session->waiting = true;
+        session->deadline = CANGetTimestamp(transport->handle) + transport->timeout;
+    }
+    return CAN_OK;
+}
+
+
+static CANTransportRxSession_t *findRx(CANTransport_t *transport, CANDeviceUUID_t peer) {
+    for (CANTransportRxSession_t *session = transport->rx; session < transport->rx + CAN_TRANSPORT_RX_SESSIONS; ++session) {
+        if (session->active && session->peer == peer) {
+            return session;
+        }
+    }
+    return NULL;
+}
+
+static void handleFirst(CANTransport_t *transport, const CANPacket_t *packet) {
+    CANUniversalPacket_TransportFirst_Decoded_t first = CANUniversalPacket_TransportFirst_Decode(packet);
+    CANDeviceUUID_t peer = first.sender.deviceUUID;
+
+    // A new first frame from a sender restarts its transfer, flow control still pending for the old one
+    // would end the new one at the sender
+    CANTransportRxSession_t *session = findRx(transport, peer);
+    if (session) {
+        ++transport->aborted;
+    }
+    for (CANTransportRxSession_t *candidate = transport->rx; candidate < transport->rx + CAN_TRANSPORT_RX_SESSIONS; ++candidate) {
+        if (!candidate->active && candidate->flowPending && candidate->peer == peer) {
+            candidate->flowPending = false;
+        }
+        if (!session && !candidate->active && !candidate->flowPending) {
+            session = candidate;
+        }
+    }
+    if (transport->refusalPeer == peer) {
+        transport->refusalPending = false;
+    }
+    if (!session || first.length > CAN_TRANSPORT_MAX_PAYLOAD) {
+        if (session) {
+            session->active = false;
+            session->flowPending = false;
+        }
+        refuse(transport, peer);
+        return;
+    }
+
+    session->active = true;
+    session->flowPending = false;
+    session->peer = peer;
+    session->tag = first.tag;
+    session->length = first.length;
+    session->received = first.dataLength < first.length ? first.dataLength : first.length;
+    session->sequence = 0;
+    session->blockRemaining = transport->blockSize;
+    memcpy(session->data, first.data, session->received);
+    if (session->received == session->length) {
+        deliver(transport, session);
+        return;
+    }
+    session->deadline = CANGetTimestamp(transport->handle) + transport->timeout;
+    sendFlow(transport, session, CAN_TRANSPORT_FLOW_CONTINUE);
+}
+
+static void handleConsecutive(CANTransport_t *transport, const CANPacket_t *packet) {
+    CANUniversalPacket_TransportConsecutive_Decoded_t frame = CANUniversalPacket_TransportConsecutive_Decode(packet);
+    CANTransportRxSession_t *session = findRx(transport, frame.sender.deviceUUID);
+    if (!session) {
+        return;
+    }
+    if (frame.sequence != (uint8_t)(session->sequence + 1)) {
+        // A lost frame cannot be requested again, so the sender is told to give up
+        session->deadline = CANGetTimestamp(transport->handle) + transport->timeout;
+        sendFlow(transport, session, CAN_TRANSPORT_FLOW_ABORTED);
+        session->active = false;
+        ++transport->aborted;
+        return;
+    }
+
+    session->sequence = frame.sequence;
+    uint16_t remaining = session->length - session->received;
+    uint8_t chunk = frame.dataLength < remaining ? frame.dataLength : (uint8_t)remaining;
+    memcpy(session->data + session->received, frame.data, chunk);
+    session->received += chunk;
+    if (session->received == session->length) {
+        // If the confirmation cannot be sent before the deadline the sender times out,
+        // it never reports a payload that did not arrive
+        session->deadline = CANGetTimestamp(transport->handle) + transport->timeout;
+        sendFlow(transport, session, CAN_TRANSPORT_FLOW_DONE);
+        deliver(transport, session);
+        return;
+    }
+    session->deadline = CANGetTimestamp(transport->handle) + transport->timeout;
+    if (transport->blockSize && --session->blockRemaining == 0) {
+        session->blockRemaining = transport->blockSize;
+        sendFlow(transport, session, CAN_TRANSPORT_FLOW_CONTINUE);
+    }
+}
+
+static void handleFlowControl(CANTransport_t *transport, const CANPacket_t *packet) {
+    CANUniversalPacket_TransportFlowControl_Decoded_t flow = CANUniversalPacket_TransportFlowControl_Decode(packet);
+    CANTransportTxSession_t *session = NULL;
+    for (CANTransportTxSession_t *candidate = transport->tx; candidate < transport->tx + CAN_TRANSPORT_TX_SESSIONS; ++candidate) {
+        if (candidate->active && candidate->destination.deviceUUID == flow.sender.deviceUUID) {
+            session = candidate;
+            break;
+        }
+    }
+    if (!session) {
+        return;
+    }
+
+    CANTimestamp_t now = CANGetTimestamp(transport->handle);
+    switch (flow.status) {
+        case CAN_TRANSPORT_FLOW_CONTINUE:
+            if (!session->waiting || session->sent == session->length) {
+                break;
+            }
+            session->waiting = false;
+            session->blockSize = flow.blockSize;
+            session->blockRemaining = flow.blockSize;
+            session->separation = microsToTicks(transport, flow.separationMicros);
+            session->nextFrame = now;
+            pump(transport, session, now);
+            break;
+        case CAN_TRANSPORT_FLOW_WAIT:
+            if (session->waiting) {
+                session->deadline = now + transport->timeout;
+            }
+            break;
+        case CAN_TRANSPORT_FLOW_DONE:
+            finishSend(transport, session, session->sent == session->length ? CAN_OK : CAN_ERROR);
+            break;
+        default:
+            // Refused or aborted, which may also arrive while the sender streams without waiting
+            finishSend(transport, session, CAN_ERROR);
+            break;
+    }
+}
+
+
+bool CANTransportHandlePacket(CANTransport_t *transport, const CANPacket_t *packet) {
+    CANCommand_t command = packet->command & 0x7F;
+    if (command != CAN_COMMAND_ID__TRANSPORT_FIRST && command != CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE &&
+        command != CAN_COMMAND_ID__TRANSPORT_FLOW_CONTROL) {
+        return false;
+    }
+    if (packet->contentsLength < CANSchemaMinLength(command)) {
+        return true;
+    }
+
+    switch (command) {
+        case CAN_COMMAND_ID__TRANSPORT_FIRST:
+            handleFirst(transport, packet);
+            break;
+        case CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE:
+            handleConsecutive(transport, packet);
+            break;
+        default:
+            handleFlowControl(transport, packet);
+            break;
+    }
+    return true;
+}
+
+
+void CANTransportPoll(CANTransport_t *transport) {
+    CANTimestamp_t now = CANGetTimestamp(transport->handle);
+    for (CANTransportTxSession_t *session = transport->tx; session < transport->tx + CAN_TRANSPORT_TX_SESSIONS; ++session) {
+        if (!session->active) {
+            continue;
+        }
+        if (session->waiting && now >= session->deadline) {
+            finishSend(transport, session, CAN_TIMEOUT);
+        } else {
+            pump(transport, session, now);
+        }
+    }
+    for (CANTransportRxSession_t *session = transport->rx; session < transport->rx + CAN_TRANSPORT_RX_SESSIONS; ++session) {
+        if (!session->active && !session->flowPending) {
+            continue;
+        }
+        if (now >= session->deadline) {
+            if (session->active) {
+                ++transport->aborted;
+            }
+            session->active = false;
+            session->flowPending = false;
+        } else if (session->flowPending) {
+            sendFlow(transport, session, session->flowStatus);
+        }
+    }
+    if (transport->refusalPending) {
+        if (now >= transport->refusalDeadline) {
+            transport->refusalPending = false;
+        } else {
+            sendRefusal(transport);
+        }
+    }
+}
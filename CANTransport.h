@@ -0,0 +1,171 @@
+#pragma once
+
+#include "CANPacket.h"
+#include "CANCommandIDs.h"
+#include "Packets/DecodeUniversal.h"
+#include "Ports/Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * This header declares the segmented transport, which moves payloads larger than one frame (calibration tables,
+ * bulk parameters, long names) between two devices, in the manner of ISO-TP:
+ *
+ *   sender                               receiver
+ *   TransportFirst (length, tag, 3 bytes) ->
+ *                                        <- TransportFlowControl (continue, blockSize, separation)
+ *   TransportConsecutive (1, 5 bytes)     ->
+ *   ...                                     (blockSize frames)
+ *                                        <- TransportFlowControl (continue, ...)
+ *   TransportConsecutive ...              ->
+ *                                        <- TransportFlowControl (done)
+ *
+ * The receiver picks the block size and separation time. A block size of 0 and no separation let the sender
+ * stream the whole payload back to back, as fast as the port accepts frames.
+ * A lost consecutive frame cannot be sent again: the receiver drops the transfer and answers aborted instead
+ * of done, so the sender only reports success once the receiver confirmed the whole payload.
+ * Payloads of up to 3 bytes fit into the first frame and need neither flow control nor confirmation.
+ *
+ *   CANTransport_t transport;
+ *   CANTransportInit(&transport, handle, self, 0, 0, 100000);
+ *   CANTransportSetReceiveCallback(&transport, onPayload, NULL);
+ *   CANTransportSend(&transport, bldc, MY_TABLE_TAG, table, sizeof(table), onSent, NULL);
+ *   ...
+ *   while (CANPollAndReceive(handle, &packet) > 0) {
+ *       if (!CANTransportHandlePacket(&transport, &packet)) {
+ *           CANDispatch(&dispatcher, &packet);
+ *       }
+ *   }
+ *   CANTransportPoll(&transport);
+ *
+ * Transfers from different senders are reassembled concurrently, each into a buffer of a fixed pool.
+ */
+
+/**
+ * Largest payload that can be received, in bytes (the wire format allows up to 65535)
+ */
+#ifndef CAN_TRANSPORT_MAX_PAYLOAD
+#define CAN_TRANSPORT_MAX_PAYLOAD 512
+#endif
+
+/**
+ * Number of payloads that can be received at once, each from a different sender
+ */
+#ifndef CAN_TRANSPORT_RX_SESSIONS
+#define CAN_TRANSPORT_RX_SESSIONS 4
+#endif
+
+/**
+ * Number of payloads that can be sent at once, each to a different device
+ */
+#ifndef CAN_TRANSPORT_TX_SESSIONS
+#define CAN_TRANSPORT_TX_SESSIONS 2
+#endif
+
+/**
+ * Called with a complete payload, the data is only valid during the call
+ */
+typedef void (*CANTransportReceiveCallback_t)(CANDeviceUUID_t sender, uint8_t tag, const uint8_t *data,
+                                              uint16_t length, void *context);
+
+/**
+ * Called once a send finished: CAN_OK once the receiver confirmed the payload, CAN_TIMEOUT if the receiver
+ * stopped answering, or CAN_ERROR if it refused the payload or lost part of it
+ */
+typedef void (*CANTransportSendCallback_t)(uint8_t status, void *context);
+
+typedef struct {
+    bool active;
+    bool flowPending; // flowStatus still has to be sent, kept after the session closed until the deadline
+    uint8_t flowStatus;
+    CANDeviceUUID_t peer;
+    uint8_t tag;
+    uint8_t sequence; // of the last consecutive frame received
+    uint8_t blockRemaining;
+    uint16_t length;
+    uint16_t received;
+    CANTimestamp_t deadline;
+    uint8_t data[CAN_TRANSPORT_MAX_PAYLOAD];
+} CANTransportRxSession_t;
+
+typedef struct {
+    bool active;
+    bool waiting; // for flow control from the receiver, or its confirmation once everything was sent
+    CANDevice_t destination;
+    uint8_t sequence; // of the last consecutive frame sent
+    uint8_t blockSize;
+    uint8_t blockRemaining;
+    const uint8_t *data;
+    uint16_t length;
+    uint16_t sent;
+    CANTimestamp_t separation;
+    CANTimestamp_t nextFrame;
+    CANTimestamp_t deadline;
+    CANTransportSendCallback_t callback;
+    void *context;
+} CANTransportTxSession_t;
+
+typedef struct {
+    CANHandle_t handle;
+    CANDevice_t self;
+    uint32_t timestampFrequency;
+    uint8_t blockSize;
+    uint16_t separationMicros;
+    CANTimestamp_t timeout;
+    CANTransportReceiveCallback_t receiveCallback;
+    void *receiveContext;
+    uint32_t received;
+    uint32_t sent;
+    uint32_t aborted;  // transfers dropped after a sequence gap or timeout
+    uint32_t refused;  // first frames answered with CAN_TRANSPORT_FLOW_OVERFLOW
+    bool refusalPending; // the last refusal still has to be sent
+    CANDeviceUUID_t refusalPeer;
+    CANTimestamp_t refusalDeadline;
+    CANTransportRxSession_t rx[CAN_TRANSPORT_RX_SESSIONS];
+    CANTransportTxSession_t tx[CAN_TRANSPORT_TX_SESSIONS];
+} CANTransport_t;
+
+/**
+ * Clears the transport
+ * @param transport Transport to initialize
+ * @param CANHandle Handle previously passed to CANInit, frames are sent through and timed with it
+ * @param self This device, the sender of every frame
+ * @param blockSize Consecutive frames senders may send to this device between flow controls, 0 for no limit
+ * @param separationMicros Gap senders have to leave between consecutive frames to this device
+ * @param timeoutMicros Time a transfer may stall before it is dropped
+ */
+void CANTransportInit(CANTransport_t *transport, CANHandle_t CANHandle, CANDevice_t self,
+                      uint8_t blockSize, uint16_t separationMicros, uint32_t timeoutMicros);
+
+/**
+ * Sets the function called with every payload received, NULL discards them
+ */
+void CANTransportSetReceiveCallback(CANTransport_t *transport, CANTransportReceiveCallback_t callback, void *context);
+
+/**
+ * Starts sending a payload, the rest is sent by CANTransportHandlePacket and CANTransportPoll
+ * @param transport Transport to use
+ * @param destination Receiving device, must not be a broadcast
+ * @param tag What the payload is, passed to the receiver
+ * @param data Payload, must stay valid until the callback ran
+ * @param length Length of the payload
+ * @param callback Called when the transfer finished, may be NULL
+ * @param context Passed to the callback
+ * @return CAN_OK, CAN_BUSY if a transfer to the destination is in progress or all sessions are in use,
+ *         or the error of CANSend
+ */
+uint8_t CANTransportSend(CANTransport_t *transport, CANDevice_t destination, uint8_t tag,
+                         const uint8_t *data, uint16_t length, CANTransportSendCallback_t callback, void *context);
+
+/**
+ * Handles a received transport frame
+ * @return true if the packet was a transport frame
+ */
+bool CANTransportHandlePacket(CANTransport_t *transport, const CANPacket_t *packet);
+
+/**
+ * Sends the consecutive frames that are due, retries flow control the port had no room for and drops stalled transfers
+ * Should be called regularly, as often as possible while a transfer is running
+ */
+void CANTransportPoll(CANTransport_t *transport);
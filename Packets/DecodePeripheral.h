@@ -6,135 +6,21 @@
 
 #include "Peripheral.h"
 
-typedef struct {
-    CANDevice_t sender;
-    uint8_t peripheralID;
-    float dutyCycle;
-} CANPeripheralPacket_SetPWMDutyCycle_Decoded_t;
-
 /**
- * Decodes a PWM duty cycle packet into its sender, id, and dutycycle value
+ * Decoders generated from Schema.h, each name_Decoded_t holds the sender, receiver and the packet's fields:
+ *
+ * CANPeripheralPacket_SetPWMDutyCycle_Decode
+ * CANPeripheralPacket_SetLinearActuator_Decode
+ * CANPeripheralPacket_SetRoverLEDColor_Decode
+ * CANPeripheralPacket_SetBrakes_Decode
+ * CANPeripheralPacket_SetRoverLEDRed_Decode
+ * CANPeripheralPacket_SetRoverLEDBlue_Decode
+ * CANPeripheralPacket_SetRoverLEDGreenFlash_Decode
+ * CANPeripheralPacket_SetReset_Decode
+ * CANPeripheralPacket_SetServoAngle_Decode
  */
-inline static CANPeripheralPacket_SetPWMDutyCycle_Decoded_t
-CANPeripheralPacket_SetPWMDutyCycle_Decode(const CANPacket_t *packet) {
-    float dutyCycle = CANLoadFloat32(packet->contents + 1);
-    return (CANPeripheralPacket_SetPWMDutyCycle_Decoded_t){
-        .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .peripheralID = packet->contents[0],
-        .dutyCycle = dutyCycle
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-    uint8_t peripheralID;
-    int8_t drive;
-} CANPeripheralPacket_SetLinearActuator_Decoded_t;
-
-/*
-Decodes a linear actuator control packet into its sender, id, and drive value.
-*/
-inline static CANPeripheralPacket_SetLinearActuator_Decoded_t
-CANPeripheralPacket_SetLinearActuator_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetLinearActuator_Decoded_t){
-        .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .peripheralID = packet->contents[0],
-        .drive = (int8_t)packet->contents[1]
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-    uint8_t red;
-    uint8_t green;
-    uint8_t blue;
-} CANPeripheralPacket_SetRoverLEDColor_Decoded_t;
-
-/**
- * Decodes a rover led color packet into its sender and rgb values
- */
-inline static CANPeripheralPacket_SetRoverLEDColor_Decoded_t
-CANPeripheralPacket_SetRoverLEDColor_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetRoverLEDColor_Decoded_t){
-        .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .red = packet->contents[0],
-        .green = packet->contents[1],
-        .blue = packet->contents[2]
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-    uint8_t brake_id;
-    uint8_t state;
-} CANPeripheralPacket_SetBrakeControl_Decoded_t;
-
-inline static CANPeripheralPacket_SetBrakeControl_Decoded_t
-CANPeripheralPacket_SetBrakes_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetBrakeControl_Decoded_t) {
-        .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .brake_id = packet->contents[0],
-        .state = packet->contents[1]
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-} CANPeripheralPacket_SetRoverLEDRed_Decoded_t;
-
-inline static CANPeripheralPacket_SetRoverLEDRed_Decoded_t
-CANPeripheralPacket_SetRoverLEDRed_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetRoverLEDRed_Decoded_t) {
-        .sender = (CANDevice_t) {.deviceUUID = packet->senderUUID}
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-} CANPeripheralPacket_SetRoverLEDBlue_Decoded_t;
-
-inline static CANPeripheralPacket_SetRoverLEDBlue_Decoded_t
-CANPeripheralPacket_SetRoverLEDBlue_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetRoverLEDBlue_Decoded_t) {
-        .sender = (CANDevice_t) {.deviceUUID = packet->senderUUID}
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-} CANPeripheralPacket_SetRoverLEDGreenFlash_Decoded_t;
-
-inline static CANPeripheralPacket_SetRoverLEDGreenFlash_Decoded_t
-CANPeripheralPacket_SetRoverLEDGreenFlash_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetRoverLEDGreenFlash_Decoded_t) {
-        .sender = (CANDevice_t) {.deviceUUID = packet->senderUUID}
-    };
-}
-
-typedef struct {
-    CANDevice_t sender;
-    uint8_t servo_id;
-    uint8_t servo_angle;
-} CANPeripheralPacket_SetServoAngleDecoded_t;
-
-inline static CANPeripheralPacket_SetServoAngleDecoded_t
-CANPeripheralPacket_SetServoAngle_Decode(const CANPacket_t *packet) {
-    uint16_t servo_id = CANLoadUInt16(packet->contents+0);
-    CANPeripheralPacket_SetServoAngleDecoded_t result = {
-        .sender = (CANDevice_t) {.deviceUUID = packet->senderUUID},
-        .servo_id = servo_id,
-        .servo_angle = packet->contents[2]
-    };
-    return result;
-}
-
-typedef struct {
-    CANDevice_t sender;
-} CANPeripheralPacket_SetReset_Decoded_t;
+CAN_SCHEMA_PERIPHERAL(CAN_SCHEMA_DEFINE_DECODER)
 
-inline static CANPeripheralPacket_SetReset_Decoded_t
-CANPeripheralPacket_SetReset_Decode(const CANPacket_t *packet) {
-    return (CANPeripheralPacket_SetReset_Decoded_t) {
-        .sender = (CANDevice_t) {.deviceUUID = packet->senderUUID}
-    };
-}
\ No newline at end of file
+// Previous names of decoded types
+typedef CANPeripheralPacket_SetBrakes_Decoded_t CANPeripheralPacket_SetBrakeControl_Decoded_t;
+typedef CANPeripheralPacket_SetServoAngle_Decoded_t CANPeripheralPacket_SetServoAngleDecoded_t;
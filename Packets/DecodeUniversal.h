@@ -9,100 +9,111 @@
 
 #include "Universal.h"
 
-typedef struct {
-    CANDevice_t sender;
-    CANDevice_t receiver;
-} CANUniversalPacket_EStop_Decoded_t;
-
 /**
- * Decodes an EStop packet into its sender
+ * Decoders generated from Schema.h, each name_Decoded_t holds the sender, receiver and the packet's fields:
+ *
+ * CANUniversalPacket_EStop_Decode
+ * CANUniversalPacket_Acknowledge_Decode (the command id does not include the acknowledgement bit)
+ * CANUniversalPacket_HeartBeat_Decode
+ * CANUniversalPacket_GetFirmwareVersion_Decode
+ * CANUniversalPacket_TransportFlowControl_Decode
+ * CANUniversalPacket_FirmwareBegin_Decode
+ * CANUniversalPacket_FirmwareCommit_Decode
+ * CANUniversalPacket_FirmwareStatus_Decode
  */
-inline static CANUniversalPacket_EStop_Decoded_t
-CANUniversalPacket_EStop_Decode(const CANPacket_t *packet) {
-    return (CANUniversalPacket_EStop_Decoded_t){
-        .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .receiver = packet->device
-    };
-}
+CAN_SCHEMA_UNIVERSAL(CAN_SCHEMA_DEFINE_DECODER)
 
 typedef struct {
     CANDevice_t sender;
     CANDevice_t receiver;
-    uint32_t error;
-    uint8_t state;
-} CANUniversalPacket_HeartBeat_Decoded_t;
+    uint16_t versionID;
+    char name[CAN_FIRMWARE_VERSION_LEN];
+} CANUniversalPacket_FirmwareVersion_Decoded_t;
 
 /**
- * Decodes a heartbeat packet into its sender, error status, and state
+ * Decodes a firmware version packet into the version name and id
  */
-inline static CANUniversalPacket_HeartBeat_Decoded_t
-CANUniversalPacket_HeartBeat_Decode(const CANPacket_t *packet) {
-    CANUniversalPacket_HeartBeat_Decoded_t result = {
+inline static CANUniversalPacket_FirmwareVersion_Decoded_t
+CANUniversalPacket_FirmwareVersion_Decode(const CANPacket_t *packet) {
+    uint16_t versionID = CANLoadUInt16(packet->contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareVersion, versionID));
+    CANUniversalPacket_FirmwareVersion_Decoded_t result = {
         .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
         .receiver = packet->device,
-        .state = packet->contents[4]
+        .versionID = versionID
     };
-    result.error = CANLoadUInt32(packet->contents + 0);
+    for (int i = 0; i < CAN_FIRMWARE_VERSION_LEN; ++i) {
+        result.name[i] = packet->contents[i + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareVersion, name)];
+    }
     return result;
 }
 
 typedef struct {
     CANDevice_t sender;
     CANDevice_t receiver;
-    bool failure;
-    CANCommand_t commandID;
-} CANUniversalPacket_Acknowledge_Decoded_t;
+    uint16_t length;
+    uint8_t tag;
+    uint8_t dataLength;
+    uint8_t data[CAN_TRANSPORT_FIRST_DATA_LEN];
+} CANUniversalPacket_TransportFirst_Decoded_t;
 
 /**
- * Decodes a general acknowledge packet into its sender, whether the request failed, and the command id
- * The command id does not include the acknowledgement bit
+ * Decodes the first frame of a segmented transfer, dataLength is the number of payload bytes it carries
  */
-inline static CANUniversalPacket_Acknowledge_Decoded_t
-CANUniversalPacket_Acknowledge_Decode(const CANPacket_t *packet) {
-    return (CANUniversalPacket_Acknowledge_Decoded_t){
+inline static CANUniversalPacket_TransportFirst_Decoded_t
+CANUniversalPacket_TransportFirst_Decode(const CANPacket_t *packet) {
+    CANUniversalPacket_TransportFirst_Decoded_t result = {
         .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
         .receiver = packet->device,
-        .failure = (bool)packet->contents[0],
-        .commandID = packet->contents[1],
+        .length = CANLoadUInt16(packet->contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, length)),
+        .tag = packet->contents[CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, tag)]
     };
+    int dataLength = packet->contentsLength - CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, data);
+    result.dataLength = dataLength < 0 ? 0 : dataLength > CAN_TRANSPORT_FIRST_DATA_LEN ? CAN_TRANSPORT_FIRST_DATA_LEN : (uint8_t)dataLength;
+    memcpy(result.data, packet->contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, data), result.dataLength);
+    return result;
 }
 
 typedef struct {
     CANDevice_t sender;
     CANDevice_t receiver;
-} CANUniversalPacket_GetFirmwareVersion_Decoded_t;
+    uint8_t sequence;
+    uint8_t dataLength;
+    uint8_t data[CAN_TRANSPORT_CONSECUTIVE_DATA_LEN];
+} CANUniversalPacket_TransportConsecutive_Decoded_t;
 
 /**
- * Decodes a get firmware version packet into its sender
+ * Decodes a consecutive frame of a segmented transfer, dataLength is the number of payload bytes it carries
  */
-inline static CANUniversalPacket_GetFirmwareVersion_Decoded_t
-CANUniversalPacket_GetFirmwareVersion_Decode(const CANPacket_t *packet) {
-    return (CANUniversalPacket_GetFirmwareVersion_Decoded_t){
+inline static CANUniversalPacket_TransportConsecutive_Decoded_t
+CANUniversalPacket_TransportConsecutive_Decode(const CANPacket_t *packet) {
+    CANUniversalPacket_TransportConsecutive_Decoded_t result = {
         .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
-        .receiver = packet->device
+        .receiver = packet->device,
+        .sequence = packet->contents[CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportConsecutive, sequence)]
     };
+    int dataLength = packet->contentsLength - CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportConsecutive, data);
+    result.dataLength = dataLength < 0 ? 0 : dataLength > CAN_TRANSPORT_CONSECUTIVE_DATA_LEN ? CAN_TRANSPORT_CONSECUTIVE_DATA_LEN : (uint8_t)dataLength;
+    memcpy(result.data, packet->contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportConsecutive, data), result.dataLength);
+    return result;
 }
 
 typedef struct {
     CANDevice_t sender;
     CANDevice_t receiver;
-    uint16_t versionID;
-    char name[CAN_FIRMWARE_VERSION_LEN];
-} CANUniversalPacket_FirmwareVersion_Decoded_t;
+    uint8_t dataLength;
+    uint8_t data[CAN_FIRMWARE_DATA_LEN];
+} CANUniversalPacket_FirmwareData_Decoded_t;
 
 /**
- * Decodes a firmware version packet into the version name and id
+ * Decodes a firmware data frame, dataLength is the number of image bytes it carries
  */
-inline static CANUniversalPacket_FirmwareVersion_Decoded_t
-CANUniversalPacket_FirmwareVersion_Decode(const CANPacket_t *packet) {
-    uint16_t versionID = CANLoadUInt16(packet->contents + 0);
-    CANUniversalPacket_FirmwareVersion_Decoded_t result = {
+inline static CANUniversalPacket_FirmwareData_Decoded_t
+CANUniversalPacket_FirmwareData_Decode(const CANPacket_t *packet) {
+    CANUniversalPacket_FirmwareData_Decoded_t result = {
         .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},
         .receiver = packet->device,
-        .versionID = versionID
+        .dataLength = (uint8_t)(packet->contentsLength > CAN_FIRMWARE_DATA_LEN ? CAN_FIRMWARE_DATA_LEN : packet->contentsLength)
     };
-    for (int i = 0; i < CAN_FIRMWARE_VERSION_LEN; ++i) {
-        result.name[i] = packet->contents[i + 2];
-    }
+    memcpy(result.data, packet->contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareData, data), result.dataLength);
     return result;
 }
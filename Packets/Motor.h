@@ -6,43 +6,7 @@
 
 #include <stdbool.h>
 
-#include "../CANPacket.h"
-#include "../CANCommandIDs.h"
-
-// General
-
-/**
- * Constructs a packet to send an update from a limit switch to the given device
- * Limit switch alerts should be repeatedly sent at some interval of time
- */
-inline static CANPacket_t CANMotorPacket_LimitSwitchAlert(CANDevice_t sender, CANDevice_t device, uint8_t motorId, bool switchStatus) {
-    return (CANPacket_t){
-        .device = device,
-        .contentsLength = 2,
-        .command = CAN_COMMAND_ID__LIMIT_SWITCH_ALERT,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {motorId, switchStatus}
-    };
-}
-
-// DC Motors
-
-// Stepper Motors
-
-/**
- * Constructs a packet to tell a stepper motor to move a given number of revolutions from the current position
- * Positive number of revolutions should be clockwise, negative number should be counter-clockwise
- */
-inline static CANPacket_t CANMotorPacket_Stepper_DriveRevolutions(CANDevice_t sender, CANDevice_t device, float numRevolutions) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 4,
-        .command = CAN_COMMAND_ID__STEPPER_DRIVE_REVS,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-    };
-    CANStoreFloat32(result.contents + 0, numRevolutions);
-    return result;
-}
+#include "Schema.h"
 
 // BLDC Motors
 // All packets currently correspond to Odrive functions
@@ -62,21 +26,6 @@ inline static CANPacket_t CANMotorPacket_Stepper_DriveRevolutions(CANDevice_t se
 #define BLDC_MIRROR_INPUT       0x07
 #define BLDC_TUNING_INPUT       0x08
 
-/**
- * Constructs a packet to set the input mode of the motor
- * controlMode should be one of the BLDC_x_CONTROL macros
- * inputMode should be one of the BLDC_x_INPUT macros
- */
-inline static CANPacket_t CANMotorPacket_BLDC_SetInputMode(CANDevice_t sender, CANDevice_t device, uint8_t controlMode, uint8_t inputMode) {
-    return (CANPacket_t){
-        .device = device,
-        .contentsLength = 2,
-        .command = CAN_COMMAND_ID__BLDC_INPUT_MODE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {controlMode, inputMode}
-    };
-}
-
 /**
  * Constructs a packet that sets the destination position and feed forward velocity of the bldc motor
  * The motor should be placed into the BLDC_POSITION_CONTROL mode before this packet is sent
@@ -85,123 +34,25 @@ inline static CANPacket_t CANMotorPacket_BLDC_SetInputMode(CANDevice_t sender, C
  * Feed forward velocity is actually in multiples of 0.001 rev/s, values are clipped into range
  */
 inline static CANPacket_t CANMotorPacket_BLDC_SetInputPosition(CANDevice_t sender, CANDevice_t device, float position, float feedForwardVelocity) {
-    uint16_t feedForwardVelocityInt;
+    int16_t feedForwardVelocityRaw;
     // (the != acts as a NaN check here)
-    if (feedForwardVelocity != feedForwardVelocity || feedForwardVelocity < 0) {
-        feedForwardVelocityInt = 0;
-    } else if (feedForwardVelocity >= 65536.0 * 0.001) {
-        feedForwardVelocityInt = 65535;
+    if (feedForwardVelocity != feedForwardVelocity) {
+        feedForwardVelocityRaw = 0;
+    } else if (feedForwardVelocity <= -32768 * 0.001) {
+        feedForwardVelocityRaw = -32768;
+    } else if (feedForwardVelocity >= 32767 * 0.001) {
+        feedForwardVelocityRaw = 32767;
     } else {
-        feedForwardVelocityInt = (uint16_t)(feedForwardVelocity / 0.001);
+        feedForwardVelocityRaw = (int16_t)(feedForwardVelocity / 0.001);
     }
     CANPacket_t result = {
         .device = device,
-        .contentsLength = 6,
+        .contentsLength = CANMotorPacket_BLDC_SetInputPosition_LENGTH,
         .command = CAN_COMMAND_ID__BLDC_INPUT_POSITION,
         .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
-    CANStoreFloat32(result.contents + 0, position);
-    CANStoreInt16  (result.contents + 4, feedForwardVelocityInt);
-    return result;
-}
-
-/**
- * Constructs a packet that sets the destination velocity and feed forward torque of the bldc motor
- * The motor should be placed into the BLDC_VELOCITY_CONTROL mode before this packet is sent
- * velocity in units of rev/s, feedForwardTorque is in units of Nm
- */
-inline static CANPacket_t CANMotorPacket_BLDC_SetInputVelocity(CANDevice_t sender, CANDevice_t device, float velocity, float feedForwardTorque) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 6,
-        .command = CAN_COMMAND_ID__BLDC_INPUT_VELOCITY,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreFloat32(result.contents + 0, velocity);
-    CANStoreFloat16(result.contents + 4, feedForwardTorque);
-    return result;
-}
-
-/**
- * Constructs a packet to directly write to ODrive registers, setting the endpointID to the given value
- */
-inline static CANPacket_t CANMotorPacket_BLDC_DirectWrite(CANDevice_t sender, CANDevice_t device, uint16_t endpointID, uint32_t value) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 6,
-        .command = CAN_COMMAND_ID__BLDC_DIRECT_WRITE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreUInt16(result.contents + 0, endpointID);
-    CANStoreUInt32(result.contents + 2, value);
-    return result;
-}
-
-/**
- * Constructs a packet to request to directly read from ODrive registers (to read the endpointID register)
- *
- * Implies a reponse in the form of CANMotorPacket_BLDC_DirectReadResult
- */
-inline static CANPacket_t CANMotorPacket_BLDC_DirectRead(CANDevice_t sender, CANDevice_t device, uint16_t endpointID) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 2,
-        .command = CAN_ACK(CAN_COMMAND_ID__BLDC_DIRECT_READ),
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreUInt16(result.contents + 0, endpointID);
-    return result;
-}
-
-/**
- * Constructs a packet intended as a response to a CANMotorPacket_BLDC_DirectRead
- * Contains the value of the ODrive register that the read was requested from, as well as the endpoint it was requested from
- * The endpoint is sent to ensure ordering in case multiple requests were sent that got reordered for some reason
- */
-inline static CANPacket_t CANMotorPacket_BLDC_DirectReadResult(CANDevice_t sender, CANDevice_t device, uint16_t endpointID, uint32_t value) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 6,
-        .command = CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreUInt16(result.contents + 0, endpointID);
-    CANStoreUInt32(result.contents + 2, value);
-    return result;
-}
-
-/**
- * Constructs a packet to request encoder estimates from the device
- * encoderID is the encoder to read from
- *
- * Implies a response in the form of CANMotorPacket_BLDC_EncoderEstimates
- */
-inline static CANPacket_t CANMotorPacket_BLDC_GetEncoderEstimates(CANDevice_t sender, CANDevice_t device, uint8_t encoderID) {
-    return (CANPacket_t){
-        .device = device,
-        .contentsLength = 1,
-        .command = CAN_ACK(CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE_GET),
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {encoderID}
-    };
-}
-
-/**
- * Constructs a packet containing encoder estimates from a given encoder
- * Sent as a response to CANMotorPacket_BLDC_GetEncoderEstimates
- *
- * position should be in units of rev
- * velocity should be in units of rev/s
- */
-inline static CANPacket_t CANMotorPacket_BLDC_EncoderEstimates(CANDevice_t sender, CANDevice_t device, float position, float velocity) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 6,
-        .command = CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreBFloat24(result.contents + 0, position);
-    CANStoreBFloat24(result.contents + 3, velocity);
+    CANStoreFloat32(result.contents + CAN_SCHEMA_OFFSET(CANMotorPacket_BLDC_SetInputPosition, position), position);
+    CANStoreInt16  (result.contents + CAN_SCHEMA_OFFSET(CANMotorPacket_BLDC_SetInputPosition, feedForwardVelocityRaw), feedForwardVelocityRaw);
     return result;
 }
 
@@ -222,16 +73,29 @@ inline static CANPacket_t CANMotorPacket_BLDC_EncoderEstimates(CANDevice_t sende
 #define BLDC_AXIS_HARMONIC_CALIBRATION              15
 
 /**
- * Constructs a packet to set the axis state of an ODrive bldc
- * axisState should be one of the BLDC_AXIS_ macros
+ * Builders generated from Schema.h:
+ *
+ * CANMotorPacket_LimitSwitchAlert(sender, device, motorID, switchStatus)
+ *   update from a limit switch, should be repeatedly sent at some interval of time
+ * CANMotorPacket_Stepper_DriveRevolutions(sender, device, numRevolutions)
+ *   moves a stepper motor a number of revolutions from the current position (positive is clockwise)
+ * CANMotorPacket_BLDC_SetInputMode(sender, device, controlMode, inputMode)
+ *   controlMode should be one of the BLDC_x_CONTROL macros, inputMode one of the BLDC_x_INPUT macros
+ * CANMotorPacket_BLDC_SetInputVelocity(sender, device, velocity, feedForwardTorque)
+ *   the motor should be in BLDC_VELOCITY_CONTROL, velocity in rev/s, feedForwardTorque in Nm
+ * CANMotorPacket_BLDC_DirectWrite(sender, device, endpointID, value)
+ *   writes value to an ODrive register
+ * CANMotorPacket_BLDC_DirectRead(sender, device, endpointID)
+ *   requests the value of an ODrive register, answered by CANMotorPacket_BLDC_DirectReadResult
+ * CANMotorPacket_BLDC_DirectReadResult(sender, device, endpointID, value)
+ *   response to a direct read, the endpoint is included in case multiple requests got reordered
+ * CANMotorPacket_BLDC_GetEncoderEstimates(sender, device, encoderID)
+ *   requests encoder estimates, answered by CANMotorPacket_BLDC_EncoderEstimates
+ * CANMotorPacket_BLDC_EncoderEstimates(sender, device, position, velocity)
+ *   position in rev, velocity in rev/s
+ * CANMotorPacket_BLDC_SetAxisState(sender, device, axisState)
+ *   axisState should be one of the BLDC_AXIS_ macros
+ * CANMotorPacket_BLDC_ApplySetpoints(sender, device, groupID)
+ *   broadcast trigger making latching devices of a group apply their staged setpoint, see CANMotorGroup.h
  */
-inline static CANPacket_t CANMotorPacket_BLDC_SetAxisState(CANDevice_t sender, CANDevice_t device, uint32_t axisState) {
-    CANPacket_t result = {
-        .device = device,
-        .contentsLength = 4,
-        .command = CAN_COMMAND_ID__BLDC_AXIS_STATE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-    CANStoreUInt32(result.contents, axisState);
-    return result;
-}
+CAN_SCHEMA_MOTOR(CAN_SCHEMA_DEFINE_BUILDER)
@@ -4,8 +4,7 @@
  * This file conists of helper functions for packet types from the Peripheral Domain
  */
 
-#include "../CANPacket.h"
-#include "../CANCommandIDs.h"
+#include "Schema.h"
 
 /**
  * Constructs a packet to set the duty cycle of the device with the given pwm ID
@@ -14,101 +13,53 @@
 inline static CANPacket_t CANPeripheralPacket_SetPWMDutyCycle(CANDevice_t sender, CANDevice_t device, uint8_t peripheralID, float dutyCycle) {
     CANPacket_t result = {
         .device = device,
-        .contentsLength = 5,
+        .contentsLength = CANPeripheralPacket_SetPWMDutyCycle_LENGTH,
         .command = CAN_COMMAND_ID__PWM_DUTY_CYCLE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {peripheralID}
+        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
     if (dutyCycle < 0) {
         dutyCycle = 0;
     } else if (dutyCycle > 100) {
         dutyCycle = 100;
     }
-    CANStoreFloat32(result.contents + 1, dutyCycle);
+    result.contents[CAN_SCHEMA_OFFSET(CANPeripheralPacket_SetPWMDutyCycle, peripheralID)] = peripheralID;
+    CANStoreFloat32(result.contents + CAN_SCHEMA_OFFSET(CANPeripheralPacket_SetPWMDutyCycle, dutyCycle), dutyCycle);
     return result;
 }
-/**
- * 
- * Constructs a packet to run and set the direction of a linear actuator with given ID.
- * To stop, set drive = 0, otherwise, set drive to any positive value for forwards, negative for reverse.
- */
-inline static CANPacket_t CANPeripheralPacket_SetLinearActuator(CANDevice_t sender, CANDevice_t device, uint8_t peripheralID, int8_t drive) {
-    return (CANPacket_t){
-        .device = device,
-        .contentsLength = 2,
-        .command = CAN_COMMAND_ID__LINEAR_ACTUATOR_CONTROL,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {peripheralID, drive}
-    };
-}
 
 /**
- * Constructs a packet to set the color of the rover LED strips needed for competition
+ * Constructs a packet to set the angle of the servo with the given ID
  */
-inline static CANPacket_t CANPeripheralPacket_SetRoverLEDColor(CANDevice_t sender, CANDevice_t device, uint8_t red, uint8_t green, uint8_t blue) {
-    return (CANPacket_t){
-        .device = device,
-        .contentsLength = 3,
-        .command = CAN_COMMAND_ID__ROVER_LED_COLOR,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {red, green, blue}
-    };
-}
-
-inline static CANPacket_t CANPeripheralPacket_SetBrakes(CANDevice_t sender, CANDevice_t device, uint8_t brake_id, uint8_t state) {
-    return (CANPacket_t) {
-        .device = device,
-        .contentsLength = 2,
-        .command = CAN_COMMAND_ID__SET_BRAKE_CONTROL,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {brake_id, state}
-    };
-}
-
-inline static CANPacket_t CANPeripheralPacket_SetRoverLEDRed(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t) {
-        .device = device,
-        .contentsLength = 0,
-        .command = CAN_COMMAND_ID__SET_LED_RED,
-        .senderUUID = ((CANDeviceUUID_t) sender.deviceUUID),
-    };
-}
-
-inline static CANPacket_t CANPeripheralPacket_SetRoverLEDBlue(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t) {
-        .device = device,
-        .contentsLength = 0,
-        .command = CAN_COMMAND_ID__SET_LED_BLUE,
-        .senderUUID = ((CANDeviceUUID_t) sender.deviceUUID),
-    };
-}
-
-inline static CANPacket_t CANPeripheralPacket_SetRoverFlashLEDGreen(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t) {
-        .device = device,
-        .contentsLength = 0,
-        .command = CAN_COMMAND_ID__SET_LED_GREEN_FLASH,
-        .senderUUID = ((CANDeviceUUID_t) sender.deviceUUID),
-    };
-}
-
-inline static CANPacket_t CANPeripheralPacket_SetReset(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t) {
-        .device = device,
-        .contentsLength = 0,
-        .command = CAN_COMMAND_ID__RESET,
-        .senderUUID = ((CANDeviceUUID_t) sender.deviceUUID),
-    };
-}
-
 inline static CANPacket_t CANPeripheralPacket_SetServoAngle(CANDevice_t sender, CANDevice_t device, uint8_t servo_id, uint16_t servo_angle) {
     CANPacket_t result = {
         .device = device,
-        .contentsLength = 3,
+        .contentsLength = CANPeripheralPacket_SetServoAngle_LENGTH,
         .command = CAN_COMMAND_ID__SERVO_ANGLE,
         .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
-    CANStoreUInt16(result.contents + 0, servo_angle);
-    result.contents[2] = servo_id;
+    CANStoreUInt16(result.contents + CAN_SCHEMA_OFFSET(CANPeripheralPacket_SetServoAngle, servo_angle), servo_angle);
+    result.contents[CAN_SCHEMA_OFFSET(CANPeripheralPacket_SetServoAngle, servo_id)] = servo_id;
     return result;
 }
+
+/**
+ * Builders generated from Schema.h:
+ *
+ * CANPeripheralPacket_SetLinearActuator(sender, device, peripheralID, drive)
+ *   runs a linear actuator, drive is 0 to stop, positive for forwards and negative for reverse
+ * CANPeripheralPacket_SetRoverLEDColor(sender, device, red, green, blue)
+ *   sets the color of the rover LED strips needed for competition
+ * CANPeripheralPacket_SetBrakes(sender, device, brake_id, state)
+ * CANPeripheralPacket_SetRoverLEDRed(sender, device)
+ * CANPeripheralPacket_SetRoverLEDBlue(sender, device)
+ * CANPeripheralPacket_SetRoverLEDGreenFlash(sender, device)
+ * CANPeripheralPacket_SetReset(sender, device)
+ */
+CAN_SCHEMA_PERIPHERAL(CAN_SCHEMA_DEFINE_BUILDER)
+
+/**
+ * Previous name of CANPeripheralPacket_SetRoverLEDGreenFlash
+ */
+inline static CANPacket_t CANPeripheralPacket_SetRoverFlashLEDGreen(CANDevice_t sender, CANDevice_t device) {
+    return CANPeripheralPacket_SetRoverLEDGreenFlash(sender, device);
+}
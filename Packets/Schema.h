@@ -0,0 +1,447 @@
+#pragma once
+
+/**
+ * This file is the single description of every packet's layout
+ * The builders (Universal.h, Motor.h, ...), the decoders (DecodeUniversal.h, ...), the length tables
+ * below and the dispatcher (CANDispatch.h) are all generated from it, so encode and decode always agree
+ *
+ * Each domain has a list of packets, one X(name, command id, kind, flags, tail) entry per packet:
+ *   name    - name of the builder, the decoder is name_Decode and its result name_Decoded_t
+ *   kind    - which functions are generated, see the CAN_SCHEMA_KIND_ comments
+ *   flags   - CAN_SCHEMA_ACK and/or CAN_SCHEMA_HIGH_PRIORITY, or 0
+ *   tail    - number of trailing bytes that may be left off (variable length packets), usually 0
+ * and the contents of each packet are listed by name_FIELDS as F(P, format, field) entries in wire order
+ * Field offsets and the contents length follow from the list, see CAN_SCHEMA_OFFSET and name_LENGTH
+ *
+ * To add a packet: add its command id to CANCommandIDs.h, an entry and field list here,
+ * and write the functions its kind does not generate
+ */
+
+#include "../CANPacket.h"
+#include "../CANCommandIDs.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Field formats, see the overview in CANPacket.h
+// Each format has a wire size, the C type it decodes to and a store and load operation
+
+#define CAN_SCHEMA_SIZE_UInt8                   1
+#define CAN_SCHEMA_TYPE_UInt8                   uint8_t
+#define CAN_SCHEMA_STORE_UInt8(ptr, value)      (*(ptr) = (uint8_t)(value))
+#define CAN_SCHEMA_LOAD_UInt8(ptr)              (*(ptr))
+
+#define CAN_SCHEMA_SIZE_Int8                    1
+#define CAN_SCHEMA_TYPE_Int8                    int8_t
+#define CAN_SCHEMA_STORE_Int8(ptr, value)       (*(ptr) = (uint8_t)(value))
+#define CAN_SCHEMA_LOAD_Int8(ptr)               ((int8_t)*(ptr))
+
+#define CAN_SCHEMA_SIZE_Bool                    1
+#define CAN_SCHEMA_TYPE_Bool                    bool
+#define CAN_SCHEMA_STORE_Bool(ptr, value)       (*(ptr) = (uint8_t)(value))
+#define CAN_SCHEMA_LOAD_Bool(ptr)               ((bool)*(ptr))
+
+#define CAN_SCHEMA_SIZE_UInt16                  2
+#define CAN_SCHEMA_TYPE_UInt16                  uint16_t
+#define CAN_SCHEMA_STORE_UInt16(ptr, value)     CANStoreUInt16(ptr, value)
+#define CAN_SCHEMA_LOAD_UInt16(ptr)             CANLoadUInt16(ptr)
+
+#define CAN_SCHEMA_SIZE_Int16                   2
+#define CAN_SCHEMA_TYPE_Int16                   int16_t
+#define CAN_SCHEMA_STORE_Int16(ptr, value)      CANStoreInt16(ptr, value)
+#define CAN_SCHEMA_LOAD_Int16(ptr)              CANLoadInt16(ptr)
+
+#define CAN_SCHEMA_SIZE_UInt32                  4
+#define CAN_SCHEMA_TYPE_UInt32                  uint32_t
+#define CAN_SCHEMA_STORE_UInt32(ptr, value)     CANStoreUInt32(ptr, value)
+#define CAN_SCHEMA_LOAD_UInt32(ptr)             CANLoadUInt32(ptr)
+
+#define CAN_SCHEMA_SIZE_Int32                   4
+#define CAN_SCHEMA_TYPE_Int32                   int32_t
+#define CAN_SCHEMA_STORE_Int32(ptr, value)      CANStoreInt32(ptr, value)
+#define CAN_SCHEMA_LOAD_Int32(ptr)              CANLoadInt32(ptr)
+
+#define CAN_SCHEMA_SIZE_Float32                 4
+#define CAN_SCHEMA_TYPE_Float32                 float
+#define CAN_SCHEMA_STORE_Float32(ptr, value)    CANStoreFloat32(ptr, value)
+#define CAN_SCHEMA_LOAD_Float32(ptr)            CANLoadFloat32(ptr)
+
+#define CAN_SCHEMA_SIZE_Float16                 2
+#define CAN_SCHEMA_TYPE_Float16                 float
+#define CAN_SCHEMA_STORE_Float16(ptr, value)    CANStoreFloat16(ptr, value)
+#define CAN_SCHEMA_LOAD_Float16(ptr)            CANLoadFloat16(ptr)
+
+#define CAN_SCHEMA_SIZE_BFloat24                3
+#define CAN_SCHEMA_TYPE_BFloat24                float
+#define CAN_SCHEMA_STORE_BFloat24(ptr, value)   CANStoreBFloat24(ptr, value)
+#define CAN_SCHEMA_LOAD_BFloat24(ptr)           CANLoadBFloat24(ptr)
+
+#define CAN_SCHEMA_SIZE_BFloat16                2
+#define CAN_SCHEMA_TYPE_BFloat16                float
+#define CAN_SCHEMA_STORE_BFloat16(ptr, value)   CANStoreBFloat16(ptr, value)
+#define CAN_SCHEMA_LOAD_BFloat16(ptr)           CANLoadBFloat16(ptr)
+
+#define CAN_SCHEMA_SIZE_UNorm16                 2
+#define CAN_SCHEMA_TYPE_UNorm16                 float
+#define CAN_SCHEMA_STORE_UNorm16(ptr, value)    CANStoreUNorm16(ptr, value)
+#define CAN_SCHEMA_LOAD_UNorm16(ptr)            CANLoadUNorm16(ptr)
+
+#define CAN_SCHEMA_SIZE_UNorm8                  1
+#define CAN_SCHEMA_TYPE_UNorm8                  float
+#define CAN_SCHEMA_STORE_UNorm8(ptr, value)     CANStoreUNorm8(ptr, value)
+#define CAN_SCHEMA_LOAD_UNorm8(ptr)             CANLoadUNorm8(ptr)
+
+// Up to 4 characters, layout only (packets using it are written by hand)
+#define CAN_SCHEMA_SIZE_Chars4                  4
+
+// Raw bytes, layout only (packets using them are written by hand)
+#define CAN_SCHEMA_SIZE_Bytes3                  3
+#define CAN_SCHEMA_SIZE_Bytes5                  5
+#define CAN_SCHEMA_SIZE_Bytes6                  6
+
+// Packet flags
+
+/**
+ * The builder sets the acknowledgement bit, the packet is a request expecting a response
+ */
+#define CAN_SCHEMA_ACK           0x01
+
+/**
+ * The builder sends the packet at CAN_PRIORITY_HIGH
+ */
+#define CAN_SCHEMA_HIGH_PRIORITY 0x02
+
+// Packet kinds
+// AUTO          - builder and decoder are generated
+// CUSTOM_BUILD  - decoder is generated, the builder is written by hand (e.g. to clamp arguments)
+// CUSTOM_DECODE - builder is generated, the decoder is written by hand
+// CUSTOM        - both are written by hand
+// Handwritten functions use name_LENGTH and CAN_SCHEMA_OFFSET so the layout still comes from here
+
+// Universal packets, supported by all devices on the CAN network
+
+#define CANUniversalPacket_EStop_FIELDS(F, P)
+
+#define CANUniversalPacket_Acknowledge_FIELDS(F, P) \
+    F(P, Bool,     failure)                          \
+    F(P, UInt8,    commandID) // without the acknowledgement bit
+
+// error is the current error state of the device (e.g. bad config, over temp, etc.)
+// state is the current state of the device (e.g. idle, startup, etc.)
+#define CANUniversalPacket_HeartBeat_FIELDS(F, P) \
+    F(P, UInt32,   error)                          \
+    F(P, UInt8,    state)
+
+#define CANUniversalPacket_GetFirmwareVersion_FIELDS(F, P)
+
+// name is up to 4 characters, shorter names shorten the packet
+#define CANUniversalPacket_FirmwareVersion_FIELDS(F, P) \
+    F(P, UInt16,   versionID)                            \
+    F(P, Chars4,   name)
+
+// Segmented transport (see CANTransport.h)
+// length is the size of the whole payload and tag what it is (defined by the application)
+// data holds the first bytes of the payload, payloads shorter than 3 bytes shorten the packet
+#define CANUniversalPacket_TransportFirst_FIELDS(F, P) \
+    F(P, UInt16,   length)                              \
+    F(P, UInt8,    tag)                                 \
+    F(P, Bytes3,   data)
+
+// sequence counts the consecutive frames of a transfer from 1 (wrapping), the last frame may be shorter
+#define CANUniversalPacket_TransportConsecutive_FIELDS(F, P) \
+    F(P, UInt8,    sequence)                                  \
+    F(P, Bytes5,   data)
+
+// status is one of the CAN_TRANSPORT_FLOW_ macros, blockSize the number of consecutive frames to send before
+// waiting for the next flow control (0 for all), separationMicros the minimum gap between consecutive frames
+#define CANUniversalPacket_TransportFlowControl_FIELDS(F, P) \
+    F(P, UInt8,    status)                                    \
+    F(P, UInt8,    blockSize)                                 \
+    F(P, UInt16,   separationMicros)
+
+// Firmware update (see CANFirmware.h)
+// imageSize in bytes, imageTag identifies the image so an interrupted update of the same image can resume
+#define CANUniversalPacket_FirmwareBegin_FIELDS(F, P) \
+    F(P, UInt32,   imageSize)                          \
+    F(P, UInt16,   imageTag)
+
+// The next bytes of the image, the last frame of a block may be shorter
+#define CANUniversalPacket_FirmwareData_FIELDS(F, P) \
+    F(P, Bytes6,   data)
+
+// Ends a block, crc is the running CRC-32 of the image from its start to the end of the block
+#define CANUniversalPacket_FirmwareCommit_FIELDS(F, P) \
+    F(P, UInt16,   block)                               \
+    F(P, UInt32,   crc)
+
+// status is one of the CAN_FIRMWARE_STATUS_ macros, window the number of blocks the receiver buffers
+// offset is where the sender continues (on begin) or how much of the image is flashed (after a block)
+#define CANUniversalPacket_FirmwareStatus_FIELDS(F, P) \
+    F(P, UInt8,    status)                              \
+    F(P, UInt8,    window)                              \
+    F(P, UInt32,   offset)
+
+#define CAN_SCHEMA_UNIVERSAL(X)                                                                                                  \
+    X(CANUniversalPacket_EStop,                 CAN_COMMAND_ID__E_STOP,                 AUTO,   CAN_SCHEMA_HIGH_PRIORITY, 0) \
+    X(CANUniversalPacket_Acknowledge,           CAN_COMMAND_ID__ACKNOWLEDGE,            AUTO,   0,                        0) \
+    X(CANUniversalPacket_HeartBeat,             CAN_COMMAND_ID__HEARTBEAT,              AUTO,   0,                        0) \
+    X(CANUniversalPacket_GetFirmwareVersion,    CAN_COMMAND_ID__VERSION_GET,            AUTO,   CAN_SCHEMA_ACK,           0) \
+    X(CANUniversalPacket_FirmwareVersion,       CAN_COMMAND_ID__VERSION,                CUSTOM, 0,                        4) \
+    X(CANUniversalPacket_TransportFirst,        CAN_COMMAND_ID__TRANSPORT_FIRST,        CUSTOM, 0,                        3) \
+    X(CANUniversalPacket_TransportConsecutive,  CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE,  CUSTOM, 0,                        4) \
+    X(CANUniversalPacket_TransportFlowControl,  CAN_COMMAND_ID__TRANSPORT_FLOW_CONTROL, AUTO,   0,                        0) \
+    X(CANUniversalPacket_FirmwareBegin,         CAN_COMMAND_ID__FIRMWARE_BEGIN,         AUTO,   0,                        0) \
+    X(CANUniversalPacket_FirmwareData,          CAN_COMMAND_ID__FIRMWARE_DATA,          CUSTOM, 0,                        5) \
+    X(CANUniversalPacket_FirmwareCommit,        CAN_COMMAND_ID__FIRMWARE_COMMIT,        AUTO,   0,                        0) \
+    X(CANUniversalPacket_FirmwareStatus,        CAN_COMMAND_ID__FIRMWARE_STATUS,        AUTO,   0,                        0)
+
+// Motor packets
+
+#define CANMotorPacket_LimitSwitchAlert_FIELDS(F, P) \
+    F(P, UInt8,    motorID)                           \
+    F(P, Bool,     switchStatus)
+
+// Positive revolutions are clockwise
+#define CANMotorPacket_Stepper_DriveRevolutions_FIELDS(F, P) \
+    F(P, Float32,  numRevolutions)
+
+// controlMode is one of the BLDC_x_CONTROL macros, inputMode one of the BLDC_x_INPUT macros
+#define CANMotorPacket_BLDC_SetInputMode_FIELDS(F, P) \
+    F(P, UInt8,    controlMode)                        \
+    F(P, UInt8,    inputMode)
+
+// position in rev, feed forward velocity in multiples of 0.001 rev/s
+#define CANMotorPacket_BLDC_SetInputPosition_FIELDS(F, P) \
+    F(P, Float32,  position)                               \
+    F(P, Int16,    feedForwardVelocityRaw)
+
+// velocity in rev/s, feedForwardTorque in Nm
+#define CANMotorPacket_BLDC_SetInputVelocity_FIELDS(F, P) \
+    F(P, Float32,  velocity)                               \
+    F(P, Float16,  feedForwardTorque)
+
+#define CANMotorPacket_BLDC_DirectWrite_FIELDS(F, P) \
+    F(P, UInt16,   endpointID)                        \
+    F(P, UInt32,   value)
+
+#define CANMotorPacket_BLDC_DirectRead_FIELDS(F, P) \
+    F(P, UInt16,   endpointID)
+
+// The endpoint is repeated in case multiple requests got reordered
+#define CANMotorPacket_BLDC_DirectReadResult_FIELDS(F, P) \
+    F(P, UInt16,   endpointID)                              \
+    F(P, UInt32,   value)
+
+#define CANMotorPacket_BLDC_GetEncoderEstimates_FIELDS(F, P) \
+    F(P, UInt8,    encoderID)
+
+// position in rev, velocity in rev/s
+#define CANMotorPacket_BLDC_EncoderEstimates_FIELDS(F, P) \
+    F(P, BFloat24, position)                               \
+    F(P, BFloat24, velocity)
+
+// axisState is one of the BLDC_AXIS_ macros
+#define CANMotorPacket_BLDC_SetAxisState_FIELDS(F, P) \
+    F(P, UInt32,   axisState)
+
+// groupID selects the latching devices that apply their staged setpoint, 0 selects all of them
+#define CANMotorPacket_BLDC_ApplySetpoints_FIELDS(F, P) \
+    F(P, UInt8,    groupID)
+
+#define CAN_SCHEMA_MOTOR(X)                                                                                                   \
+    X(CANMotorPacket_LimitSwitchAlert,         CAN_COMMAND_ID__LIMIT_SWITCH_ALERT,        AUTO,          0,              0) \
+    X(CANMotorPacket_Stepper_DriveRevolutions, CAN_COMMAND_ID__STEPPER_DRIVE_REVS,        AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_SetInputMode,        CAN_COMMAND_ID__BLDC_INPUT_MODE,           AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_SetInputPosition,    CAN_COMMAND_ID__BLDC_INPUT_POSITION,       CUSTOM,        0,              0) \
+    X(CANMotorPacket_BLDC_SetInputVelocity,    CAN_COMMAND_ID__BLDC_INPUT_VELOCITY,       AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_DirectWrite,         CAN_COMMAND_ID__BLDC_DIRECT_WRITE,         AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_DirectRead,          CAN_COMMAND_ID__BLDC_DIRECT_READ,          AUTO,          CAN_SCHEMA_ACK, 0) \
+    X(CANMotorPacket_BLDC_DirectReadResult,    CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT,   CUSTOM_DECODE, 0,              0) \
+    X(CANMotorPacket_BLDC_GetEncoderEstimates, CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE_GET, AUTO,          CAN_SCHEMA_ACK, 0) \
+    X(CANMotorPacket_BLDC_EncoderEstimates,    CAN_COMMAND_ID__BLDC_ENCODER_ESTIMATE,     AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_SetAxisState,        CAN_COMMAND_ID__BLDC_AXIS_STATE,           AUTO,          0,              0) \
+    X(CANMotorPacket_BLDC_ApplySetpoints,      CAN_COMMAND_ID__BLDC_APPLY_SETPOINTS,      AUTO,          0,              0)
+
+// Peripheral packets
+
+// dutyCycle in percent, clamped to 0-100 by the builder
+#define CANPeripheralPacket_SetPWMDutyCycle_FIELDS(F, P) \
+    F(P, UInt8,    peripheralID)                          \
+    F(P, Float32,  dutyCycle)
+
+// drive is 0 to stop, positive for forwards and negative for reverse
+#define CANPeripheralPacket_SetLinearActuator_FIELDS(F, P) \
+    F(P, UInt8,    peripheralID)                            \
+    F(P, Int8,     drive)
+
+#define CANPeripheralPacket_SetRoverLEDColor_FIELDS(F, P) \
+    F(P, UInt8,    red)                                    \
+    F(P, UInt8,    green)                                  \
+    F(P, UInt8,    blue)
+
+#define CANPeripheralPacket_SetBrakes_FIELDS(F, P) \
+    F(P, UInt8,    brake_id)                        \
+    F(P, UInt8,    state)
+
+#define CANPeripheralPacket_SetRoverLEDRed_FIELDS(F, P)
+
+#define CANPeripheralPacket_SetRoverLEDBlue_FIELDS(F, P)
+
+#define CANPeripheralPacket_SetRoverLEDGreenFlash_FIELDS(F, P)
+
+#define CANPeripheralPacket_SetReset_FIELDS(F, P)
+
+#define CANPeripheralPacket_SetServoAngle_FIELDS(F, P) \
+    F(P, UInt16,   servo_angle)                         \
+    F(P, UInt8,    servo_id)
+
+#define CAN_SCHEMA_PERIPHERAL(X)                                                                                      \
+    X(CANPeripheralPacket_SetPWMDutyCycle,       CAN_COMMAND_ID__PWM_DUTY_CYCLE,          CUSTOM_BUILD, 0, 0) \
+    X(CANPeripheralPacket_SetLinearActuator,     CAN_COMMAND_ID__LINEAR_ACTUATOR_CONTROL, AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetRoverLEDColor,      CAN_COMMAND_ID__ROVER_LED_COLOR,         AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetBrakes,             CAN_COMMAND_ID__SET_BRAKE_CONTROL,       AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetRoverLEDRed,        CAN_COMMAND_ID__SET_LED_RED,             AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetRoverLEDBlue,       CAN_COMMAND_ID__SET_LED_BLUE,            AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetRoverLEDGreenFlash, CAN_COMMAND_ID__SET_LED_GREEN_FLASH,     AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetReset,              CAN_COMMAND_ID__RESET,                   AUTO,         0, 0) \
+    X(CANPeripheralPacket_SetServoAngle,         CAN_COMMAND_ID__SERVO_ANGLE,             CUSTOM_BUILD, 0, 0)
+
+// Power packets
+
+// voltage in V, current in A, soc (state of charge) as a fraction, temperature in fahrenheit
+#define CANPowerPacket_PowerStatus_FIELDS(F, P) \
+    F(P, Float16,  voltage)                      \
+    F(P, Float16,  current)                      \
+    F(P, UNorm8,   soc)                          \
+    F(P, UInt8,    temperature)
+
+#define CANPowerPacket_GetPowerStatus_FIELDS(F, P)
+
+#define CAN_SCHEMA_POWER(X)                                                               \
+    X(CANPowerPacket_PowerStatus,    CAN_COMMAND_ID__POWER_STATUS,     AUTO, 0, 0) \
+    X(CANPowerPacket_GetPowerStatus, CAN_COMMAND_ID__POWER_STATUS_GET, AUTO, 0, 0)
+
+/**
+ * Every packet of every domain
+ */
+#define CAN_SCHEMA(X)         \
+    CAN_SCHEMA_UNIVERSAL(X)  \
+    CAN_SCHEMA_MOTOR(X)      \
+    CAN_SCHEMA_PERIPHERAL(X) \
+    CAN_SCHEMA_POWER(X)
+
+
+// Generators
+
+/**
+ * Offset of a field in the packet contents
+ */
+#define CAN_SCHEMA_OFFSET(NAME, FIELD) (offsetof(NAME##_Wire_t, FIELD) - 2)
+
+#define CAN_SCHEMA_WIRE_FIELD(NAME, FORMAT, FIELD) uint8_t FIELD[CAN_SCHEMA_SIZE_##FORMAT];
+
+/**
+ * Defines name_Wire_t (the 8 byte data section as a byte layout) and name_LENGTH (the contents length)
+ * A packet whose fields do not fit into the 6 content bytes fails to compile
+ */
+#define CAN_SCHEMA_DEFINE_LAYOUT(NAME, COMMAND, KIND, FLAGS, TAIL)                       \
+    typedef struct {                                                                     \
+        uint8_t command;                                                                 \
+        uint8_t senderUUID;                                                              \
+        NAME##_FIELDS(CAN_SCHEMA_WIRE_FIELD, NAME)                                       \
+    } NAME##_Wire_t;                                                                     \
+    enum { NAME##_LENGTH = sizeof(NAME##_Wire_t) - 2 };                                  \
+    typedef char NAME##_FitsInPacket_t[NAME##_LENGTH <= sizeof(((CANPacket_t *)0)->contents) ? 1 : -1];
+
+#define CAN_SCHEMA_PARAM(NAME, FORMAT, FIELD) , CAN_SCHEMA_TYPE_##FORMAT FIELD
+#define CAN_SCHEMA_STORE(NAME, FORMAT, FIELD) \
+    CAN_SCHEMA_STORE_##FORMAT(result.contents + CAN_SCHEMA_OFFSET(NAME, FIELD), FIELD);
+
+#define CAN_SCHEMA_BUILDER(NAME, COMMAND, FLAGS)                                                          \
+    inline static CANPacket_t NAME(CANDevice_t sender, CANDevice_t device NAME##_FIELDS(CAN_SCHEMA_PARAM, NAME)) { \
+        CANPacket_t result = {                                                                            \
+            .device = device,                                                                             \
+            .priority = ((FLAGS) & CAN_SCHEMA_HIGH_PRIORITY) ? CAN_PRIORITY_HIGH : CAN_PRIORITY_LOW,      \
+            .contentsLength = NAME##_LENGTH,                                                              \
+            .command = ((FLAGS) & CAN_SCHEMA_ACK) ? CAN_ACK(COMMAND) : (COMMAND),                         \
+            .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)                                            \
+        };                                                                                                \
+        NAME##_FIELDS(CAN_SCHEMA_STORE, NAME)                                                             \
+        return result;                                                                                    \
+    }
+
+#define CAN_SCHEMA_BUILDER_AUTO(NAME, COMMAND, FLAGS)          CAN_SCHEMA_BUILDER(NAME, COMMAND, FLAGS)
+#define CAN_SCHEMA_BUILDER_CUSTOM_BUILD(NAME, COMMAND, FLAGS)
+#define CAN_SCHEMA_BUILDER_CUSTOM_DECODE(NAME, COMMAND, FLAGS) CAN_SCHEMA_BUILDER(NAME, COMMAND, FLAGS)
+#define CAN_SCHEMA_BUILDER_CUSTOM(NAME, COMMAND, FLAGS)
+
+/**
+ * Defines the builder name(sender, device, fields...) for packets whose kind generates one
+ */
+#define CAN_SCHEMA_DEFINE_BUILDER(NAME, COMMAND, KIND, FLAGS, TAIL) CAN_SCHEMA_BUILDER_##KIND(NAME, COMMAND, FLAGS)
+
+#define CAN_SCHEMA_MEMBER(NAME, FORMAT, FIELD) CAN_SCHEMA_TYPE_##FORMAT FIELD;
+#define CAN_SCHEMA_LOAD(NAME, FORMAT, FIELD) \
+    result.FIELD = CAN_SCHEMA_LOAD_##FORMAT(packet->contents + CAN_SCHEMA_OFFSET(NAME, FIELD));
+
+#define CAN_SCHEMA_DECODER(NAME)                                                   \
+    typedef struct {                                                               \
+        CANDevice_t sender;                                                        \
+        CANDevice_t receiver;                                                      \
+        NAME##_FIELDS(CAN_SCHEMA_MEMBER, NAME)                                     \
+    } NAME##_Decoded_t;                                                            \
+                                                                                   \
+    inline static NAME##_Decoded_t NAME##_Decode(const CANPacket_t *packet) {      \
+        NAME##_Decoded_t result = {                                                \
+            .sender = (CANDevice_t){.deviceUUID = packet->senderUUID},             \
+            .receiver = packet->device                                             \
+        };                                                                         \
+        NAME##_FIELDS(CAN_SCHEMA_LOAD, NAME)                                       \
+        return result;                                                             \
+    }
+
+#define CAN_SCHEMA_DECODER_AUTO(NAME)          CAN_SCHEMA_DECODER(NAME)
+#define CAN_SCHEMA_DECODER_CUSTOM_BUILD(NAME)  CAN_SCHEMA_DECODER(NAME)
+#define CAN_SCHEMA_DECODER_CUSTOM_DECODE(NAME)
+#define CAN_SCHEMA_DECODER_CUSTOM(NAME)
+
+/**
+ * Defines name_Decoded_t and name_Decode for packets whose kind generates them
+ */
+#define CAN_SCHEMA_DEFINE_DECODER(NAME, COMMAND, KIND, FLAGS, TAIL) CAN_SCHEMA_DECODER_##KIND(NAME)
+
+CAN_SCHEMA(CAN_SCHEMA_DEFINE_LAYOUT)
+
+
+// Length tables
+
+/**
+ * Returned by the length tables for commands without a packet
+ */
+#define CAN_SCHEMA_UNKNOWN_LENGTH 0xFF
+
+#define CAN_SCHEMA_MIN_LENGTH_CASE(NAME, COMMAND, KIND, FLAGS, TAIL) case COMMAND: return NAME##_LENGTH - (TAIL);
+#define CAN_SCHEMA_MAX_LENGTH_CASE(NAME, COMMAND, KIND, FLAGS, TAIL) case COMMAND: return NAME##_LENGTH;
+
+/**
+ * Returns the smallest valid contentsLength of a command (the acknowledgement bit is ignored)
+ * or CAN_SCHEMA_UNKNOWN_LENGTH if the command has no packet
+ */
+inline static uint8_t CANSchemaMinLength(CANCommand_t command) {
+    switch (command & 0x7F) {
+        CAN_SCHEMA(CAN_SCHEMA_MIN_LENGTH_CASE)
+        default: return CAN_SCHEMA_UNKNOWN_LENGTH;
+    }
+}
+
+/**
+ * Returns the largest valid contentsLength of a command (the acknowledgement bit is ignored)
+ * or CAN_SCHEMA_UNKNOWN_LENGTH if the command has no packet
+ */
+inline static uint8_t CANSchemaMaxLength(CANCommand_t command) {
+    switch (command & 0x7F) {
+        CAN_SCHEMA(CAN_SCHEMA_MAX_LENGTH_CASE)
+        default: return CAN_SCHEMA_UNKNOWN_LENGTH;
+    }
+}
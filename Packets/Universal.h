@@ -5,92 +5,117 @@
  * These Universal packets must be supported by all devices on the CAN network
  */
 
-#include "../CANPacket.h"
-#include "../CANCommandIDs.h"
+#include "Schema.h"
 
 #include <stdlib.h>
 #include <string.h>
 
 /**
- * Returns an emergency stop packet designed to be sent to the given device
+ * Builders generated from Schema.h:
+ *
+ * CANUniversalPacket_EStop(sender, device)
+ *   emergency stop, sent at high priority
+ * CANUniversalPacket_HeartBeat(sender, device, error, state)
+ *   indicates to the device that the sender is active, with its error state and state
+ * CANUniversalPacket_Acknowledge(sender, device, failure, commandID)
+ *   general acknowledgement, sent when one was requested but no specific acknowledge packet exists
+ *   commandID should not include the acknowledgement bit
+ * CANUniversalPacket_GetFirmwareVersion(sender, device)
+ *   queries the firmware version, acknowledgement is requested automatically
+ *   the response is a CANUniversalPacket_FirmwareVersion
+ * CANUniversalPacket_TransportFlowControl(sender, device, status, blockSize, separationMicros)
+ *   sent by the receiver of a segmented transfer, see CANTransport.h
+ * CANUniversalPacket_FirmwareBegin(sender, device, imageSize, imageTag)
+ * CANUniversalPacket_FirmwareCommit(sender, device, block, crc)
+ * CANUniversalPacket_FirmwareStatus(sender, device, status, window, offset)
+ *   firmware update, see CANFirmware.h
  */
-inline static CANPacket_t CANUniversalPacket_EStop(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t){
-        .device = device,
-        .priority = CAN_PRIORITY_HIGH,
-        .contentsLength = 0,
-        .command = CAN_COMMAND_ID__E_STOP,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
-    };
-}
+CAN_SCHEMA_UNIVERSAL(CAN_SCHEMA_DEFINE_BUILDER)
+
+#define CAN_FIRMWARE_VERSION_LEN 4
 
 /**
- * Returns a heartbeat packet that indicates to the device that the sender is active
- * Contains device specific state information
- * error contains information on the current error state of the device (e.g. bad config, over temp, etc.)
- * state contains information on the current state of the device (e.g. idle, startup, etc.)
+ * Returns a packet that encodes the firmware version
+ * Should be sent as a response to a GetFirmwareVersion packet
+ *
+ * Firmware version is a 16 bit unsigned int + a string up to 4 bytes long (eg. odrv v312 for odrive, stpr v4 or something for stepper)
  */
-inline static CANPacket_t CANUniversalPacket_HeartBeat(CANDevice_t sender, CANDevice_t device, uint32_t error, uint8_t state) {
+inline static CANPacket_t CANUniversalPacket_FirmwareVersion(CANDevice_t sender, CANDevice_t device, const char *name, uint16_t versionID) {
+    size_t nameLength = strlen(name);
+    if (nameLength > CAN_FIRMWARE_VERSION_LEN) nameLength = CAN_FIRMWARE_VERSION_LEN;
     CANPacket_t result = {
         .device = device,
-        .contentsLength = 5,
-        .command = CAN_COMMAND_ID__HEARTBEAT,
+        .contentsLength = (uint8_t)(CANUniversalPacket_FirmwareVersion_LENGTH - CAN_FIRMWARE_VERSION_LEN + nameLength),
+        .command = CAN_COMMAND_ID__VERSION,
         .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
-	CANStoreUInt32(result.contents + 0, error);
-    result.contents[4] = state;
+    CANStoreUInt16(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareVersion, versionID), versionID);
+    memcpy(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareVersion, name), name, nameLength);
     return result;
 }
 
 /**
- * Returns a packet that represents a general acknowledgement
- * Should be sent when an acknowledgment was requested but no specific acknowledge packet exists
- * commandId should not include acknowledgement bit
+ * Flow control status of a segmented transfer
+ */
+#define CAN_TRANSPORT_FLOW_CONTINUE 0 // send the next block
+#define CAN_TRANSPORT_FLOW_WAIT     1 // keep waiting, the receiver is busy
+#define CAN_TRANSPORT_FLOW_OVERFLOW 2 // the receiver cannot take the payload, the transfer is aborted
+#define CAN_TRANSPORT_FLOW_ABORTED  3 // a consecutive frame was lost, the transfer is aborted
+#define CAN_TRANSPORT_FLOW_DONE     4 // the whole payload arrived
+
+#define CAN_TRANSPORT_FIRST_DATA_LEN       3
+#define CAN_TRANSPORT_CONSECUTIVE_DATA_LEN 5
+
+/**
+ * Returns the first frame of a segmented transfer, holding the payload length, its tag and its first bytes
+ * data has to hold min(length, CAN_TRANSPORT_FIRST_DATA_LEN) bytes
  */
-inline static CANPacket_t CANUniversalPacket_Acknowledge(CANDevice_t sender, CANDevice_t device, bool failure, CANCommand_t commandId) {
-    return (CANPacket_t){
+inline static CANPacket_t CANUniversalPacket_TransportFirst(CANDevice_t sender, CANDevice_t device, uint16_t length,
+                                                            uint8_t tag, const uint8_t *data) {
+    uint8_t dataLength = length > CAN_TRANSPORT_FIRST_DATA_LEN ? CAN_TRANSPORT_FIRST_DATA_LEN : (uint8_t)length;
+    CANPacket_t result = {
         .device = device,
-        .contentsLength = 2,
-        .command = CAN_COMMAND_ID__ACKNOWLEDGE,
-        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID),
-        .contents = {failure, commandId}
+        .contentsLength = (uint8_t)(CANUniversalPacket_TransportFirst_LENGTH - CAN_TRANSPORT_FIRST_DATA_LEN + dataLength),
+        .command = CAN_COMMAND_ID__TRANSPORT_FIRST,
+        .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
+    CANStoreUInt16(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, length), length);
+    result.contents[CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, tag)] = tag;
+    memcpy(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportFirst, data), data, dataLength);
+    return result;
 }
 
 /**
- * Returns a packet to query the firmware version from the given device
- * Packet is automatically set to acknowledge
- *
- * The firmware version of a device consists of a 16 bit unsigned int alongside a string that is up to 4 bytes long
- * The int should be updated whenever the firmware is updated
+ * Returns a consecutive frame of a segmented transfer, dataLength is clamped to CAN_TRANSPORT_CONSECUTIVE_DATA_LEN
  */
-inline static CANPacket_t CANUniversalPacket_GetFirmwareVersion(CANDevice_t sender, CANDevice_t device) {
-    return (CANPacket_t){
+inline static CANPacket_t CANUniversalPacket_TransportConsecutive(CANDevice_t sender, CANDevice_t device, uint8_t sequence,
+                                                                  const uint8_t *data, uint8_t dataLength) {
+    if (dataLength > CAN_TRANSPORT_CONSECUTIVE_DATA_LEN) dataLength = CAN_TRANSPORT_CONSECUTIVE_DATA_LEN;
+    CANPacket_t result = {
         .device = device,
-        .contentsLength = 0,
-        .command = CAN_ACK(CAN_COMMAND_ID__VERSION_GET),
+        .contentsLength = (uint8_t)(CANUniversalPacket_TransportConsecutive_LENGTH - CAN_TRANSPORT_CONSECUTIVE_DATA_LEN + dataLength),
+        .command = CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE,
         .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
+    result.contents[CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportConsecutive, sequence)] = sequence;
+    memcpy(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_TransportConsecutive, data), data, dataLength);
+    return result;
 }
 
-#define CAN_FIRMWARE_VERSION_LEN 4
+#define CAN_FIRMWARE_DATA_LEN 6
 
 /**
- * Returns a packet that encodes the firmware version
- * Should be sent as a response to a GetFirmwareVersion packet
- *
- * Firmware version is a 16 bit unsigned int + a string up to 4 bytes long (eg. odrv v312 for odrive, stpr v4 or something for stepper)
+ * Returns a firmware data frame, dataLength is clamped to CAN_FIRMWARE_DATA_LEN
  */
-inline static CANPacket_t CANUniversalPacket_FirmwareVersion(CANDevice_t sender, CANDevice_t device, const char *name, uint16_t versionID) {
-    size_t nameLength = strlen(name);
-    if (nameLength > CAN_FIRMWARE_VERSION_LEN) nameLength = CAN_FIRMWARE_VERSION_LEN;
+inline static CANPacket_t CANUniversalPacket_FirmwareData(CANDevice_t sender, CANDevice_t device,
+                                                          const uint8_t *data, uint8_t dataLength) {
+    if (dataLength > CAN_FIRMWARE_DATA_LEN) dataLength = CAN_FIRMWARE_DATA_LEN;
     CANPacket_t result = {
         .device = device,
-        .contentsLength = (uint8_t)(2 + nameLength),
-        .command = CAN_COMMAND_ID__VERSION,
+        .contentsLength = dataLength,
+        .command = CAN_COMMAND_ID__FIRMWARE_DATA,
         .senderUUID = ((CANDeviceUUID_t)sender.deviceUUID)
     };
-    CANStoreUInt16(result.contents + 0, versionID);
-    memcpy(result.contents + 2, name, nameLength);
+    memcpy(result.contents + CAN_SCHEMA_OFFSET(CANUniversalPacket_FirmwareData, data), data, dataLength);
     return result;
 }
@@ -1,17 +1,87 @@
 #pragma once
 
 /** This header file declares the generic functions that this CAN implementation provides for
- * basic setup and RX/TX. The only currently supported chipset is the STM32G4 family.
+ * basic setup and RX/TX. Supported targets are the STM32G4 family, Linux hosts through SocketCAN and
+ * an in-process bus simulator for benchmarking without hardware.
+ * The target is selected by defining CHIP_TYPE to one of the CHIP_TYPE_x values below.
  * 
  */
 
 #include "../CANPacket.h"
+#include "../CANFilter.h"
 
 #define CHIP_TYPE_STM32_G4XX         0x02
+#define CHIP_TYPE_SOCKETCAN          0x03
+#define CHIP_TYPE_SIM                0x04
+
+// Generic return codes, these intentionally overlap with the HAL status codes used by the STM32 port
+#define CAN_OK                       0x00
+#define CAN_ERROR                    0x01
+#define CAN_BUSY                     0x02
+#define CAN_TIMEOUT                  0x03
 
 // Generic pointer for CAN Handles, should cast to pointer of whatever handle given chipset uses for CAN
 typedef void *CANHandle_t;
 
+/**
+ * Receive time of a packet, counted in port specific ticks since an arbitrary epoch
+ * Only differences between timestamps of the same handle are meaningful, see CANGetTimestampFrequency
+ */
+typedef uint64_t CANTimestamp_t;
+
+/**
+ * Report of a packet that went out on the bus, see CANSetTxCompleteCallback
+ * Both times are on the clock of CANGetTimestamp, so sent - queued is the time the packet waited
+ * in software queues, the hardware and behind other traffic (arbitration)
+ */
+typedef struct {
+    uint16_t identifier;   // CANGetPacketHeader of the packet
+    CANTimestamp_t queued; // when the packet was passed to a send function
+    CANTimestamp_t sent;   // when the frame was transmitted (exact point is port specific)
+} CANTxEvent_t;
+
+/**
+ * Called once for every transmitted packet, possibly from an interrupt
+ */
+typedef void (*CANTxCompleteCallback_t)(CANHandle_t CANHandle, const CANTxEvent_t *event, void *context);
+
+/**
+ * Traffic and error counters kept by every port, cumulative since CANInit
+ * Counters are updated without locking and wrap around, so take two snapshots and subtract
+ * (unsigned subtraction stays correct across a wrap)
+ */
+typedef struct {
+    uint32_t framesSent;     // packets accepted for transmission by the send functions
+    uint32_t framesReceived; // valid CAN26 packets taken from the hardware
+    uint32_t txDropped;      // packets refused, or evicted from a transmit queue, because it was full
+    uint32_t rxInvalid;      // received frames discarded for not being CAN26 packets (bad DLC, extended or remote)
+    uint32_t rxOverflows;    // received frames lost because a hardware FIFO or software queue was full
+    uint32_t bitsSent;       // bus time of the sent packets in bits, see CANFrameBits
+    uint32_t bitsReceived;   // bus time of the received packets in bits
+} CANStats_t;
+
+/**
+ * Returns the number of bits a standard frame with the given number of data bytes occupies on the bus
+ * SOF through interframe space is 47 bits plus 8 per data byte, stuff bits (up to ~20% more) are not counted
+ * CAN FD frames are counted the same way, as if sent entirely at the nominal bit rate
+ */
+inline static uint32_t CANFrameBits(uint8_t dataLength) {
+    return 47 + 8 * (uint32_t)dataLength;
+}
+
+/**
+ * Estimates the fraction of bus time (0.0 - 1.0) used by this node's traffic between two CANGetStats snapshots
+ * Only frames this node sent or accepted are counted, so with filters installed this is a lower bound of the bus load
+ * @param before Earlier snapshot
+ * @param after Later snapshot
+ * @param bitRate Nominal bit rate of the bus in bits per second
+ * @param seconds Time between the snapshots
+ */
+inline static float CANBusLoad(const CANStats_t *before, const CANStats_t *after, uint32_t bitRate, float seconds) {
+    uint32_t bits = (after->bitsSent - before->bitsSent) + (after->bitsReceived - before->bitsReceived);
+    return (float)bits / ((float)bitRate * seconds);
+}
+
 
 /** 
  * Initialize the CAN for this device with filters and the receive queue.
@@ -36,3 +106,105 @@ uint8_t CANSend(CANHandle_t CANHandle, const CANPacket_t *packet);
  *  @return 1 if message was present, 0 if no messages in FIFO, negative if error encountered.
  */
 int8_t CANPollAndReceive(CANHandle_t CANHandle, CANPacket_t *packet);
+
+/**
+ *  Send several CAN Packets for hardware transmission in one call.
+ *  Packets are queued in order, stopping at the first one the hardware does not accept.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure
+ *  @param packets Array of CAN26 packet structs already filled with data.
+ *  @param count Number of packets in the array.
+ *  @return Number of packets accepted for transmission (the first n of the array).
+ */
+uint16_t CANSendBatch(CANHandle_t CANHandle, const CANPacket_t *packets, uint16_t count);
+
+/**
+ *  Drain up to maxCount received CAN Packets in one call.
+ *  Frames that are not valid CAN26 packets are discarded and not counted.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure
+ *  @param packets Array of CAN26 packet structs to fill with received data
+ *  @param maxCount Capacity of the array.
+ *  @return Number of packets written to the array, 0 if none were pending.
+ */
+uint16_t CANReceiveBatch(CANHandle_t CANHandle, CANPacket_t *packets, uint16_t maxCount);
+
+/**
+ *  Send a CAN FD Packet for hardware transmission.
+ *  The data phase uses the faster data bit rate where the port and peripheral are set up for it (BRS).
+ *  @param CANHandle Pointer for chip specific CAN Handle structure
+ *  @param packet Pointer to CAN26 FD packet struct already filled with data.
+ *  @return 0 if no error encountered, error codes otherwise.
+ */
+uint8_t CANSendFD(CANHandle_t CANHandle, const CANFDPacket_t *packet);
+
+/**
+ *  Check FIFO for received CAN or CAN FD frames and parse first if present.
+ *  Classic frames are returned with up to 6 bytes of contents. Nodes that expect FD traffic should use
+ *  this instead of CANPollAndReceive, which rejects frames longer than 8 bytes.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure
+ *  @param packet Pointer to CAN26 FD packet struct to fill with received data
+ *  @return 1 if message was present, 0 if no messages in FIFO, negative if error encountered.
+ */
+int8_t CANPollAndReceiveFD(CANHandle_t CANHandle, CANFDPacket_t *packet);
+
+/**
+ *  Replace the acceptance filters installed by CANInit with a plan from CANFilterPlan.
+ *  The plan should list this device first so that its own packets keep arriving.
+ *  Frames no filter accepts are dropped, as they are with the filters of CANInit.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure, previously passed to CANInit
+ *  @param plan Filters to install
+ *  @return 0 if no error encountered, error codes otherwise (including when the plan exceeds the filter budget).
+ */
+uint8_t CANConfigureFilters(CANHandle_t CANHandle, const CANFilterPlan_t *plan);
+
+/**
+ *  Copy the traffic and error counters of the handle.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure, previously passed to CANInit
+ *  @param stats Filled with the current counters
+ *  @return 0 if no error encountered, error codes otherwise.
+ */
+uint8_t CANGetStats(CANHandle_t CANHandle, CANStats_t *stats);
+
+/**
+ *  Check FIFO for received CAN Packets and parse first if present, also returning when it was received.
+ *  The timestamp is taken by the hardware (or the kernel) when the frame arrived, so comparing it with
+ *  CANGetTimestamp gives the true age of the data, including any time spent waiting in queues.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure
+ *  @param packet Pointer to CAN26 packet struct to fill with received data
+ *  @param timestamp Set to the receive time of the packet, may be NULL
+ *  @return 1 if message was present, 0 if no messages in FIFO, negative if error encountered.
+ */
+int8_t CANPollAndReceiveTimestamped(CANHandle_t CANHandle, CANPacket_t *packet, CANTimestamp_t *timestamp);
+
+/**
+ *  Returns the current time on the clock used for receive timestamps of the handle.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure, previously passed to CANInit
+ */
+CANTimestamp_t CANGetTimestamp(CANHandle_t CANHandle);
+
+/**
+ *  Returns the number of timestamp ticks per second of the handle, 0 if unknown.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure, previously passed to CANInit
+ */
+uint32_t CANGetTimestampFrequency(CANHandle_t CANHandle);
+
+/**
+ * Returns the time in seconds since the given receive timestamp of the handle
+ * E.g. the age of the sample carried by a CANMotorPacket_BLDC_EncoderEstimates packet
+ */
+inline static float CANTimestampAge(CANHandle_t CANHandle, CANTimestamp_t timestamp) {
+    uint32_t frequency = CANGetTimestampFrequency(CANHandle);
+    if (!frequency) {
+        return 0.0f;
+    }
+    return (float)(CANGetTimestamp(CANHandle) - timestamp) / (float)frequency;
+}
+
+/**
+ *  Register a callback reporting when each sent packet actually made it onto the bus.
+ *  Whether (and from which context) the callback runs is port specific, see the port headers.
+ *  @param CANHandle Pointer for chip specific CAN Handle structure, previously passed to CANInit
+ *  @param callback Function to call, NULL to stop reporting
+ *  @param context Passed through to the callback
+ *  @return 0 if no error encountered, error codes otherwise (including when the port was built without transmit events).
+ */
+uint8_t CANSetTxCompleteCallback(CANHandle_t CANHandle, CANTxCompleteCallback_t callback, void *context);
@@ -10,8 +10,10 @@
 #include "Port.h"
 
 #if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_STM32_G4XX
+#include "PortSTM32g4xx.h"
 #include "../CANPacket.h"
 #include "stm32g4xx_hal.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -20,6 +22,18 @@
 #define UUID_POS           3
 #define GROUP_MASK_POS     0
 
+// Layout of an RX FIFO element in message RAM (see RM0440), each element is 18 words on the STM32G4
+#define RX_ELEMENT_SIZE    0x48
+#define RX_ELEMENT_RTR     (1u << 29)
+#define RX_ELEMENT_XTD     (1u << 30)
+#define RX_ELEMENT_ID_POS  18
+#define RX_ELEMENT_DLC_POS 16
+#define RX_ELEMENT_RXTS    0xFFFFu
+
+// Number of send times remembered for transmit events, indexed by message marker
+// Must exceed the frames that can be in flight: 3 hardware TX buffers plus 3 TX event FIFO elements
+#define TX_EVENT_SLOTS     8
+
 // Settings for standard CAN operation (no FD mode)
 static const FDCAN_TxHeaderTypeDef txHeaderCANStandard = {
     .IdType = FDCAN_STANDARD_ID,
@@ -27,10 +41,489 @@ static const FDCAN_TxHeaderTypeDef txHeaderCANStandard = {
     .FDFormat = FDCAN_CLASSIC_CAN,
     .ErrorStateIndicator = FDCAN_ESI_ACTIVE,
     .BitRateSwitch = FDCAN_BRS_OFF,
-    .TxEventFifoControl = FDCAN_NO_TX_EVENTS,
+    .TxEventFifoControl = CAN_TX_EVENTS ? FDCAN_STORE_TX_EVENTS : FDCAN_NO_TX_EVENTS,
     .MessageMarker = 0
 };
 
+// Settings for CAN FD operation
+static const FDCAN_TxHeaderTypeDef txHeaderCANFD = {
+    .IdType = FDCAN_STANDARD_ID,
+    .TxFrameType = FDCAN_DATA_FRAME,
+    .FDFormat = FDCAN_FD_CAN,
+    .ErrorStateIndicator = FDCAN_ESI_ACTIVE,
+    .BitRateSwitch = CAN_FD_BRS ? FDCAN_BRS_ON : FDCAN_BRS_OFF,
+    .TxEventFifoControl = CAN_TX_EVENTS ? FDCAN_STORE_TX_EVENTS : FDCAN_NO_TX_EVENTS,
+    .MessageMarker = 0
+};
+
+#if CAN_TX_QUEUE_SIZE
+// Entry of the software transmit queue
+// sequence breaks ties between equal identifiers so that they leave in the order they were sent
+typedef struct {
+    CANPacket_t packet;
+    uint16_t identifier;
+    uint32_t sequence;
+#if CAN_TX_EVENTS
+    CANTimestamp_t queued;
+#endif
+} TxQueueEntry_t;
+#endif
+
+#if CAN_RX_RING_SIZE
+// Entry of the receive ring, the timestamp is extended by the ISR while it is still recent
+typedef struct {
+    CANPacket_t packet;
+    CANTimestamp_t timestamp;
+} RxRingEntry_t;
+#endif
+
+// Per peripheral state, looked up by the HAL handle from both the main loop and interrupts
+typedef struct {
+    FDCAN_HandleTypeDef *hfdcan;
+    // Receive counters are written from the RX interrupt in ring mode, everything else from the caller's context
+    CANStats_t stats;
+    // Software extension of the 16 bit hardware timestamp counter, only touched with interrupts disabled
+    CANTimestamp_t timestampTicks;
+    uint16_t timestampCounter;
+    uint32_t timestampFrequency;
+#if CAN_TX_EVENTS
+    // Send time of the frames in flight, the marker increments for each frame handed to the hardware
+    CANTxCompleteCallback_t txCallback;
+    void *txCallbackContext;
+    uint8_t txMarker;
+    CANTimestamp_t txQueued[TX_EVENT_SLOTS];
+#endif
+#if CAN_TX_QUEUE_SIZE
+    // Binary min heap on (identifier, sequence), touched with interrupts disabled or from the TX complete ISR
+    uint32_t txCount;
+    uint32_t txSequence;
+    CANTxQueueStats_t txStats;
+    TxQueueEntry_t txHeap[CAN_TX_QUEUE_SIZE];
+#if CAN_TX_QUEUE_ID_ORDERED
+    // Identifiers currently held by each hardware TX buffer, valid where the bit in txPendingBuffers is set
+    uint32_t txPendingBuffers;
+    uint16_t txPendingIdentifiers[3];
+#endif
+#endif
+#if CAN_RX_RING_SIZE
+    // Single producer (RX FIFO0 interrupt) single consumer (CANPollAndReceive) ring
+    // The indices run freely and are masked on access, head is only written by the ISR, tail only by the consumer
+    volatile uint32_t rxHead;
+    volatile uint32_t rxTail;
+    CANRxRingStats_t rxStats;
+    RxRingEntry_t rxRing[CAN_RX_RING_SIZE];
+#endif
+} PortInstance_t;
+
+static PortInstance_t instances[CAN_MAX_INSTANCES];
+
+/**
+ * Returns the state belonging to the given peripheral, NULL if CANInit was never called on it
+ */
+static PortInstance_t *findInstance(const FDCAN_HandleTypeDef *hfdcan) {
+    for (int i = 0; i < CAN_MAX_INSTANCES; ++i) {
+        if (instances[i].hfdcan == hfdcan) {
+            return &instances[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Returns the state belonging to the given peripheral, claiming a free slot if it has none yet
+ * Lets peripherals set up without CANInit be used like before instances were tracked
+ * NULL if every slot is in use by another peripheral
+ */
+static PortInstance_t *attachInstance(FDCAN_HandleTypeDef *hfdcan) {
+    PortInstance_t *instance = findInstance(hfdcan);
+    if (!instance) {
+        instance = findInstance(NULL);
+        if (instance) {
+            memset(instance, 0, sizeof(PortInstance_t));
+            instance->hfdcan = hfdcan;
+        }
+    }
+    return instance;
+}
+
+/**
+ * Returns the state belonging to the given peripheral reset to its initial values, claiming a free slot if needed
+ * NULL if every slot is in use by another peripheral
+ */
+static PortInstance_t *claimInstance(FDCAN_HandleTypeDef *hfdcan) {
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (instance) {
+        memset(instance, 0, sizeof(PortInstance_t));
+        instance->hfdcan = hfdcan;
+    }
+    return instance;
+}
+
+/**
+ * Pops the oldest frame from the hardware RX FIFO0 and parses it into the packet
+ * The element is read straight out of message RAM into the packet's data section,
+ * skipping the RX header decode and intermediate buffer of HAL_FDCAN_GetRxMessage
+ * The FIFO must not be empty, timestamp is set to the 16 bit hardware receive timestamp
+ * Returns 1 on success, negative if the frame was consumed but is not a valid CAN26 packet
+ */
+static int8_t readRxFifo0(FDCAN_HandleTypeDef *hfdcan, CANPacket_t *RxPacket, uint16_t *timestamp) {
+    uint32_t getIndex = (hfdcan->Instance->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+    const volatile uint32_t *element = (const volatile uint32_t *)(uintptr_t)(hfdcan->msgRam.RxFIFO0SA + getIndex * RX_ELEMENT_SIZE);
+    uint32_t r0 = element[0];
+    uint32_t r1 = element[1];
+    uint32_t data[2] = {element[2], element[3]};
+    // Acknowledging hands the element back to the hardware, so it has to be read completely first
+    hfdcan->Instance->RXF0A = getIndex;
+
+    *timestamp = r1 & RX_ELEMENT_RXTS;
+    uint8_t dlc = (r1 >> RX_ELEMENT_DLC_POS) & 0xF;
+    if ((r0 & (RX_ELEMENT_XTD | RX_ELEMENT_RTR)) || dlc < 2 || dlc > 8) {
+        return -HAL_ERROR;
+    }
+    CANSetPacketHeader(RxPacket, (r0 >> RX_ELEMENT_ID_POS) & 0x7FF);
+    RxPacket->contentsLength = dlc - 2;
+    memcpy(CANGetData(RxPacket), data, sizeof(data));
+    return 1;
+}
+
+/**
+ * Converts a 16 bit hardware timestamp taken at most one counter wrap ago to the 64 bit timeline
+ * Safe to call from both interrupts and the main loop
+ */
+static CANTimestamp_t extendTimestamp(PortInstance_t *instance, uint16_t timestamp) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint16_t counter = HAL_FDCAN_GetTimestampCounter(instance->hfdcan);
+    instance->timestampTicks += (uint16_t)(counter - instance->timestampCounter);
+    instance->timestampCounter = counter;
+    CANTimestamp_t extended = instance->timestampTicks - (uint16_t)(counter - timestamp);
+    __set_PRIMASK(primask);
+    return extended;
+}
+
+/**
+ * Returns the current time on the receive timestamp clock
+ */
+static CANTimestamp_t currentTimestamp(PortInstance_t *instance) {
+    return extendTimestamp(instance, HAL_FDCAN_GetTimestampCounter(instance->hfdcan));
+}
+
+#if CAN_TX_EVENTS
+/**
+ * Tags a frame about to be handed to the hardware with a message marker for its transmit event
+ * queued is the time the packet was passed to a send function
+ */
+static void txTag(PortInstance_t *instance, FDCAN_TxHeaderTypeDef *header, CANTimestamp_t queued) {
+    uint8_t marker = instance->txMarker++;
+    header->MessageMarker = marker;
+    instance->txQueued[marker % TX_EVENT_SLOTS] = queued;
+}
+#endif
+
+/**
+ * Returns the number of hardware TX buffers a frame can be added to
+ * TXFQS.TFFL only counts FIFO elements and reads 0 in queue mode (TXBC.TFQM), where every buffer
+ * without a pending request is free. TFQF is set in both modes once none is.
+ */
+static uint32_t txFreeLevel(FDCAN_HandleTypeDef *hfdcan) {
+    uint32_t status = hfdcan->Instance->TXFQS;
+    if (status & FDCAN_TXFQS_TFQF) {
+        return 0;
+    }
+    if (hfdcan->Instance->TXBC & FDCAN_TXBC_TFQM) {
+        return 3 - __builtin_popcount(hfdcan->Instance->TXBRP & (FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2));
+    }
+    return (status & FDCAN_TXFQS_TFFL) >> FDCAN_TXFQS_TFFL_Pos;
+}
+
+/**
+ * Updates the counters for a packet accepted for transmission (status HAL_OK) or refused
+ */
+static void countSent(PortInstance_t *instance, uint8_t status, uint8_t dataLength) {
+    if (status == HAL_OK) {
+        ++instance->stats.framesSent;
+        instance->stats.bitsSent += CANFrameBits(dataLength);
+    } else {
+        ++instance->stats.txDropped;
+    }
+}
+
+/**
+ * Updates the counters for a frame read from the hardware (result of readRxFifo0)
+ */
+static void countReceived(PortInstance_t *instance, int8_t result, uint8_t dataLength) {
+    if (result > 0) {
+        ++instance->stats.framesReceived;
+        instance->stats.bitsReceived += CANFrameBits(dataLength);
+    } else if (result < 0) {
+        ++instance->stats.rxInvalid;
+    }
+}
+
+#if !CAN_RX_RING_SIZE
+/**
+ * Counts a hardware RX FIFO0 overflow flagged since the last call
+ * The peripheral only flags that frames were lost, so each overflow counts as one frame
+ */
+static void countFifoOverflow(PortInstance_t *instance) {
+    if (__HAL_FDCAN_GET_FLAG(instance->hfdcan, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST)) {
+        __HAL_FDCAN_CLEAR_FLAG(instance->hfdcan, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST);
+        ++instance->stats.rxOverflows;
+    }
+}
+
+/**
+ * Pops the oldest frame from the hardware RX FIFO0 and parses it into the FD packet
+ * The FIFO must not be empty, accepts both classic and FD frames
+ * Returns 1 on success, negative if the frame was consumed but is not a valid CAN26 packet
+ */
+static int8_t readRxFifo0FD(FDCAN_HandleTypeDef *hfdcan, CANFDPacket_t *RxPacket) {
+    FDCAN_RxHeaderTypeDef RxHeader;
+    // The data section of the FD packet is 64 bytes, so the HAL can copy into it directly
+    HAL_FDCAN_GetRxMessage(hfdcan, FDCAN_RX_FIFO0, &RxHeader, CANFDGetData(RxPacket));
+    CANFDSetPacketHeader(RxPacket, RxHeader.Identifier);
+    uint8_t length = CANFDDlcToLength(RxHeader.DataLength);
+    if (length < 2) {
+        return -HAL_ERROR;
+    }
+    RxPacket->contentsLength = length - 2;
+    return 1;
+}
+#endif
+
+#if CAN_TX_QUEUE_SIZE
+
+/**
+ * Returns whether a should be transmitted before b
+ */
+static bool txBefore(const TxQueueEntry_t *a, const TxQueueEntry_t *b) {
+    if (a->identifier != b->identifier) {
+        return a->identifier < b->identifier;
+    }
+    return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+/**
+ * Moves the entry at index towards the root until the heap property holds
+ */
+static void txSiftUp(TxQueueEntry_t *heap, uint32_t index) {
+    TxQueueEntry_t entry = heap[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!txBefore(&entry, &heap[parent])) {
+            break;
+        }
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = entry;
+}
+
+/**
+ * Moves the entry at index towards the leaves until the heap property holds
+ */
+static void txSiftDown(TxQueueEntry_t *heap, uint32_t count, uint32_t index) {
+    TxQueueEntry_t entry = heap[index];
+    while (2 * index + 1 < count) {
+        uint32_t child = 2 * index + 1;
+        if (child + 1 < count && txBefore(&heap[child + 1], &heap[child])) {
+            ++child;
+        }
+        if (!txBefore(&heap[child], &entry)) {
+            break;
+        }
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = entry;
+}
+
+/**
+ * Removes the entry at index from the heap
+ */
+static void txRemove(PortInstance_t *instance, uint32_t index) {
+    --instance->txCount;
+    if (index == instance->txCount) {
+        return;
+    }
+    instance->txHeap[index] = instance->txHeap[instance->txCount];
+    txSiftDown(instance->txHeap, instance->txCount, index);
+    txSiftUp(instance->txHeap, index);
+}
+
+/**
+ * Adds a packet to the queue, must be called with interrupts disabled
+ * When the queue is full the lowest priority entry (always a leaf) is evicted if the new packet outranks it
+ * Returns HAL_OK if the packet was queued
+ */
+static uint8_t txPush(PortInstance_t *instance, const CANPacket_t *packet) {
+    TxQueueEntry_t entry = {
+        .packet = *packet,
+        .identifier = CANGetPacketHeader(packet),
+        .sequence = instance->txSequence++,
+#if CAN_TX_EVENTS
+        .queued = currentTimestamp(instance)
+#endif
+    };
+
+    if (instance->txCount == CAN_TX_QUEUE_SIZE) {
+        ++instance->txStats.queueOverflows;
+        uint32_t worst = CAN_TX_QUEUE_SIZE / 2;
+        for (uint32_t i = worst + 1; i < CAN_TX_QUEUE_SIZE; ++i) {
+            if (txBefore(&instance->txHeap[worst], &instance->txHeap[i])) {
+                worst = i;
+            }
+        }
+        if (!txBefore(&entry, &instance->txHeap[worst])) {
+            return HAL_BUSY;
+        }
+        // The evicted packet is dropped, a refused one is counted by the caller
+        ++instance->stats.txDropped;
+        txRemove(instance, worst);
+    }
+
+    instance->txHeap[instance->txCount] = entry;
+    txSiftUp(instance->txHeap, instance->txCount);
+    ++instance->txCount;
+    if (instance->txCount > instance->txStats.highWaterMark) {
+        instance->txStats.highWaterMark = instance->txCount;
+    }
+    return HAL_OK;
+}
+
+#if CAN_TX_QUEUE_ID_ORDERED
+/**
+ * Returns whether a frame with this identifier is still waiting in a hardware TX buffer
+ * In queue mode the hardware picks between equal identifiers by buffer index, which could reorder them
+ */
+static bool txIdentifierPending(const PortInstance_t *instance, uint16_t identifier) {
+    for (int i = 0; i < 3; ++i) {
+        if ((instance->txPendingBuffers & (1u << i)) && instance->txPendingIdentifiers[i] == identifier) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+/**
+ * Moves the highest priority queued packets into the hardware TX FIFO until either is exhausted
+ * Must be called with interrupts disabled or from the FDCAN interrupt
+ */
+static void txRefill(PortInstance_t *instance) {
+    FDCAN_HandleTypeDef *hfdcan = instance->hfdcan;
+    FDCAN_TxHeaderTypeDef messageHeader = txHeaderCANStandard;
+    while (instance->txCount && txFreeLevel(hfdcan)) {
+        const TxQueueEntry_t *next = &instance->txHeap[0];
+#if CAN_TX_QUEUE_ID_ORDERED
+        if (txIdentifierPending(instance, next->identifier)) {
+            break;
+        }
+#endif
+        messageHeader.Identifier = next->identifier;
+        messageHeader.DataLength = CANGetDlc(&next->packet);
+#if CAN_TX_EVENTS
+        txTag(instance, &messageHeader, next->queued);
+#endif
+        if (HAL_FDCAN_AddMessageToTxFifoQ(hfdcan, &messageHeader, CANGetDataConst(&next->packet)) != HAL_OK) {
+            break;
+        }
+#if CAN_TX_QUEUE_ID_ORDERED
+        uint32_t buffer = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(hfdcan);
+        instance->txPendingBuffers |= buffer;
+        instance->txPendingIdentifiers[__builtin_ctz(buffer)] = next->identifier;
+#endif
+        txRemove(instance, 0);
+    }
+}
+
+/**
+ * Returns whether a frame handed to the hardware past the queue could leave before a queued packet
+ * of the same or higher priority, or in queue mode before a pending frame with its identifier
+ * Must be called with interrupts disabled
+ */
+static bool txOvertakes(const PortInstance_t *instance, uint16_t identifier) {
+    if (instance->txCount && instance->txHeap[0].identifier <= identifier) {
+        return true;
+    }
+#if CAN_TX_QUEUE_ID_ORDERED
+    return txIdentifierPending(instance, identifier);
+#else
+    return false;
+#endif
+}
+
+/**
+ * Called by the HAL from the FDCAN interrupt whenever hardware TX buffers finish transmitting
+ */
+void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes) {
+    PortInstance_t *instance = findInstance(hfdcan);
+    if (!instance) {
+        return;
+    }
+#if CAN_TX_QUEUE_ID_ORDERED
+    instance->txPendingBuffers &= ~BufferIndexes;
+#else
+    (void)BufferIndexes;
+#endif
+    txRefill(instance);
+}
+
+#endif // CAN_TX_QUEUE_SIZE
+
+#if CAN_TX_EVENTS
+
+/**
+ * Reports the frames that left the hardware, called by the HAL from the FDCAN interrupt
+ */
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs) {
+    (void)TxEventFifoITs;
+    PortInstance_t *instance = findInstance(hfdcan);
+    if (!instance) {
+        return;
+    }
+    FDCAN_TxEventFifoTypeDef event;
+    while (HAL_FDCAN_GetTxEvent(hfdcan, &event) == HAL_OK) {
+        if (!instance->txCallback) {
+            continue;
+        }
+        CANTxEvent_t report = {
+            .identifier = (uint16_t)event.Identifier,
+            .queued = instance->txQueued[event.MessageMarker % TX_EVENT_SLOTS],
+            .sent = extendTimestamp(instance, (uint16_t)event.TxTimestamp)
+        };
+        instance->txCallback(hfdcan, &report, instance->txCallbackContext);
+    }
+}
+
+#endif // CAN_TX_EVENTS
+
+
+// Global filter rejecting standard frames no filter element matches, extended and remote frames
+#define RXGFC_REJECT_ALL ((FDCAN_REJECT << FDCAN_RXGFC_ANFS_Pos) | (FDCAN_REJECT << FDCAN_RXGFC_ANFE_Pos) | \
+                          (FDCAN_REJECT_REMOTE << FDCAN_RXGFC_RRFS_Pos) | (FDCAN_REJECT_REMOTE << FDCAN_RXGFC_RRFE_Pos))
+
+/**
+ * Makes the peripheral drop every frame its filter elements do not accept
+ * At reset non-matching standard frames land in RX FIFO0, so the filters would not filter anything.
+ * RXGFC can only be written in configuration mode, a running peripheral is stopped around the change.
+ */
+static uint8_t rejectUnfiltered(FDCAN_HandleTypeDef *hfdcan) {
+    uint32_t fields = FDCAN_RXGFC_ANFS | FDCAN_RXGFC_ANFE | FDCAN_RXGFC_RRFS | FDCAN_RXGFC_RRFE;
+    if ((hfdcan->Instance->RXGFC & fields) == RXGFC_REJECT_ALL) {
+        return HAL_OK;
+    }
+    bool running = hfdcan->State == HAL_FDCAN_STATE_BUSY;
+    if (running && HAL_FDCAN_Stop(hfdcan) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    HAL_StatusTypeDef status = HAL_FDCAN_ConfigGlobalFilter(hfdcan, FDCAN_REJECT, FDCAN_REJECT,
+                                                            FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
+    if (running && HAL_FDCAN_Start(hfdcan) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    return (uint8_t)status;
+}
 
 uint8_t CANInit(CANHandle_t CANHandle, CANDevice_t *CANDevice) {
     if (!CANHandle || !CANDevice) {
@@ -40,6 +533,15 @@ uint8_t CANInit(CANHandle_t CANHandle, CANDevice_t *CANDevice) {
     FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
     FDCAN_FilterTypeDef filterConfig;
 
+    PortInstance_t *instance = claimInstance(hfdcan);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+
+    if (rejectUnfiltered(hfdcan) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
     // Filter 0: Filters for only messages matching this devices UUID
     filterConfig.IdType = FDCAN_STANDARD_ID;
     filterConfig.FilterIndex = 0;
@@ -72,6 +574,39 @@ uint8_t CANInit(CANHandle_t CANHandle, CANDevice_t *CANDevice) {
         HAL_FDCAN_ConfigFilter(hfdcan, &filterConfig);
     }
 
+#if CAN_RX_RING_SIZE
+    // Every new message (and every hardware overflow) interrupts so the ring can drain the 3 deep FIFO early
+    if (HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO0_MESSAGE_LOST, 0) != HAL_OK) {
+        return HAL_ERROR;
+    }
+#endif
+
+    // Receive timestamps count nominal bit times, the counter can only be configured before HAL_FDCAN_Start
+    if (HAL_FDCAN_ConfigTimestampCounter(hfdcan, (CAN_TIMESTAMP_PRESCALER - 1) << FDCAN_TSCC_TCP_Pos) != HAL_OK ||
+        HAL_FDCAN_EnableTimestampCounter(hfdcan, FDCAN_TIMESTAMP_INTERNAL) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    uint32_t clockDivider = hfdcan->Init.ClockDivider ? 2 * hfdcan->Init.ClockDivider : 1;
+    uint32_t bitTime = hfdcan->Init.NominalPrescaler * (1 + hfdcan->Init.NominalTimeSeg1 + hfdcan->Init.NominalTimeSeg2);
+    instance->timestampFrequency = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN) / clockDivider / bitTime / CAN_TIMESTAMP_PRESCALER;
+
+#if CAN_TX_QUEUE_ID_ORDERED
+    // The peripheral is still in configuration mode after HAL_FDCAN_Init, so the TX mode can be changed here
+    hfdcan->Init.TxFifoQueueMode = FDCAN_TX_QUEUE_OPERATION;
+    SET_BIT(hfdcan->Instance->TXBC, FDCAN_TXBC_TFQM);
+#endif
+
+#if CAN_TX_EVENTS
+    if (HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_TX_EVT_FIFO_NEW_DATA, 0) != HAL_OK) {
+        return HAL_ERROR;
+    }
+#endif
+
+#if CAN_TX_QUEUE_SIZE
+    if (HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_TX_COMPLETE, FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2) != HAL_OK) {
+        return HAL_ERROR;
+    }
+#endif
 
     return (uint8_t)HAL_FDCAN_Start(hfdcan); // Needed to activate CAN node, must be done after configuration of filters and optional features. 
 
@@ -84,44 +619,406 @@ uint8_t CANSend(CANHandle_t CANHandle, const CANPacket_t *CANPacket) {
     }
     
     FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+#if CAN_TX_QUEUE_SIZE
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t status = txPush(instance, CANPacket);
+    countSent(instance, status, CANGetDlc(CANPacket));
+    txRefill(instance);
+    __set_PRIMASK(primask);
+    return status;
+#else
     FDCAN_TxHeaderTypeDef messageHeader = txHeaderCANStandard;
     messageHeader.Identifier = CANGetPacketHeader(CANPacket);
     messageHeader.DataLength = CANGetDlc(CANPacket);
 
-    return (uint8_t)HAL_FDCAN_AddMessageToTxFifoQ(hfdcan, &messageHeader, CANGetDataConst(CANPacket));
+    // Senders in interrupts (e.g. CANSchedulerTimerElapsed) would race the HAL put index and the message marker
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+#if CAN_TX_EVENTS
+    txTag(instance, &messageHeader, currentTimestamp(instance));
+#endif
+    uint8_t status = (uint8_t)HAL_FDCAN_AddMessageToTxFifoQ(hfdcan, &messageHeader, CANGetDataConst(CANPacket));
+    countSent(instance, status, messageHeader.DataLength);
+    __set_PRIMASK(primask);
+    return status;
+#endif
 }
 
 
 
 int8_t CANPollAndReceive(CANHandle_t CANHandle, CANPacket_t *RxPacket) {
+    return CANPollAndReceiveTimestamped(CANHandle, RxPacket, NULL);
+}
+
+int8_t CANPollAndReceiveTimestamped(CANHandle_t CANHandle, CANPacket_t *RxPacket, CANTimestamp_t *timestamp) {
     if (!CANHandle || !RxPacket) {
-        return HAL_ERROR;
+        return -HAL_ERROR;
     }
     
     FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return -HAL_ERROR;
+    }
+#if CAN_RX_RING_SIZE
+    uint32_t tail = instance->rxTail;
+    if (tail == instance->rxHead) {
+        return 0;
+    }
+    // Pairs with the barrier in the ISR so the slot contents are read after the head that published them
+    __DMB();
+    const RxRingEntry_t *entry = &instance->rxRing[tail & (CAN_RX_RING_SIZE - 1)];
+    *RxPacket = entry->packet;
+    if (timestamp) {
+        *timestamp = entry->timestamp;
+    }
+    __DMB();
+    instance->rxTail = tail + 1;
+    return 1;
+#else
+    countFifoOverflow(instance);
     if(!HAL_FDCAN_GetRxFifoFillLevel(hfdcan, FDCAN_RX_FIFO0)) {
         return 0;
     } else { // messages present in FIFO
-        FDCAN_RxHeaderTypeDef RxHeader;
-        uint8_t pRxData[8];
-        HAL_FDCAN_GetRxMessage(hfdcan, FDCAN_RX_FIFO0, &RxHeader, pRxData);
-        RxPacket->priority = (RxHeader.Identifier & (1 << 10)) ? CAN_PRIORITY_LOW : CAN_PRIORITY_HIGH;
-
-        uint16_t deviceBits = RxHeader.Identifier & 0x3FF; 
-        RxPacket->device.peripheralDomain = deviceBits & 0x01;
-        RxPacket->device.motorDomain = (deviceBits >> 1) & 0x01;
-        RxPacket->device.powerDomain = (deviceBits >> 2) & 0x01;
-        RxPacket->device.deviceUUID = (deviceBits >> 3) & 0x7F;
-        uint8_t dlc = RxHeader.DataLength;
-        if (dlc < 2 || dlc > 8) {
+        uint16_t rxTimestamp;
+        int8_t result = readRxFifo0(hfdcan, RxPacket, &rxTimestamp);
+        countReceived(instance, result, CANGetDlc(RxPacket));
+        if (timestamp) {
+            *timestamp = extendTimestamp(instance, rxTimestamp);
+        }
+        return result;
+    }
+#endif
+}
+
+uint16_t CANSendBatch(CANHandle_t CANHandle, const CANPacket_t *packets, uint16_t count) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return 0;
+    }
+#if CAN_TX_QUEUE_SIZE
+    uint16_t queued = 0;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (; queued < count; ++queued) {
+        if (txPush(instance, &packets[queued]) != HAL_OK) {
+            break;
+        }
+        countSent(instance, HAL_OK, CANGetDlc(&packets[queued]));
+    }
+    instance->stats.txDropped += count - queued;
+    txRefill(instance);
+    __set_PRIMASK(primask);
+    return queued;
+#else
+    FDCAN_TxHeaderTypeDef messageHeader = txHeaderCANStandard;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t freeLevel = txFreeLevel(hfdcan);
+    uint16_t accepted = count > freeLevel ? (uint16_t)freeLevel : count;
+#if CAN_TX_EVENTS
+    CANTimestamp_t queued = currentTimestamp(instance);
+#endif
+
+    uint16_t sent = 0;
+    for (; sent < accepted; ++sent) {
+        messageHeader.Identifier = CANGetPacketHeader(&packets[sent]);
+        messageHeader.DataLength = CANGetDlc(&packets[sent]);
+#if CAN_TX_EVENTS
+        txTag(instance, &messageHeader, queued);
+#endif
+        if (HAL_FDCAN_AddMessageToTxFifoQ(hfdcan, &messageHeader, CANGetDataConst(&packets[sent])) != HAL_OK) {
+            break;
+        }
+        countSent(instance, HAL_OK, messageHeader.DataLength);
+    }
+    instance->stats.txDropped += count - sent;
+    __set_PRIMASK(primask);
+    return sent;
+#endif
+}
+
+
+uint16_t CANReceiveBatch(CANHandle_t CANHandle, CANPacket_t *packets, uint16_t maxCount) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return 0;
+    }
+    uint16_t received = 0;
+#if CAN_RX_RING_SIZE
+    uint32_t tail = instance->rxTail;
+    uint32_t available = instance->rxHead - tail;
+    __DMB();
+    for (; received < maxCount && received < available; ++received) {
+        packets[received] = instance->rxRing[(tail + received) & (CAN_RX_RING_SIZE - 1)].packet;
+    }
+    __DMB();
+    instance->rxTail = tail + received;
+#else
+    countFifoOverflow(instance);
+    uint32_t fillLevel = HAL_FDCAN_GetRxFifoFillLevel(hfdcan, FDCAN_RX_FIFO0);
+    for (; fillLevel > 0 && received < maxCount; --fillLevel) {
+        uint16_t rxTimestamp;
+        int8_t result = readRxFifo0(hfdcan, &packets[received], &rxTimestamp);
+        countReceived(instance, result, CANGetDlc(&packets[received]));
+        if (result > 0) {
+            ++received;
+        }
+    }
+#endif
+    return received;
+}
+
+uint8_t CANSendFD(CANHandle_t CANHandle, const CANFDPacket_t *CANPacket) {
+    if (!CANHandle || !CANPacket) {
+        return HAL_ERROR;
+    }
+
+    FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+    FDCAN_TxHeaderTypeDef messageHeader = txHeaderCANFD;
+    messageHeader.Identifier = CANFDGetPacketHeader(CANPacket);
+    messageHeader.DataLength = CANFDLengthToDlc(CANPacket->contentsLength + 2);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+#if CAN_TX_QUEUE_SIZE
+    if (txOvertakes(instance, (uint16_t)messageHeader.Identifier)) {
+        countSent(instance, HAL_BUSY, CANFDGetDataLength(CANPacket));
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+#endif
+#if CAN_TX_EVENTS
+    txTag(instance, &messageHeader, currentTimestamp(instance));
+#endif
+    // Padding bytes come from the (zero initialized) unused contents of the packet
+    uint8_t status = (uint8_t)HAL_FDCAN_AddMessageToTxFifoQ(hfdcan, &messageHeader, CANFDGetDataConst(CANPacket));
+#if CAN_TX_QUEUE_SIZE && CAN_TX_QUEUE_ID_ORDERED
+    // Queued packets with the same identifier wait for this frame as well
+    if (status == HAL_OK) {
+        uint32_t buffer = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(hfdcan);
+        instance->txPendingBuffers |= buffer;
+        instance->txPendingIdentifiers[__builtin_ctz(buffer)] = (uint16_t)messageHeader.Identifier;
+    }
+#endif
+    countSent(instance, status, CANFDGetDataLength(CANPacket));
+    __set_PRIMASK(primask);
+    return status;
+}
+
+
+int8_t CANPollAndReceiveFD(CANHandle_t CANHandle, CANFDPacket_t *RxPacket) {
+    if (!CANHandle || !RxPacket) {
+        return -HAL_ERROR;
+    }
+
+#if CAN_RX_RING_SIZE
+    return -HAL_ERROR;
+#else
+    FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    PortInstance_t *instance = attachInstance(hfdcan);
+    if (!instance) {
+        return -HAL_ERROR;
+    }
+    countFifoOverflow(instance);
+    if (!HAL_FDCAN_GetRxFifoFillLevel(hfdcan, FDCAN_RX_FIFO0)) {
+        return 0;
+    }
+    int8_t result = readRxFifo0FD(hfdcan, RxPacket);
+    countReceived(instance, result, RxPacket->contentsLength + 2);
+    return result;
+#endif
+}
+
+#if CAN_RX_RING_SIZE
+
+/**
+ * Drains the hardware RX FIFO0 into the ring, called by the HAL from the FDCAN interrupt
+ * Frames that do not fit are dropped (newest first) and counted, so the hardware FIFO never stalls
+ */
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs) {
+    PortInstance_t *instance = findInstance(hfdcan);
+    if (!instance) {
+        return;
+    }
+    if (RxFifo0ITs & FDCAN_IT_RX_FIFO0_MESSAGE_LOST) {
+        ++instance->rxStats.fifoMessagesLost;
+        ++instance->stats.rxOverflows;
+    }
+
+    uint32_t head = instance->rxHead;
+    while (HAL_FDCAN_GetRxFifoFillLevel(hfdcan, FDCAN_RX_FIFO0)) {
+        uint32_t used = head - instance->rxTail;
+        if (used >= CAN_RX_RING_SIZE) {
+            CANPacket_t discarded;
+            uint16_t rxTimestamp;
+            readRxFifo0(hfdcan, &discarded, &rxTimestamp);
+            ++instance->rxStats.ringOverflows;
+            ++instance->stats.rxOverflows;
+            continue;
+        }
+        RxRingEntry_t *slot = &instance->rxRing[head & (CAN_RX_RING_SIZE - 1)];
+        uint16_t rxTimestamp;
+        int8_t result = readRxFifo0(hfdcan, &slot->packet, &rxTimestamp);
+        countReceived(instance, result, CANGetDlc(&slot->packet));
+        if (result < 0) {
+            continue;
+        }
+        slot->timestamp = extendTimestamp(instance, rxTimestamp);
+        ++head;
+        if (used + 1 > instance->rxStats.highWaterMark) {
+            instance->rxStats.highWaterMark = used + 1;
+        }
+        // Publish the slot before the head so the consumer never sees a partially written packet
+        __DMB();
+        instance->rxHead = head;
+    }
+}
+
+#endif // CAN_RX_RING_SIZE
+
+uint8_t CANConfigureFilters(CANHandle_t CANHandle, const CANFilterPlan_t *plan) {
+    if (!CANHandle || !plan) {
+        return HAL_ERROR;
+    }
+
+    FDCAN_HandleTypeDef *hfdcan = (FDCAN_HandleTypeDef *)CANHandle;
+    if (plan->count > hfdcan->Init.StdFiltersNbr) {
+        return HAL_ERROR;
+    }
+
+    // The filter list lives in message RAM, so it can be rewritten while the peripheral runs
+    FDCAN_FilterTypeDef filterConfig;
+    filterConfig.IdType = FDCAN_STANDARD_ID;
+    for (uint32_t i = 0; i < hfdcan->Init.StdFiltersNbr; ++i) {
+        filterConfig.FilterIndex = i;
+        if (i < plan->count) {
+            const CANFilter_t *filter = &plan->filters[i];
+            filterConfig.FilterType = filter->type == CAN_FILTER_RANGE ? FDCAN_FILTER_RANGE :
+                                      filter->type == CAN_FILTER_DUAL ? FDCAN_FILTER_DUAL : FDCAN_FILTER_MASK;
+            filterConfig.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
+            filterConfig.FilterID1 = filter->id1;
+            filterConfig.FilterID2 = filter->id2;
+        } else {
+            filterConfig.FilterType = FDCAN_FILTER_MASK;
+            filterConfig.FilterConfig = FDCAN_FILTER_DISABLE;
+            filterConfig.FilterID1 = 0;
+            filterConfig.FilterID2 = 0;
+        }
+        if (HAL_FDCAN_ConfigFilter(hfdcan, &filterConfig) != HAL_OK) {
             return HAL_ERROR;
         }
-        RxPacket->contentsLength = dlc - 2;
-        memcpy(&RxPacket->command, pRxData, 1);
-        memcpy(&RxPacket->senderUUID, pRxData + 1, 1);
-        memcpy(&RxPacket->contents, pRxData + 2, RxPacket->contentsLength);
-        return 1;
     }
+    // Already the case after CANInit, needed when the peripheral was set up without it
+    return rejectUnfiltered(hfdcan);
+}
+
+uint8_t CANGetStats(CANHandle_t CANHandle, CANStats_t *stats) {
+    if (!CANHandle || !stats) {
+        return HAL_ERROR;
+    }
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+    *stats = instance->stats;
+    return HAL_OK;
+}
+
+CANTimestamp_t CANGetTimestamp(CANHandle_t CANHandle) {
+    if (!CANHandle) {
+        return 0;
+    }
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return 0;
+    }
+    return currentTimestamp(instance);
+}
+
+uint32_t CANGetTimestampFrequency(CANHandle_t CANHandle) {
+    if (!CANHandle) {
+        return 0;
+    }
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return 0;
+    }
+    return instance->timestampFrequency;
+}
+
+uint8_t CANSetTxCompleteCallback(CANHandle_t CANHandle, CANTxCompleteCallback_t callback, void *context) {
+    if (!CANHandle) {
+        return HAL_ERROR;
+    }
+#if CAN_TX_EVENTS
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+    // The TX event interrupt reads both fields
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    instance->txCallback = callback;
+    instance->txCallbackContext = context;
+    __set_PRIMASK(primask);
+    return HAL_OK;
+#else
+    (void)callback;
+    (void)context;
+    return HAL_ERROR;
+#endif
+}
+
+uint8_t CANGetRxRingStats(CANHandle_t CANHandle, CANRxRingStats_t *stats) {
+    if (!CANHandle || !stats) {
+        return HAL_ERROR;
+    }
+#if CAN_RX_RING_SIZE
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+    *stats = instance->rxStats;
+    return HAL_OK;
+#else
+    return HAL_ERROR;
+#endif
+}
+
+uint8_t CANGetTxQueueStats(CANHandle_t CANHandle, CANTxQueueStats_t *stats) {
+    if (!CANHandle || !stats) {
+        return HAL_ERROR;
+    }
+#if CAN_TX_QUEUE_SIZE
+    PortInstance_t *instance = findInstance((FDCAN_HandleTypeDef *)CANHandle);
+    if (!instance) {
+        return HAL_ERROR;
+    }
+    *stats = instance->txStats;
+    return HAL_OK;
+#else
+    return HAL_ERROR;
+#endif
 }
 
 #endif // defined(CHIP_TYPE) &&CHIP_TYPE == CHIPT_TYPE_STM32_G4XX
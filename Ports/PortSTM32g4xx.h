@@ -0,0 +1,123 @@
+#pragma once
+
+/** This header declares the STM32G4 specific configuration and extensions of the port in PortSTM32g4xx.c.
+ * Configuration macros are meant to be set from the build (e.g. -DCAN_RX_RING_SIZE=32).
+ */
+
+#include "Port.h"
+
+/**
+ * Number of FDCAN peripherals the port keeps state for at the same time, the STM32G4 has up to 3
+ * Each one gets its own port state (and receive ring if enabled) in CANInit, or on first use
+ * if the peripheral was set up without CANInit
+ */
+#ifndef CAN_MAX_INSTANCES
+#define CAN_MAX_INSTANCES 3
+#endif
+
+/**
+ * Set to 0 to send CAN FD frames without bit rate switching
+ * With bit rate switching the data phase uses the data bit timing configured for the peripheral,
+ * which must be initialized with FrameFormat = FDCAN_FRAME_FD_BRS for CANSendFD to work
+ */
+#ifndef CAN_FD_BRS
+#define CAN_FD_BRS 1
+#endif
+
+/**
+ * Prescaler of the FDCAN timestamp counter (1 - 16), which counts nominal bit times divided by it
+ * The hardware counter is only 16 bits wide, the port extends it to 64 bits in software. For that the
+ * counter has to be sampled at least once per wrap (65536 * prescaler bit times, about 1 s at 1 Mbit/s
+ * with the default), which happens on every CANGetTimestamp and timestamped receive,
+ * and in ring mode on every received frame.
+ */
+#ifndef CAN_TIMESTAMP_PRESCALER
+#define CAN_TIMESTAMP_PRESCALER 16
+#endif
+
+/**
+ * Size of the interrupt driven receive ring in packets, must be 0 or a power of 2
+ * 0 keeps the original polling behaviour where CANPollAndReceive reads the hardware FIFO directly.
+ * Otherwise HAL_FDCAN_RxFifo0Callback drains RX FIFO0 into the ring and CANPollAndReceive dequeues from it.
+ *
+ * When enabled this port defines HAL_FDCAN_RxFifo0Callback, so the application must not define its own,
+ * and the FDCAN interrupt line 0 has to be enabled in the NVIC.
+ * The ring only holds classic packets: CAN FD frames are dropped by the ISR and CANPollAndReceiveFD is unavailable.
+ */
+#ifndef CAN_RX_RING_SIZE
+#define CAN_RX_RING_SIZE 0
+#endif
+
+#if CAN_RX_RING_SIZE & (CAN_RX_RING_SIZE - 1)
+#error "CAN_RX_RING_SIZE must be a power of 2"
+#endif
+
+/**
+ * Counters for sizing the receive ring
+ * All counters are cumulative since CANInit
+ */
+typedef struct {
+    uint32_t ringOverflows;    // frames read from the hardware FIFO but dropped because the ring was full
+    uint32_t fifoMessagesLost; // hardware RX FIFO0 overflow events (frames lost before the ISR ran)
+    uint32_t highWaterMark;    // largest number of packets waiting in the ring at once
+} CANRxRingStats_t;
+
+/**
+ * Copies the receive ring counters of the given handle
+ * @param CANHandle Pointer for STM32's FDCAN handle, previously passed to CANInit
+ * @param stats Filled with the current counters
+ * @return 0 on success, error codes otherwise (including when the ring is disabled)
+ */
+uint8_t CANGetRxRingStats(CANHandle_t CANHandle, CANRxRingStats_t *stats);
+
+/**
+ * Size of the software transmit queue in packets, 0 disables it
+ * When enabled, CANSend places packets into a priority queue ordered by their CANGetPacketHeader identifier
+ * (the same order as bus arbitration) instead of failing when the 3 slot hardware TX FIFO is full.
+ * The TX complete interrupt refills the hardware from the queue, so the FDCAN interrupt line 0 has to be
+ * enabled in the NVIC and this port defines HAL_FDCAN_TxBufferCompleteCallback.
+ * If the queue is full, a new packet replaces the lowest priority queued packet if it outranks it.
+ * CANSendFD bypasses the queue and goes straight to the hardware. It returns HAL_BUSY while a queued packet
+ * with the same or a lower identifier waits, so FD frames never overtake higher priority packets.
+ */
+#ifndef CAN_TX_QUEUE_SIZE
+#define CAN_TX_QUEUE_SIZE 0
+#endif
+
+/**
+ * Set to 1 to switch the hardware TX FIFO into FDCAN's TX queue mode during CANInit
+ * In queue mode the peripheral always offers the pending frame with the lowest identifier to the bus,
+ * so a high priority frame no longer waits behind frames already handed to the hardware.
+ * When the software queue is enabled as well, frames sharing an identifier are held back until
+ * the previous one has left, preserving their order.
+ */
+#ifndef CAN_TX_QUEUE_ID_ORDERED
+#define CAN_TX_QUEUE_ID_ORDERED 0
+#endif
+
+/**
+ * Set to 1 to record transmit events for CANSetTxCompleteCallback
+ * Every frame handed to the hardware is tagged with a message marker, and the TX event FIFO is
+ * drained by HAL_FDCAN_TxEventFifoCallback (defined by this port, needs the FDCAN interrupt line 0 in the NVIC).
+ * The callback runs in that interrupt, and the reported sent time is the frame's start of frame on the bus.
+ */
+#ifndef CAN_TX_EVENTS
+#define CAN_TX_EVENTS 0
+#endif
+
+/**
+ * Counters for sizing the transmit queue
+ * All counters are cumulative since CANInit
+ */
+typedef struct {
+    uint32_t queueOverflows; // packets dropped (new or evicted) because the queue was full
+    uint32_t highWaterMark;  // largest number of packets waiting in the queue at once
+} CANTxQueueStats_t;
+
+/**
+ * Copies the transmit queue counters of the given handle
+ * @param CANHandle Pointer for STM32's FDCAN handle, previously passed to CANInit
+ * @param stats Filled with the current counters
+ * @return 0 on success, error codes otherwise (including when the queue is disabled)
+ */
+uint8_t CANGetTxQueueStats(CANHandle_t CANHandle, CANTxQueueStats_t *stats);
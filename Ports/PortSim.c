@@ -0,0 +1,530 @@
+/**This module implements the generic port functions on a virtual CAN bus shared by any number of
+ * simulated nodes in one process. It models arbitration, acceptance filtering and frame timing
+ * (including bit stuffing), which makes it possible to measure bus load, queueing delay and
+ * worst case latency of a node set without the rover hardware. See PortSim.h for usage.
+ */
+
+#include "Port.h"
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SIM
+#include "PortSim.h"
+#include "../CANPacket.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Bit positions of specific address portions for filter detection
+#define PRIORITY_POS       10
+#define UUID_POS           3
+#define GROUP_MASK_POS     0
+
+// CRC delimiter, ACK slot, ACK delimiter, 7 bit EOF and 3 bit interframe space, none of which are stuffed
+#define FRAME_TRAILER_BITS 13
+
+#define CRC15_POLYNOMIAL   0x4599
+
+// SOF through BRS of a CAN FD base frame, sent at the nominal bit rate
+#define ARBITRATION_BITS_FD 17
+
+
+void CANSimBusInit(CANSimBus_t *bus, uint32_t bitRate) {
+    memset(bus, 0, sizeof(CANSimBus_t));
+    bus->bitRate = bitRate;
+    bus->dataBitRate = bitRate;
+}
+
+
+float CANSimBusLoad(const CANSimBus_t *bus) {
+    if (bus->now == 0) {
+        return 0.0f;
+    }
+    return (float)bus->busyTime / (float)bus->now;
+}
+
+
+/**
+ * Counts the stuff bits inserted into the bit sequence
+ * After 5 equal bits a complementary stuff bit is inserted, which itself starts the next run
+ * Stuff bits inserted after one of the first split bits are also counted in beforeSplit
+ */
+static uint32_t countStuffBits(const uint8_t *bits, uint32_t count, uint32_t split, uint32_t *beforeSplit) {
+    uint32_t stuffed = 0;
+    uint8_t last = bits[0];
+    uint8_t run = 1;
+    *beforeSplit = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        if (bits[i] == last) {
+            ++run;
+        } else {
+            last = bits[i];
+            run = 1;
+        }
+        if (run == 5) {
+            ++stuffed;
+            if (i < split) {
+                ++*beforeSplit;
+            }
+            last = !last;
+            run = 1;
+        }
+    }
+    return stuffed;
+}
+
+/**
+ * Appends the bits of value, most significant first, returns the new count
+ */
+static uint32_t appendBits(uint8_t *bits, uint32_t count, uint32_t value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        bits[count++] = (value >> i) & 1;
+    }
+    return count;
+}
+
+
+uint32_t CANSimFrameBits(uint16_t identifier, const uint8_t *data, uint8_t length, uint32_t *stuffBits) {
+    // SOF, identifier, RTR, IDE, r0, DLC, data and CRC are subject to stuffing
+    uint8_t bits[1 + 11 + 3 + 4 + 64 + 15];
+    uint32_t count = 0;
+    count = appendBits(bits, count, 0, 1);
+    count = appendBits(bits, count, identifier, 11);
+    count = appendBits(bits, count, 0, 3);
+    count = appendBits(bits, count, length, 4);
+    for (uint8_t byte = 0; byte < length; ++byte) {
+        count = appendBits(bits, count, data[byte], 8);
+    }
+
+    uint16_t crc = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t feedback = bits[i] ^ ((crc >> 14) & 1);
+        crc = (crc << 1) & 0x7FFF;
+        if (feedback) {
+            crc ^= CRC15_POLYNOMIAL;
+        }
+    }
+    count = appendBits(bits, count, crc, 15);
+
+    uint32_t unused;
+    uint32_t stuffed = countStuffBits(bits, count, 0, &unused);
+    if (stuffBits) {
+        *stuffBits = stuffed;
+    }
+    return count + stuffed + FRAME_TRAILER_BITS;
+}
+
+
+void CANSimFDFrameBits(uint16_t identifier, const uint8_t *data, uint8_t length,
+                       uint32_t *nominalBits, uint32_t *dataBits, uint32_t *stuffBits) {
+    // SOF, identifier, RRS, IDE, FDF, res and BRS are sent at the nominal rate
+    // ESI, DLC and data follow at the data rate, all of these are dynamically stuffed
+    uint8_t bits[ARBITRATION_BITS_FD + 1 + 4 + 64 * 8];
+    uint32_t count = 0;
+    count = appendBits(bits, count, 0, 1);
+    count = appendBits(bits, count, identifier, 11);
+    count = appendBits(bits, count, 0x5, 5); // RRS = 0, IDE = 0, FDF = 1, res = 0, BRS = 1
+    count = appendBits(bits, count, 0, 1);
+    count = appendBits(bits, count, CANFDLengthToDlc(length), 4);
+    for (uint8_t byte = 0; byte < length; ++byte) {
+        count = appendBits(bits, count, data[byte], 8);
+    }
+
+    uint32_t nominalStuffed;
+    uint32_t stuffed = countStuffBits(bits, count, ARBITRATION_BITS_FD, &nominalStuffed);
+
+    // Stuff count and CRC use fixed stuff bits: one before the stuff count and one after every 4th bit
+    // of the two fields, 6 with CRC17 and 7 with CRC21 (ISO 11898-1)
+    uint32_t crcBits = length > 16 ? 21 : 17;
+    uint32_t fixedStuffed = 1 + (4 + crcBits) / 4;
+
+    *nominalBits = ARBITRATION_BITS_FD + nominalStuffed + FRAME_TRAILER_BITS;
+    *dataBits = (count - ARBITRATION_BITS_FD) + (stuffed - nominalStuffed) + 4 + crcBits + fixedStuffed;
+    if (stuffBits) {
+        *stuffBits = stuffed + fixedStuffed;
+    }
+}
+
+
+/**
+ * Returns whether the node's acceptance filters (as set up by CANInit) let the identifier through
+ * Filter 0 matches the node's UUID, filters 1-3 match broadcasts to the node's declared domains
+ * After CANConfigureFilters the installed plan decides instead
+ */
+static bool simAccepts(const CANSimNode_t *node, uint16_t identifier) {
+    if (node->filtered) {
+        return CANFilterBitmapAccepts(node->filterBitmap, identifier);
+    }
+    uint8_t uuid = (identifier >> UUID_POS) & 0x7F;
+    if (uuid == node->device.deviceUUID) {
+        return true;
+    }
+    if (uuid != 0) {
+        return false;
+    }
+    return ((identifier & 0x01) && node->device.peripheralDomain) ||
+           ((identifier & 0x02) && node->device.motorDomain) ||
+           ((identifier & 0x04) && node->device.powerDomain);
+}
+
+
+/**
+ * Returns the index of the frame the node offers for arbitration, the node must have frames queued
+ */
+static uint32_t simNextFrame(const CANSimNode_t *node) {
+    uint32_t next = 0;
+    if (node->idOrdered) {
+        for (uint32_t i = 1; i < node->txCount; ++i) {
+            if (node->txQueue[i].identifier < node->txQueue[next].identifier) {
+                next = i;
+            }
+        }
+    }
+    return next;
+}
+
+
+bool CANSimBusStep(CANSimBus_t *bus) {
+    CANSimNode_t *winner = NULL;
+    uint32_t winnerIndex = 0;
+    for (uint32_t i = 0; i < bus->nodeCount; ++i) {
+        CANSimNode_t *node = bus->nodes[i];
+        if (!node->txCount) {
+            continue;
+        }
+        uint32_t index = simNextFrame(node);
+        if (!winner || node->txQueue[index].identifier < winner->txQueue[winnerIndex].identifier) {
+            winner = node;
+            winnerIndex = index;
+        }
+    }
+    if (!winner) {
+        return false;
+    }
+
+    // Every other node offering the winning identifier also wins arbitration, their data collides
+    bool collision = false;
+    for (uint32_t i = 0; i < bus->nodeCount; ++i) {
+        CANSimNode_t *node = bus->nodes[i];
+        if (node != winner && node->txCount &&
+            node->txQueue[simNextFrame(node)].identifier == winner->txQueue[winnerIndex].identifier) {
+            ++node->stats.collisions;
+            collision = true;
+        }
+    }
+    if (collision) {
+        ++winner->stats.collisions;
+        ++bus->collisions;
+    }
+
+    CANSimFrame_t frame = winner->txQueue[winnerIndex];
+    --winner->txCount;
+    memmove(&winner->txQueue[winnerIndex], &winner->txQueue[winnerIndex + 1],
+            (winner->txCount - winnerIndex) * sizeof(CANSimFrame_t));
+
+    uint32_t stuffBits;
+    uint32_t bits;
+    uint64_t start = bus->now;
+    uint64_t end;
+    if (frame.fd) {
+        uint32_t nominalBits;
+        uint32_t dataBits;
+        CANSimFDFrameBits(frame.identifier, frame.data, frame.length, &nominalBits, &dataBits, &stuffBits);
+        bits = nominalBits + dataBits;
+        end = start + (uint64_t)nominalBits * 1000000000ull / bus->bitRate +
+                      (uint64_t)dataBits * 1000000000ull / bus->dataBitRate;
+    } else {
+        bits = CANSimFrameBits(frame.identifier, frame.data, frame.length, &stuffBits);
+        end = start + (uint64_t)bits * 1000000000ull / bus->bitRate;
+    }
+    bus->now = end;
+    bus->busyTime += end - start;
+    bus->bits += bits;
+    bus->stuffBits += stuffBits;
+    ++bus->frames;
+
+    CANSimNodeStats_t *stats = &winner->stats;
+    uint64_t queued = frame.time;
+    uint64_t queueingDelay = start - queued;
+    uint64_t latency = end - queued;
+    ++stats->framesSent;
+    stats->totalQueueingDelay += queueingDelay;
+    stats->totalLatency += latency;
+    if (queueingDelay > stats->maxQueueingDelay) {
+        stats->maxQueueingDelay = queueingDelay;
+    }
+    if (latency > stats->maxLatency) {
+        stats->maxLatency = latency;
+    }
+
+    frame.time = end;
+    for (uint32_t i = 0; i < bus->nodeCount; ++i) {
+        CANSimNode_t *node = bus->nodes[i];
+        if (node == winner || !simAccepts(node, frame.identifier)) {
+            continue;
+        }
+        if (node->rxCount == CAN_SIM_QUEUE_SIZE) {
+            ++node->stats.rxQueueOverflows;
+            ++node->portStats.rxOverflows;
+            continue;
+        }
+        node->rxQueue[(node->rxHead + node->rxCount) % CAN_SIM_QUEUE_SIZE] = frame;
+        ++node->rxCount;
+        ++node->stats.framesReceived;
+    }
+
+    if (winner->txCallback) {
+        CANTxEvent_t event = {
+            .identifier = frame.identifier,
+            .queued = queued,
+            .sent = start
+        };
+        winner->txCallback(winner, &event, winner->txCallbackContext);
+    }
+    return true;
+}
+
+
+void CANSimBusRunUntil(CANSimBus_t *bus, uint64_t time) {
+    while (bus->now < time && CANSimBusStep(bus)) {
+    }
+    if (bus->now < time) {
+        bus->now = time;
+    }
+}
+
+
+uint8_t CANInit(CANHandle_t CANHandle, CANDevice_t *CANDevice) {
+    if (!CANHandle || !CANDevice) {
+        return CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    CANSimBus_t *bus = node->bus;
+    // Frame times are divided by the bit rate
+    if (!bus || !bus->bitRate) {
+        return CAN_ERROR;
+    }
+
+    bool attached = false;
+    for (uint32_t i = 0; i < bus->nodeCount; ++i) {
+        attached |= bus->nodes[i] == node;
+    }
+    if (!attached) {
+        if (bus->nodeCount == CAN_SIM_MAX_NODES) {
+            return CAN_ERROR;
+        }
+        bus->nodes[bus->nodeCount++] = node;
+    }
+
+    node->device = *CANDevice;
+    node->filtered = false;
+    node->txCount = 0;
+    node->rxHead = 0;
+    node->rxCount = 0;
+    memset(&node->stats, 0, sizeof(CANSimNodeStats_t));
+    memset(&node->portStats, 0, sizeof(CANStats_t));
+    return CAN_OK;
+}
+
+
+/**
+ * Appends a frame to the node's transmit queue and updates the counters
+ * Returns CAN_BUSY if the queue is full
+ */
+static uint8_t simQueue(CANSimNode_t *node, uint16_t identifier, bool fd, const uint8_t *data, uint8_t length) {
+    if (node->txCount == CAN_SIM_QUEUE_SIZE) {
+        ++node->stats.txQueueOverflows;
+        ++node->portStats.txDropped;
+        return CAN_BUSY;
+    }
+
+    CANSimFrame_t *frame = &node->txQueue[node->txCount++];
+    frame->identifier = identifier;
+    frame->fd = fd;
+    frame->length = length;
+    frame->time = node->bus->now;
+    memcpy(frame->data, data, length);
+    ++node->portStats.framesSent;
+    node->portStats.bitsSent += CANFrameBits(length);
+    return CAN_OK;
+}
+
+
+uint8_t CANSend(CANHandle_t CANHandle, const CANPacket_t *CANPacket) {
+    if (!CANHandle || !CANPacket) {
+        return CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    uint8_t dlc = CANGetDlc(CANPacket);
+    if (dlc < 2 || dlc > 8) {
+        ++node->portStats.txDropped;
+        return CAN_ERROR;
+    }
+    return simQueue(node, CANGetPacketHeader(CANPacket), false, CANGetDataConst(CANPacket), dlc);
+}
+
+
+/**
+ * Pops the oldest received frame of the node into the packet, the queue must not be empty
+ * timestamp (if not NULL) is set to the end of the frame on the bus
+ * Returns 1 on success, negative if the frame is not a valid CAN26 packet
+ */
+static int8_t simReceive(CANSimNode_t *node, CANPacket_t *RxPacket, CANTimestamp_t *timestamp) {
+    const CANSimFrame_t *frame = &node->rxQueue[node->rxHead];
+    node->rxHead = (node->rxHead + 1) % CAN_SIM_QUEUE_SIZE;
+    --node->rxCount;
+    if (timestamp) {
+        *timestamp = frame->time;
+    }
+
+    CANSetPacketHeader(RxPacket, frame->identifier);
+    if (frame->length < 2 || frame->length > 8) {
+        ++node->portStats.rxInvalid;
+        return -CAN_ERROR;
+    }
+    RxPacket->contentsLength = frame->length - 2;
+    memcpy(CANGetData(RxPacket), frame->data, frame->length);
+    ++node->portStats.framesReceived;
+    node->portStats.bitsReceived += CANFrameBits(frame->length);
+    return 1;
+}
+
+
+int8_t CANPollAndReceive(CANHandle_t CANHandle, CANPacket_t *RxPacket) {
+    return CANPollAndReceiveTimestamped(CANHandle, RxPacket, NULL);
+}
+
+
+int8_t CANPollAndReceiveTimestamped(CANHandle_t CANHandle, CANPacket_t *RxPacket, CANTimestamp_t *timestamp) {
+    if (!CANHandle || !RxPacket) {
+        return -CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    if (!node->rxCount) {
+        return 0;
+    }
+    return simReceive(node, RxPacket, timestamp);
+}
+
+
+uint16_t CANSendBatch(CANHandle_t CANHandle, const CANPacket_t *packets, uint16_t count) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    uint16_t sent = 0;
+    while (sent < count && CANSend(CANHandle, &packets[sent]) == CAN_OK) {
+        ++sent;
+    }
+    if (sent < count) {
+        // The refused packet was counted by CANSend, the rest of the batch was never offered
+        ((CANSimNode_t *)CANHandle)->portStats.txDropped += count - sent - 1;
+    }
+    return sent;
+}
+
+
+uint16_t CANReceiveBatch(CANHandle_t CANHandle, CANPacket_t *packets, uint16_t maxCount) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    uint16_t received = 0;
+    while (node->rxCount && received < maxCount) {
+        if (simReceive(node, &packets[received], NULL) > 0) {
+            ++received;
+        }
+    }
+    return received;
+}
+
+uint8_t CANSendFD(CANHandle_t CANHandle, const CANFDPacket_t *CANPacket) {
+    if (!CANHandle || !CANPacket) {
+        return CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    if (!node->bus->dataBitRate) {
+        ++node->portStats.txDropped;
+        return CAN_ERROR;
+    }
+    return simQueue(node, CANFDGetPacketHeader(CANPacket), true,
+                    CANFDGetDataConst(CANPacket), CANFDGetDataLength(CANPacket));
+}
+
+
+int8_t CANPollAndReceiveFD(CANHandle_t CANHandle, CANFDPacket_t *RxPacket) {
+    if (!CANHandle || !RxPacket) {
+        return -CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    if (!node->rxCount) {
+        return 0;
+    }
+    const CANSimFrame_t *frame = &node->rxQueue[node->rxHead];
+    node->rxHead = (node->rxHead + 1) % CAN_SIM_QUEUE_SIZE;
+    --node->rxCount;
+
+    CANFDSetPacketHeader(RxPacket, frame->identifier);
+    if (frame->length < 2) {
+        ++node->portStats.rxInvalid;
+        return -CAN_ERROR;
+    }
+    RxPacket->contentsLength = frame->length - 2;
+    memcpy(CANFDGetData(RxPacket), frame->data, frame->length);
+    ++node->portStats.framesReceived;
+    node->portStats.bitsReceived += CANFrameBits(frame->length);
+    return 1;
+}
+
+
+uint8_t CANConfigureFilters(CANHandle_t CANHandle, const CANFilterPlan_t *plan) {
+    if (!CANHandle || !plan) {
+        return CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    CANFilterBitmap(plan, node->filterBitmap);
+    node->filtered = true;
+    return CAN_OK;
+}
+
+
+CANTimestamp_t CANGetTimestamp(CANHandle_t CANHandle) {
+    if (!CANHandle) {
+        return 0;
+    }
+    return ((CANSimNode_t *)CANHandle)->bus->now;
+}
+
+
+uint32_t CANGetTimestampFrequency(CANHandle_t CANHandle) {
+    (void)CANHandle;
+    return 1000000000u;
+}
+
+
+uint8_t CANGetStats(CANHandle_t CANHandle, CANStats_t *stats) {
+    if (!CANHandle || !stats) {
+        return CAN_ERROR;
+    }
+
+    *stats = ((CANSimNode_t *)CANHandle)->portStats;
+    return CAN_OK;
+}
+
+uint8_t CANSetTxCompleteCallback(CANHandle_t CANHandle, CANTxCompleteCallback_t callback, void *context) {
+    if (!CANHandle) {
+        return CAN_ERROR;
+    }
+
+    CANSimNode_t *node = (CANSimNode_t *)CANHandle;
+    node->txCallback = callback;
+    node->txCallbackContext = context;
+    return CAN_OK;
+}
+
+#endif // defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SIM
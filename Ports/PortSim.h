@@ -0,0 +1,163 @@
+#pragma once
+
+/** This header declares the in-process virtual CAN bus used by the simulator port (PortSim.c).
+ * Compile with CHIP_TYPE=CHIP_TYPE_SIM to select it.
+ *
+ * Any number of simulated nodes share one CANSimBus_t. Each node is a CANSimNode_t and is passed
+ * to the functions in Port.h as its CANHandle_t:
+ *
+ *   CANSimBus_t bus;
+ *   CANSimBusInit(&bus, 1000000);
+ *   CANSimNode_t jetsonNode = {.bus = &bus};
+ *   CANInit(&jetsonNode, &jetson);
+ *
+ * Nothing moves on the bus until the simulation is advanced with CANSimBusStep or CANSimBusRunUntil.
+ * Pending frames arbitrate by their 11 bit identifier and each frame occupies the bus for its exact
+ * length in bits (including stuff bits and interframe space) at the configured bit rate.
+ * CAN26 identifiers name the receiver, not the sender, so two nodes can offer the same identifier at once.
+ * On a real bus both win arbitration and their data collides (a bit error, an error frame and a retry of both).
+ * The simulator does not model error frames: it counts the tie as a collision (see the collisions counters)
+ * and sends the frame of the node attached first, the other one competes again afterwards.
+ * Receivers apply the same acceptance rules that CANInit programs into the STM32 hardware filters.
+ * CAN FD frames switch to the bus's data bit rate for their data phase.
+ * Time is measured in nanoseconds of simulated time, which is also the clock of the receive timestamps.
+ * The CANSetTxCompleteCallback callback runs inside CANSimBusStep, and reports the start of frame as the sent time.
+ */
+
+#include "Port.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Maximum number of nodes attached to one bus
+ */
+#ifndef CAN_SIM_MAX_NODES
+#define CAN_SIM_MAX_NODES 32
+#endif
+
+/**
+ * Depth of each node's transmit and receive queues in frames
+ */
+#ifndef CAN_SIM_QUEUE_SIZE
+#define CAN_SIM_QUEUE_SIZE 64
+#endif
+
+typedef struct CANSimBus CANSimBus_t;
+
+/**
+ * A frame waiting in a node's queue
+ */
+typedef struct {
+    uint16_t identifier;
+    bool fd;
+    uint8_t length; // number of data bytes
+    uint8_t data[64];
+    uint64_t time;  // time of CANSend for queued transmissions, end of frame for receptions
+} CANSimFrame_t;
+
+/**
+ * Per node counters, cumulative since CANInit
+ */
+typedef struct {
+    uint64_t framesSent;
+    uint64_t framesReceived;
+    uint64_t txQueueOverflows;    // CANSend calls rejected because the transmit queue was full
+    uint64_t rxQueueOverflows;    // accepted frames dropped because the receive queue was full
+    uint64_t totalQueueingDelay;  // sum over sent frames of (start of transmission - CANSend)
+    uint64_t maxQueueingDelay;
+    uint64_t totalLatency;        // sum over sent frames of (end of frame - CANSend)
+    uint64_t maxLatency;
+    uint64_t collisions;          // arbitrations this node tied with another node offering the same identifier
+} CANSimNodeStats_t;
+
+/**
+ * A simulated node, used as the CANHandle_t of the port functions
+ * Only bus (and optionally idOrdered) is set by the user, the rest is managed by the port
+ */
+typedef struct {
+    CANSimBus_t *bus;
+    // false: the transmit queue behaves like the STM32 TX FIFO (oldest frame first)
+    // true: the lowest identifier in the queue competes first, like the FDCAN TX queue mode
+    bool idOrdered;
+
+    CANDevice_t device;
+    bool filtered; // set by CANConfigureFilters, filterBitmap then replaces the CANInit rules
+    uint32_t filterBitmap[CAN_FILTER_BITMAP_WORDS];
+    uint32_t txCount;
+    CANSimFrame_t txQueue[CAN_SIM_QUEUE_SIZE];
+    uint32_t rxHead;
+    uint32_t rxCount;
+    CANSimFrame_t rxQueue[CAN_SIM_QUEUE_SIZE];
+    CANSimNodeStats_t stats;
+    CANStats_t portStats; // the generic counters returned by CANGetStats
+    CANTxCompleteCallback_t txCallback;
+    void *txCallbackContext;
+} CANSimNode_t;
+
+/**
+ * The shared bus, all fields are read only for the user after CANSimBusInit
+ */
+struct CANSimBus {
+    uint32_t bitRate;
+    uint32_t dataBitRate; // CAN FD data phase bit rate, equal to bitRate unless changed after CANSimBusInit
+    uint64_t now;       // current simulated time
+    uint64_t busyTime;  // total time the bus carried frames
+    uint64_t frames;    // number of frames transmitted
+    uint64_t bits;      // number of bits transmitted, including stuff bits and interframe space
+    uint64_t stuffBits; // number of stuff bits transmitted
+    uint64_t collisions; // arbitrations won by more than one node, each a bus error on real hardware
+    uint32_t nodeCount;
+    CANSimNode_t *nodes[CAN_SIM_MAX_NODES];
+};
+
+/**
+ * Resets the bus to time 0 with no nodes attached
+ * @param bus Bus to initialize
+ * @param bitRate Nominal bit rate in bits per second, must not be 0 for CANInit to accept nodes on the bus
+ */
+void CANSimBusInit(CANSimBus_t *bus, uint32_t bitRate);
+
+/**
+ * Arbitrates between the pending frames and transmits the winner, advancing time to the end of that frame
+ * A tie on the identifier is counted as a collision and the node attached first transmits
+ * @return true if a frame was transmitted, false if no node had anything to send
+ */
+bool CANSimBusStep(CANSimBus_t *bus);
+
+/**
+ * Transmits every frame whose arbitration starts before the given time, then advances the clock to it
+ * @param bus Bus to run
+ * @param time Simulated time to run until (ns)
+ */
+void CANSimBusRunUntil(CANSimBus_t *bus, uint64_t time);
+
+/**
+ * Returns the fraction of time since CANSimBusInit that the bus was busy (0.0 - 1.0)
+ */
+float CANSimBusLoad(const CANSimBus_t *bus);
+
+/**
+ * Returns the exact number of bits a classic standard data frame occupies on the bus
+ * Counts SOF through EOF, every stuff bit and the 3 bit interframe space
+ * @param identifier 11 bit identifier
+ * @param data Frame data
+ * @param length Number of data bytes (0 - 8)
+ * @param stuffBits Set to the number of stuff bits contained in the result, may be NULL
+ */
+uint32_t CANSimFrameBits(uint16_t identifier, const uint8_t *data, uint8_t length, uint32_t *stuffBits);
+
+/**
+ * Returns the number of bits a CAN FD base format data frame occupies on the bus
+ * Counts dynamic stuff bits exactly and the fixed stuff bits of the CRC field
+ * The bits are split by the phase they are sent in, treating the BRS bit as the last nominal bit
+ * and the CRC delimiter as the first nominal bit again
+ * @param identifier 11 bit identifier
+ * @param data Frame data
+ * @param length Number of data bytes, must be a valid CAN FD length
+ * @param nominalBits Set to the number of bits sent at the nominal bit rate
+ * @param dataBits Set to the number of bits sent at the data bit rate
+ * @param stuffBits Set to the number of stuff bits (dynamic and fixed) in the frame, may be NULL
+ */
+void CANSimFDFrameBits(uint16_t identifier, const uint8_t *data, uint8_t length,
+                       uint32_t *nominalBits, uint32_t *dataBits, uint32_t *stuffBits);
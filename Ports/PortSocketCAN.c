@@ -0,0 +1,563 @@
+/**This module implements the generic port functions on top of Linux SocketCAN (raw sockets).
+ * It is intended for the Jetson and for testing on a development machine against vcan.
+ * Receives are batched through recvmmsg and sends through sendmmsg so that one syscall can
+ * move many frames. The acceptance filters installed by CANInit mirror the STM32 hardware filters.
+ */
+
+#define _GNU_SOURCE
+
+#include "Port.h"
+
+#if defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SOCKETCAN
+#include "PortSocketCAN.h"
+#include "../CANPacket.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+// Bit positions of specific address portions for filter detection
+#define PRIORITY_POS       10
+#define UUID_POS           3
+#define GROUP_MASK_POS     0
+
+// Extended and remote frames are never part of the CAN26 protocol, so every filter rejects them
+#define FILTER_FLAGS       (CAN_EFF_FLAG | CAN_RTR_FLAG)
+
+
+uint8_t CANInit(CANHandle_t CANHandle, CANDevice_t *CANDevice) {
+    if (!CANHandle || !CANDevice) {
+        return CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (!handle->interfaceName) {
+        return CAN_ERROR;
+    }
+    handle->rxCount = 0;
+    handle->rxIndex = 0;
+    handle->txKey = 0;
+    memset(&handle->stats, 0, sizeof(CANStats_t));
+
+    handle->socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (handle->socket < 0) {
+        return CAN_ERROR;
+    }
+
+    // Filter 0: Filters for only messages matching this devices UUID
+    // Filters 1-3: Filters for group broadcasts matching this device's declared domains
+    struct can_filter filters[4];
+    int filterCount = 0;
+    filters[filterCount].can_id = (CANDevice->deviceUUID << UUID_POS);
+    filters[filterCount].can_mask = (0x7F << UUID_POS) | FILTER_FLAGS;
+    ++filterCount;
+
+    if (CANDevice->peripheralDomain) {
+        filters[filterCount].can_id = (0x00 << UUID_POS) | 0x01;
+        filters[filterCount].can_mask = (0x7F << UUID_POS) | 0x01 | FILTER_FLAGS;
+        ++filterCount;
+    }
+
+    if (CANDevice->motorDomain) {
+        filters[filterCount].can_id = (0x00 << UUID_POS) | 0x02;
+        filters[filterCount].can_mask = (0x7F << UUID_POS) | 0x02 | FILTER_FLAGS;
+        ++filterCount;
+    }
+
+    if (CANDevice->powerDomain) {
+        filters[filterCount].can_id = (0x00 << UUID_POS) | 0x04;
+        filters[filterCount].can_mask = (0x7F << UUID_POS) | 0x04 | FILTER_FLAGS;
+        ++filterCount;
+    }
+
+    int receiveOwn = handle->receiveOwnMessages;
+    int fdFrames = handle->fdFrames;
+    int overflowCount = 1;
+    // Hardware timestamps would come from the controller's own clock, the software ones are moved to the clock of CANGetTimestamp
+    int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (handle->txEvents) {
+        // Only the time comes back on the error queue, the frame itself is remembered in txSlots
+        timestamping |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    }
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, handle->interfaceName, IFNAMSIZ - 1);
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+
+    if (setsockopt(handle->socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, filterCount * sizeof(struct can_filter)) < 0 ||
+        setsockopt(handle->socket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &receiveOwn, sizeof(receiveOwn)) < 0 ||
+        (fdFrames && setsockopt(handle->socket, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fdFrames, sizeof(fdFrames)) < 0) ||
+        setsockopt(handle->socket, SOL_SOCKET, SO_RXQ_OVFL, &overflowCount, sizeof(overflowCount)) < 0 ||
+        setsockopt(handle->socket, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping)) < 0 ||
+        ioctl(handle->socket, SIOCGIFINDEX, &ifr) < 0) {
+        CANSocketCANClose(handle);
+        return CAN_ERROR;
+    }
+
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(handle->socket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        CANSocketCANClose(handle);
+        return CAN_ERROR;
+    }
+    return CAN_OK;
+}
+
+
+void CANSocketCANClose(CANSocketCANHandle_t *handle) {
+    if (handle && handle->socket >= 0) {
+        close(handle->socket);
+        handle->socket = -1;
+    }
+}
+
+
+/**
+ * Returns the current time in ns of CLOCK_MONOTONIC
+ * Timeouts are computed on this clock, so it must not step with NTP like CLOCK_REALTIME does
+ */
+static CANTimestamp_t currentTimestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (CANTimestamp_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * Returns CLOCK_REALTIME - CLOCK_MONOTONIC in ns, for moving kernel software timestamps to CLOCK_MONOTONIC
+ * Sampled when the timestamps are read, so frames stamped before a clock step but read after it are off by the step
+ */
+static CANTimestamp_t realtimeOffset(void) {
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    CANTimestamp_t realtimeNanos = (CANTimestamp_t)realtime.tv_sec * 1000000000ull + realtime.tv_nsec;
+    return realtimeNanos - currentTimestamp();
+}
+
+/**
+ * Converts a kernel software timestamp, which is taken on CLOCK_REALTIME, to the clock of CANGetTimestamp
+ */
+static CANTimestamp_t kernelTimestamp(const struct timespec *time, CANTimestamp_t offset) {
+    return (CANTimestamp_t)time->tv_sec * 1000000000ull + time->tv_nsec - offset;
+}
+
+
+/**
+ * Remembers a frame accepted by the kernel until its transmit event arrives
+ */
+static void txRecord(CANSocketCANHandle_t *handle, uint16_t identifier, CANTimestamp_t queued) {
+    if (handle->txEvents) {
+        CANSocketCANTxSlot_t *slot = &handle->txSlots[handle->txKey++ % CAN_SOCKETCAN_TX_EVENT_SLOTS];
+        slot->identifier = identifier;
+        slot->queued = queued;
+    }
+}
+
+
+/**
+ * Drains the socket error queue, reporting each transmit timestamp to the callback
+ */
+static void harvestTxEvents(CANSocketCANHandle_t *handle) {
+    union {
+        char buffer[CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct sock_extended_err))];
+        struct cmsghdr align;
+    } control;
+    CANTimestamp_t offset = realtimeOffset();
+
+    for (;;) {
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        if (recvmsg(handle->socket, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+
+        CANTimestamp_t sent = 0;
+        const struct sock_extended_err *error = NULL;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+                struct scm_timestamping times;
+                memcpy(&times, CMSG_DATA(cmsg), sizeof(times));
+                sent = kernelTimestamp(&times.ts[0], offset);
+            } else if (cmsg->cmsg_level == SOL_CAN_RAW && cmsg->cmsg_type == SCM_CAN_RAW_ERRQUEUE) {
+                error = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+            }
+        }
+        if (!error || error->ee_origin != SO_EE_ORIGIN_TIMESTAMPING || !handle->txCallback) {
+            continue;
+        }
+        const CANSocketCANTxSlot_t *slot = &handle->txSlots[error->ee_data % CAN_SOCKETCAN_TX_EVENT_SLOTS];
+        CANTxEvent_t event = {
+            .identifier = slot->identifier,
+            .queued = slot->queued,
+            .sent = sent
+        };
+        handle->txCallback(handle, &event, handle->txCallbackContext);
+    }
+}
+
+
+/**
+ * Converts up to CAN_SOCKETCAN_TX_BATCH packets into frames and hands them to the kernel in one syscall
+ * Stops at the first packet whose length does not fit a classic frame
+ * Returns the number of frames accepted, or -1 if the socket reported an error before accepting any
+ */
+static int sendFrames(CANSocketCANHandle_t *handle, const CANPacket_t *packets, unsigned count) {
+    struct can_frame frames[CAN_SOCKETCAN_TX_BATCH];
+    struct iovec vectors[CAN_SOCKETCAN_TX_BATCH];
+    struct mmsghdr messages[CAN_SOCKETCAN_TX_BATCH];
+
+    if (count > CAN_SOCKETCAN_TX_BATCH) {
+        count = CAN_SOCKETCAN_TX_BATCH;
+    }
+    // Padding and the data past the DLC are copied to the kernel as they are
+    memset(frames, 0, count * sizeof(struct can_frame));
+    memset(messages, 0, count * sizeof(struct mmsghdr));
+    for (unsigned i = 0; i < count; ++i) {
+        uint8_t dlc = CANGetDlc(&packets[i]);
+        if (dlc < 2 || dlc > 8) {
+            count = i;
+            break;
+        }
+        frames[i].can_id = CANGetPacketHeader(&packets[i]);
+        frames[i].len = dlc;
+        memcpy(frames[i].data, CANGetDataConst(&packets[i]), dlc);
+
+        vectors[i].iov_base = &frames[i];
+        vectors[i].iov_len = sizeof(struct can_frame);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    CANTimestamp_t queued = handle->txEvents ? currentTimestamp() : 0;
+    int sent = sendmmsg(handle->socket, messages, count, MSG_DONTWAIT);
+    for (int i = 0; i < sent; ++i) {
+        ++handle->stats.framesSent;
+        handle->stats.bitsSent += CANFrameBits(frames[i].len);
+        txRecord(handle, (uint16_t)frames[i].can_id, queued);
+    }
+    return sent;
+}
+
+
+/**
+ * Refills the receive cache with as many frames as the kernel has queued, up to CAN_SOCKETCAN_RX_BATCH
+ * Returns the number of frames now cached, or -1 on a socket error
+ */
+static int receiveFrames(CANSocketCANHandle_t *handle) {
+    struct iovec vectors[CAN_SOCKETCAN_RX_BATCH];
+    struct mmsghdr messages[CAN_SOCKETCAN_RX_BATCH];
+    // Room for the SO_RXQ_OVFL drop counter and the SO_TIMESTAMPING times attached to each message
+    union {
+        char buffer[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct scm_timestamping))];
+        struct cmsghdr align;
+    } controls[CAN_SOCKETCAN_RX_BATCH];
+
+    if (handle->txEvents) {
+        harvestTxEvents(handle);
+    }
+
+    memset(messages, 0, sizeof(messages));
+    for (unsigned i = 0; i < CAN_SOCKETCAN_RX_BATCH; ++i) {
+        vectors[i].iov_base = &handle->rxFrames[i];
+        vectors[i].iov_len = sizeof(struct canfd_frame);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = controls[i].buffer;
+        messages[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+    }
+
+    handle->rxIndex = 0;
+    int received = recvmmsg(handle->socket, messages, CAN_SOCKETCAN_RX_BATCH, MSG_DONTWAIT, NULL);
+    if (received < 0) {
+        handle->rxCount = 0;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    handle->rxCount = (unsigned)received;
+
+    CANTimestamp_t offset = received ? realtimeOffset() : 0;
+    for (int i = 0; i < received; ++i) {
+        struct msghdr *message = &messages[i].msg_hdr;
+        handle->rxTimestamps[i] = 0;
+        for (struct cmsghdr *control = CMSG_FIRSTHDR(message); control; control = CMSG_NXTHDR(message, control)) {
+            if (control->cmsg_level != SOL_SOCKET) {
+                continue;
+            }
+            if (control->cmsg_type == SO_RXQ_OVFL) {
+                // Total number of frames dropped on this socket so far
+                memcpy(&handle->stats.rxOverflows, CMSG_DATA(control), sizeof(uint32_t));
+            } else if (control->cmsg_type == SO_TIMESTAMPING) {
+                struct scm_timestamping times;
+                memcpy(&times, CMSG_DATA(control), sizeof(times));
+                handle->rxTimestamps[i] = kernelTimestamp(&times.ts[0], offset);
+            }
+        }
+    }
+    return received;
+}
+
+
+uint8_t CANSend(CANHandle_t CANHandle, const CANPacket_t *CANPacket) {
+    if (!CANHandle || !CANPacket) {
+        return CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    int sent = sendFrames(handle, CANPacket, 1);
+    if (sent == 1) {
+        return CAN_OK;
+    }
+    ++handle->stats.txDropped;
+    return (sent < 0 && (errno == EAGAIN || errno == ENOBUFS)) ? CAN_BUSY : CAN_ERROR;
+}
+
+
+/**
+ * Parses a received frame into the packet
+ * Returns 1 on success, negative if the frame is not a valid CAN26 packet
+ */
+static int8_t parseFrame(CANStats_t *stats, const struct canfd_frame *frame, CANPacket_t *RxPacket) {
+    CANSetPacketHeader(RxPacket, frame->can_id & CAN_SFF_MASK);
+    uint8_t dlc = frame->len;
+    if (dlc < 2 || dlc > 8) {
+        ++stats->rxInvalid;
+        return -CAN_ERROR;
+    }
+    RxPacket->contentsLength = dlc - 2;
+    memcpy(CANGetData(RxPacket), frame->data, dlc);
+    ++stats->framesReceived;
+    stats->bitsReceived += CANFrameBits(dlc);
+    return 1;
+}
+
+
+int8_t CANPollAndReceive(CANHandle_t CANHandle, CANPacket_t *RxPacket) {
+    return CANPollAndReceiveTimestamped(CANHandle, RxPacket, NULL);
+}
+
+
+int8_t CANPollAndReceiveTimestamped(CANHandle_t CANHandle, CANPacket_t *RxPacket, CANTimestamp_t *timestamp) {
+    if (!CANHandle || !RxPacket) {
+        return -CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (handle->rxIndex >= handle->rxCount) {
+        int received = receiveFrames(handle);
+        if (received <= 0) {
+            return received < 0 ? -CAN_ERROR : 0;
+        }
+    }
+    if (timestamp) {
+        *timestamp = handle->rxTimestamps[handle->rxIndex];
+    }
+    return parseFrame(&handle->stats, &handle->rxFrames[handle->rxIndex++], RxPacket);
+}
+
+
+/**
+ * Parses a received classic or FD frame into the FD packet
+ * Returns 1 on success, negative if the frame is not a valid CAN26 packet
+ */
+static int8_t parseFDFrame(CANStats_t *stats, const struct canfd_frame *frame, CANFDPacket_t *RxPacket) {
+    CANFDSetPacketHeader(RxPacket, frame->can_id & CAN_SFF_MASK);
+    uint8_t length = frame->len;
+    if (length < 2 || length > CANFD_MAX_DLEN) {
+        ++stats->rxInvalid;
+        return -CAN_ERROR;
+    }
+    RxPacket->contentsLength = length - 2;
+    memcpy(CANFDGetData(RxPacket), frame->data, length);
+    ++stats->framesReceived;
+    stats->bitsReceived += CANFrameBits(length);
+    return 1;
+}
+
+
+uint16_t CANSendBatch(CANHandle_t CANHandle, const CANPacket_t *packets, uint16_t count) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    uint16_t sent = 0;
+    while (sent < count) {
+        unsigned chunk = count - sent;
+        int accepted = sendFrames(handle, packets + sent, chunk);
+        if (accepted <= 0) {
+            break;
+        }
+        sent += accepted;
+        if ((unsigned)accepted < chunk && accepted < CAN_SOCKETCAN_TX_BATCH) {
+            // The kernel queue is full
+            break;
+        }
+    }
+    handle->stats.txDropped += count - sent;
+    return sent;
+}
+
+
+uint16_t CANReceiveBatch(CANHandle_t CANHandle, CANPacket_t *packets, uint16_t maxCount) {
+    if (!CANHandle || !packets) {
+        return 0;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    uint16_t received = 0;
+    while (received < maxCount) {
+        if (handle->rxIndex >= handle->rxCount && receiveFrames(handle) <= 0) {
+            break;
+        }
+        while (handle->rxIndex < handle->rxCount && received < maxCount) {
+            if (parseFrame(&handle->stats, &handle->rxFrames[handle->rxIndex++], &packets[received]) > 0) {
+                ++received;
+            }
+        }
+    }
+    return received;
+}
+
+uint8_t CANSendFD(CANHandle_t CANHandle, const CANFDPacket_t *CANPacket) {
+    if (!CANHandle || !CANPacket) {
+        return CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (!handle->fdFrames) {
+        return CAN_ERROR;
+    }
+
+    struct canfd_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = CANFDGetPacketHeader(CANPacket);
+    frame.len = CANFDGetDataLength(CANPacket);
+    frame.flags = CANFD_BRS;
+    // Padding bytes come from the (zero initialized) unused contents of the packet
+    memcpy(frame.data, CANFDGetDataConst(CANPacket), frame.len);
+
+    CANTimestamp_t queued = handle->txEvents ? currentTimestamp() : 0;
+    if (send(handle->socket, &frame, sizeof(frame), MSG_DONTWAIT) == sizeof(frame)) {
+        ++handle->stats.framesSent;
+        handle->stats.bitsSent += CANFrameBits(frame.len);
+        txRecord(handle, (uint16_t)frame.can_id, queued);
+        return CAN_OK;
+    }
+    ++handle->stats.txDropped;
+    return (errno == EAGAIN || errno == ENOBUFS) ? CAN_BUSY : CAN_ERROR;
+}
+
+
+int8_t CANPollAndReceiveFD(CANHandle_t CANHandle, CANFDPacket_t *RxPacket) {
+    if (!CANHandle || !RxPacket) {
+        return -CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (handle->rxIndex >= handle->rxCount) {
+        int received = receiveFrames(handle);
+        if (received <= 0) {
+            return received < 0 ? -CAN_ERROR : 0;
+        }
+    }
+    return parseFDFrame(&handle->stats, &handle->rxFrames[handle->rxIndex++], RxPacket);
+}
+
+
+uint8_t CANConfigureFilters(CANHandle_t CANHandle, const CANFilterPlan_t *plan) {
+    if (!CANHandle || !plan) {
+        return CAN_ERROR;
+    }
+
+    // Raw socket filters are plain masks, so dual filters take two entries and ranges are split
+    // into aligned blocks, of which an 11 bit range needs at most 20
+    struct can_filter filters[CAN_FILTER_MAX_FILTERS * 20];
+    int filterCount = 0;
+    for (uint8_t i = 0; i < plan->count; ++i) {
+        const CANFilter_t *filter = &plan->filters[i];
+        switch (filter->type) {
+            case CAN_FILTER_MASK:
+                filters[filterCount].can_id = filter->id1;
+                filters[filterCount].can_mask = filter->id2 | FILTER_FLAGS;
+                ++filterCount;
+                break;
+            case CAN_FILTER_DUAL:
+                filters[filterCount].can_id = filter->id1;
+                filters[filterCount].can_mask = CAN_SFF_MASK | FILTER_FLAGS;
+                ++filterCount;
+                filters[filterCount].can_id = filter->id2;
+                filters[filterCount].can_mask = CAN_SFF_MASK | FILTER_FLAGS;
+                ++filterCount;
+                break;
+            case CAN_FILTER_RANGE:
+                for (uint32_t low = filter->id1; low <= filter->id2;) {
+                    uint32_t size = 1;
+                    while (!(low & size) && low + size * 2 - 1 <= filter->id2 && size < 0x800) {
+                        size *= 2;
+                    }
+                    filters[filterCount].can_id = low;
+                    filters[filterCount].can_mask = (CAN_SFF_MASK & ~(size - 1)) | FILTER_FLAGS;
+                    ++filterCount;
+                    low += size;
+                }
+                break;
+        }
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (setsockopt(handle->socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, filterCount * sizeof(struct can_filter)) < 0) {
+        return CAN_ERROR;
+    }
+    return CAN_OK;
+}
+
+
+CANTimestamp_t CANGetTimestamp(CANHandle_t CANHandle) {
+    (void)CANHandle;
+    return currentTimestamp();
+}
+
+
+uint32_t CANGetTimestampFrequency(CANHandle_t CANHandle) {
+    (void)CANHandle;
+    return 1000000000u;
+}
+
+
+uint8_t CANSetTxCompleteCallback(CANHandle_t CANHandle, CANTxCompleteCallback_t callback, void *context) {
+    if (!CANHandle) {
+        return CAN_ERROR;
+    }
+
+    CANSocketCANHandle_t *handle = (CANSocketCANHandle_t *)CANHandle;
+    if (!handle->txEvents) {
+        return CAN_ERROR;
+    }
+    handle->txCallback = callback;
+    handle->txCallbackContext = context;
+    return CAN_OK;
+}
+
+
+uint8_t CANGetStats(CANHandle_t CANHandle, CANStats_t *stats) {
+    if (!CANHandle || !stats) {
+        return CAN_ERROR;
+    }
+
+    *stats = ((CANSocketCANHandle_t *)CANHandle)->stats;
+    return CAN_OK;
+}
+
+#endif // defined(CHIP_TYPE) && CHIP_TYPE == CHIP_TYPE_SOCKETCAN
@@ -0,0 +1,88 @@
+#pragma once
+
+/** This header declares the handle used by the Linux SocketCAN port (PortSocketCAN.c).
+ * Compile with CHIP_TYPE=CHIP_TYPE_SOCKETCAN to select it.
+ *
+ * The CANHandle_t passed to the functions in Port.h must point to a CANSocketCANHandle_t
+ * whose interfaceName has been filled in, e.g.
+ *
+ *   CANSocketCANHandle_t jetsonCAN = {.interfaceName = "can0"};
+ *   CANInit(&jetsonCAN, &jetson);
+ *
+ * For testing without hardware, bind two handles to a virtual interface
+ * (ip link add dev vcan0 type vcan && ip link set up vcan0). Frames sent by one handle are
+ * looped back to every other socket on the interface, so both ends can live in one process.
+ * Setting receiveOwnMessages also loops a handle's own frames back to itself.
+ * Setting fdFrames enables CAN FD (CANSendFD/CANPollAndReceiveFD), the interface must have been
+ * configured for FD (e.g. ip link set can0 type can bitrate 1000000 dbitrate 5000000 fd on).
+ * Timestamps are in nanoseconds of CLOCK_MONOTONIC, so timeouts do not jump when NTP steps the wall clock.
+ * Receive timestamps are the kernel's software timestamps (SO_TIMESTAMPING), moved from CLOCK_REALTIME to it.
+ * Setting txEvents enables CANSetTxCompleteCallback: the kernel timestamps each frame when the driver hands it
+ * to the controller and queues the time on the socket error queue. The queue is drained, and the callback run,
+ * whenever one of the receive functions goes to the socket.
+ */
+
+#include "Port.h"
+
+#include <stdbool.h>
+#include <linux/can.h>
+
+/**
+ * Number of frames pulled from the kernel by a single recvmmsg call
+ * CANPollAndReceive hands them out one at a time before touching the socket again
+ */
+#ifndef CAN_SOCKETCAN_RX_BATCH
+#define CAN_SOCKETCAN_RX_BATCH 32
+#endif
+
+/**
+ * Maximum number of frames pushed to the kernel by a single sendmmsg call
+ */
+#ifndef CAN_SOCKETCAN_TX_BATCH
+#define CAN_SOCKETCAN_TX_BATCH 32
+#endif
+
+/**
+ * Number of sent frames whose send time is remembered for transmit events
+ * Must exceed the frames sent between two receive calls, or reported queued times will be wrong
+ */
+#ifndef CAN_SOCKETCAN_TX_EVENT_SLOTS
+#define CAN_SOCKETCAN_TX_EVENT_SLOTS 256
+#endif
+
+/**
+ * A frame waiting for its transmit event
+ */
+typedef struct {
+    uint16_t identifier;
+    CANTimestamp_t queued;
+} CANSocketCANTxSlot_t;
+
+typedef struct {
+    // Set by the user before CANInit
+    const char *interfaceName;
+    bool receiveOwnMessages;
+    bool fdFrames;
+    bool txEvents;
+
+    // Managed by the port
+    int socket;
+    unsigned rxCount;
+    unsigned rxIndex;
+    CANStats_t stats;
+    // Classic frames share the layout of the start of canfd_frame, so both kinds land in the same cache
+    struct canfd_frame rxFrames[CAN_SOCKETCAN_RX_BATCH];
+    // Kernel receive time of each cached frame in ns of CLOCK_MONOTONIC
+    CANTimestamp_t rxTimestamps[CAN_SOCKETCAN_RX_BATCH];
+    // Transmit events, the kernel numbers sent frames in order (SOF_TIMESTAMPING_OPT_ID) and txKey follows it
+    CANTxCompleteCallback_t txCallback;
+    void *txCallbackContext;
+    uint32_t txKey;
+    CANSocketCANTxSlot_t txSlots[CAN_SOCKETCAN_TX_EVENT_SLOTS];
+} CANSocketCANHandle_t;
+
+/**
+ * Closes the socket opened by CANInit
+ * @param handle SocketCAN handle previously passed to CANInit
+ */
+void CANSocketCANClose(CANSocketCANHandle_t *handle);
@@ -0,0 +1,123 @@
+#pragma once
+
+/** This header holds the timing shared by the benchmarks in this directory.
+ * Every benchmark runs its loop BENCH_RUNS times and reports the fastest run, see the Makefile for building them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_RUNS 200
+
+static inline uint64_t benchNanoseconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Cycle counter: the time stamp counter on x86, the DWT cycle counter on Cortex-M and the generic timer on AArch64,
+ * nanoseconds elsewhere. BENCH_CYCLES_UNIT names what it counts.
+ * The TSC and the generic timer tick at a fixed rate that differs from the core clock, so compare their numbers
+ * on the same machine only
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES_UNIT "cycles"
+
+static inline void benchCyclesInit(void) {}
+
+static inline uint64_t benchCycles(void) {
+    return __rdtsc();
+}
+#elif defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+#define BENCH_DEMCR      (*(volatile uint32_t *)0xE000EDFC)
+#define BENCH_DWT_CTRL   (*(volatile uint32_t *)0xE0001000)
+#define BENCH_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#define BENCH_CYCLES_UNIT "cycles"
+
+static inline void benchCyclesInit(void) {
+    // Trace enable, then start the counter
+    BENCH_DEMCR |= 1 << 24;
+    BENCH_DWT_CYCCNT = 0;
+    BENCH_DWT_CTRL |= 1;
+}
+
+/**
+ * 32 bits, so a measured run has to stay below 2^32 cycles (25 s at 170 MHz)
+ */
+static inline uint32_t benchCycles(void) {
+    return BENCH_DWT_CYCCNT;
+}
+#elif defined(__aarch64__)
+#define BENCH_CYCLES_UNIT "ticks"
+
+static inline void benchCyclesInit(void) {}
+
+/**
+ * Virtual count of the generic timer (CNTVCT_EL0), readable from user space, ticks at CNTFRQ_EL0
+ * The barrier keeps it from being read ahead of the measured code
+ */
+static inline uint64_t benchCycles(void) {
+    uint64_t count;
+    __asm__ volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(count) :: "memory");
+    return count;
+}
+#else
+#define BENCH_CYCLES_UNIT "ns"
+
+static inline void benchCyclesInit(void) {}
+
+static inline uint64_t benchCycles(void) {
+    return benchNanoseconds();
+}
+#endif
+
+/**
+ * Makes the compiler assume memory changed, so runs can not share work or be dropped
+ */
+#define BENCH_BARRIER() __asm__ volatile("" ::: "memory")
+
+/**
+ * Runs the statements BENCH_RUNS times and stores the fewest ticks of the clock function a run took in best
+ */
+#define BENCH_BEST(best, clock, ...) do { \
+    best = UINT64_MAX; \
+    for (int run = 0; run < BENCH_RUNS; ++run) { \
+        BENCH_BARRIER(); \
+        __typeof__(clock()) start = clock(); \
+        __VA_ARGS__ \
+        BENCH_BARRIER(); \
+        __typeof__(clock()) elapsed = clock() - start; \
+        if (elapsed < best) best = elapsed; \
+    } \
+} while (0)
+
+/**
+ * Runs the statements BENCH_RUNS times, they perform count operations,
+ * and prints the time per operation of the fastest run
+ */
+#define BENCH(name, count, ...) do { \
+    uint64_t best; \
+    BENCH_BEST(best, benchNanoseconds, __VA_ARGS__); \
+    printf("%-48s %8.2f ns/op\n", name, (double)best / (count)); \
+} while (0)
+
+/**
+ * Same as BENCH, the operations are packets and their rate is printed as well
+ */
+#define BENCH_PACKETS(name, count, ...) do { \
+    uint64_t best; \
+    BENCH_BEST(best, benchNanoseconds, __VA_ARGS__); \
+    printf("%-48s %8.2f ns/packet %12.0f packets/s\n", name, (double)best / (count), (count) * 1e9 / best); \
+} while (0)
+
+/**
+ * Same as BENCH in ticks of benchCycles
+ */
+#define BENCH_CYCLES(name, count, ...) do { \
+    uint64_t best; \
+    BENCH_BEST(best, benchCycles, __VA_ARGS__); \
+    printf("%-48s %8.1f " BENCH_CYCLES_UNIT "/op\n", name, (double)best / (count)); \
+} while (0)
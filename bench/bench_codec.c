@@ -0,0 +1,83 @@
+#include "Bench.h"
+#include "../CANPacket.h"
+
+#include <math.h>
+
+/**
+ * Time per value of every CANLoad and CANStore function and of the array functions
+ * Compare the builds with CAN_HEADER_ONLY and CAN_HARDWARE_FLOAT16 against the default one
+ */
+
+#define VALUES 4096
+
+// Magnitudes from subnormal to out of range with both signs, fractions in [0, 1) for the UNorm formats,
+// and integers using all bits
+static float values[VALUES];
+static float fractions[VALUES];
+static uint32_t integers[VALUES];
+
+// Outputs are not static, so the compiler has to produce them
+uint8_t data[VALUES * 4];
+float loadedValues[VALUES];
+uint32_t loadedIntegers[VALUES];
+
+/**
+ * Benchmarks CANStore and CANLoad of a format, storing INPUT and loading into OUTPUT
+ */
+#define BENCH_FORMAT(FORMAT, SIZE, INPUT, OUTPUT)            \
+    BENCH("CANStore" #FORMAT, VALUES,                       \
+        for (int i = 0; i < VALUES; ++i) {                  \
+            CANStore##FORMAT(data + (SIZE) * i, INPUT[i]);   \
+        }                                                   \
+    );                                                      \
+    BENCH("CANLoad" #FORMAT, VALUES,                        \
+        for (int i = 0; i < VALUES; ++i) {                  \
+            OUTPUT[i] = CANLoad##FORMAT(data + (SIZE) * i);  \
+        }                                                   \
+    );
+
+/**
+ * Benchmarks the array functions of a format on a packed array
+ */
+#define BENCH_ARRAY(FORMAT, SIZE, INPUT)                                 \
+    BENCH("CANStore" #FORMAT "Array", VALUES,                           \
+        CANStore##FORMAT##Array(data, SIZE, INPUT, VALUES);              \
+    );                                                                  \
+    BENCH("CANLoad" #FORMAT "Array", VALUES,                            \
+        CANLoad##FORMAT##Array(data, SIZE, loadedValues, VALUES);        \
+    );
+
+int main(void) {
+    for (int i = 0; i < VALUES; ++i) {
+        values[i] = ldexpf(1.0f + (i % 97) / 97.0f, i % 44 - 26) * (i & 1 ? -1 : 1);
+        integers[i] = i * 2654435761u;
+        fractions[i] = (integers[i] >> 8) / 16777216.0f;
+    }
+#if defined(CAN_HEADER_ONLY)
+    printf("CAN_HEADER_ONLY\n");
+#endif
+#if defined(CAN_HARDWARE_FLOAT16)
+    printf("CAN_HARDWARE_FLOAT16\n");
+#endif
+    BENCH_FORMAT(UInt32, 4, integers, loadedIntegers)
+    BENCH_FORMAT(Int32, 4, integers, loadedIntegers)
+    BENCH_FORMAT(UInt24, 3, integers, loadedIntegers)
+    BENCH_FORMAT(Int24, 3, integers, loadedIntegers)
+    BENCH_FORMAT(UInt16, 2, integers, loadedIntegers)
+    BENCH_FORMAT(Int16, 2, integers, loadedIntegers)
+    BENCH_FORMAT(Float32, 4, values, loadedValues)
+    BENCH_FORMAT(Float16, 2, values, loadedValues)
+    BENCH_FORMAT(BFloat24, 3, values, loadedValues)
+    BENCH_FORMAT(BFloat16, 2, values, loadedValues)
+    BENCH_FORMAT(UNorm24, 3, fractions, loadedValues)
+    BENCH_FORMAT(UNorm16, 2, fractions, loadedValues)
+    BENCH_FORMAT(UNorm8, 1, fractions, loadedValues)
+
+    BENCH_ARRAY(Float16, 2, values)
+    BENCH_ARRAY(BFloat24, 3, values)
+    BENCH_ARRAY(BFloat16, 2, values)
+    BENCH_ARRAY(UNorm24, 3, fractions)
+    BENCH_ARRAY(UNorm16, 2, fractions)
+    BENCH_ARRAY(UNorm8, 1, fractions)
+    return 0;
+}
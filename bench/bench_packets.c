@@ -0,0 +1,159 @@
+#include "Bench.h"
+#include "../Packets/Universal.h"
+#include "../Packets/DecodeUniversal.h"
+#include "../Packets/Motor.h"
+#include "../Packets/DecodeMotor.h"
+#include "../Packets/Peripheral.h"
+#include "../Packets/DecodePeripheral.h"
+#include "../Packets/Power.h"
+#include "../Packets/DecodePower.h"
+
+#include <string.h>
+
+/**
+ * Cycles per packet of building and decoding PowerStatus packets, and on the host time per packet and packets
+ * per second of every builder and decoder
+ * Compare a build with CAN_HEADER_ONLY against one without
+ * Runs on the host, and on a Cortex-M target when compiled with BENCH_TARGET and linked into a firmware image
+ * that retargets printf and calls benchPackets
+ */
+
+#define PACKETS 256
+
+static float values[PACKETS];
+static float fractions[PACKETS];
+static CANPacket_t packets[PACKETS];
+static const CANDevice_t sender = {.deviceUUID = 1};
+static const CANDevice_t device = {.powerDomain = 1, .deviceUUID = 0x30};
+// Outputs are not static, so the compiler has to produce them
+uint8_t frame[8];
+CANPowerPacket_PowerStatus_Decoded_t statuses[PACKETS];
+CANPacket_t built[PACKETS];
+#define BENCH_DECODED_MEMBER(NAME, COMMAND, KIND, FLAGS, TAIL) NAME##_Decoded_t NAME[PACKETS];
+union {
+    CAN_SCHEMA(BENCH_DECODED_MEMBER)
+} decoded;
+
+/**
+ * Stands in for the port, which copies the 8 data bytes into the frame it sends
+ */
+__attribute__((noinline)) static void sendPacket(const CANPacket_t *packet) {
+    memcpy(frame, &packet->command, sizeof(frame));
+    BENCH_BARRIER();
+}
+
+static void benchPowerStatus(void) {
+    BENCH_CYCLES("PowerStatus build and send", PACKETS,
+        for (int i = 0; i < PACKETS; ++i) {
+            CANPacket_t packet = CANPowerPacket_PowerStatus(sender, device, values[i] * 30, values[i],
+                                                            values[i] / 13, (uint8_t)(values[i] * 3));
+            sendPacket(&packet);
+        }
+    );
+    for (int i = 0; i < PACKETS; ++i) {
+        packets[i] = CANPowerPacket_PowerStatus(sender, device, values[i] * 30, values[i], values[i] / 13, 0);
+    }
+    BENCH_CYCLES("PowerStatus decode", PACKETS,
+        for (int i = 0; i < PACKETS; ++i) {
+            statuses[i] = CANPowerPacket_PowerStatus_Decode(&packets[i]);
+        }
+    );
+}
+
+#if !defined(BENCH_TARGET)
+
+// Arguments of the generated builders, made from fractions in the typical range of the format
+#define BENCH_VALUE_UInt8(x)    (uint8_t)((x) * 100)
+#define BENCH_VALUE_Int8(x)     (int8_t)((x) * 100)
+#define BENCH_VALUE_Bool(x)     ((x) > 0.5f)
+#define BENCH_VALUE_UInt16(x)   (uint16_t)((x) * 1000)
+#define BENCH_VALUE_Int16(x)    (int16_t)((x) * 1000)
+#define BENCH_VALUE_UInt32(x)   (uint32_t)((x) * 100000)
+#define BENCH_VALUE_Int32(x)    (int32_t)((x) * 100000)
+#define BENCH_VALUE_Float32(x)  ((x) * 100)
+#define BENCH_VALUE_Float16(x)  ((x) * 100)
+#define BENCH_VALUE_BFloat24(x) ((x) * 100)
+#define BENCH_VALUE_BFloat16(x) ((x) * 100)
+#define BENCH_VALUE_UNorm16(x)  (x)
+#define BENCH_VALUE_UNorm8(x)   (x)
+#define BENCH_ARGUMENT(NAME, FORMAT, FIELD) , BENCH_VALUE_##FORMAT(fractions[i])
+
+/**
+ * Benchmarks building PACKETS packets with the statement, which assigns built[i]
+ */
+#define BENCH_BUILD(NAME, ...)                                               \
+    BENCH_PACKETS(#NAME, PACKETS,                                            \
+        for (int i = 0; i < PACKETS; ++i) {                                  \
+            __VA_ARGS__;                                                     \
+        }                                                                    \
+    );
+
+#define BENCH_BUILDER(NAME) BENCH_BUILD(NAME, built[i] = NAME(sender, device NAME##_FIELDS(BENCH_ARGUMENT, NAME)))
+#define BENCH_BUILDER_AUTO(NAME)          BENCH_BUILDER(NAME)
+#define BENCH_BUILDER_CUSTOM_BUILD(NAME)
+#define BENCH_BUILDER_CUSTOM_DECODE(NAME) BENCH_BUILDER(NAME)
+#define BENCH_BUILDER_CUSTOM(NAME)
+#define BENCH_GENERATED_BUILDER(NAME, COMMAND, KIND, FLAGS, TAIL) BENCH_BUILDER_##KIND(NAME)
+
+#define BENCH_DECODER(NAME, COMMAND, KIND, FLAGS, TAIL)                      \
+    BENCH_PACKETS(#NAME "_Decode", PACKETS,                                  \
+        for (int i = 0; i < PACKETS; ++i) {                                  \
+            decoded.NAME[i] = NAME##_Decode(&packets[i]);                    \
+        }                                                                    \
+    );
+
+static void benchBuilders(void) {
+    static const uint8_t payload[6] = {1, 2, 3, 4, 5, 6};
+    CAN_SCHEMA(BENCH_GENERATED_BUILDER)
+    // Written by hand
+    BENCH_BUILD(CANUniversalPacket_FirmwareVersion,
+                built[i] = CANUniversalPacket_FirmwareVersion(sender, device, "rev", (uint16_t)i))
+    BENCH_BUILD(CANUniversalPacket_TransportFirst,
+                built[i] = CANUniversalPacket_TransportFirst(sender, device, (uint16_t)i, 7, payload))
+    BENCH_BUILD(CANUniversalPacket_TransportConsecutive,
+                built[i] = CANUniversalPacket_TransportConsecutive(sender, device, (uint8_t)i, payload, 5))
+    BENCH_BUILD(CANUniversalPacket_FirmwareData,
+                built[i] = CANUniversalPacket_FirmwareData(sender, device, payload, 6))
+    BENCH_BUILD(CANMotorPacket_BLDC_SetInputPosition,
+                built[i] = CANMotorPacket_BLDC_SetInputPosition(sender, device, fractions[i] * 100, fractions[i]))
+    BENCH_BUILD(CANPeripheralPacket_SetPWMDutyCycle,
+                built[i] = CANPeripheralPacket_SetPWMDutyCycle(sender, device, 1, fractions[i]))
+    BENCH_BUILD(CANPeripheralPacket_SetServoAngle,
+                built[i] = CANPeripheralPacket_SetServoAngle(sender, device, 1, (uint16_t)(fractions[i] * 180)))
+}
+
+static void benchDecoders(void) {
+    // Full packets with arbitrary contents, every decoder reads them
+    for (int i = 0; i < PACKETS; ++i) {
+        packets[i] = (CANPacket_t){.device = device, .contentsLength = 6, .senderUUID = 1};
+        for (int byte = 0; byte < 6; ++byte) {
+            packets[i].contents[byte] = (uint8_t)((i * 6 + byte) * 2654435761u >> 24);
+        }
+    }
+    CAN_SCHEMA(BENCH_DECODER)
+}
+
+#endif
+
+void benchPackets(void) {
+    benchCyclesInit();
+    for (int i = 0; i < PACKETS; ++i) {
+        values[i] = (i % 1000) * 0.013f;
+        fractions[i] = (i * 2654435761u >> 8) / 16777216.0f;
+    }
+#if defined(CAN_HEADER_ONLY)
+    printf("CAN_HEADER_ONLY\n");
+#endif
+    benchPowerStatus();
+#if !defined(BENCH_TARGET)
+    benchBuilders();
+    benchDecoders();
+#endif
+}
+
+#if !defined(BENCH_TARGET)
+int main(void) {
+    benchPackets();
+    return 0;
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+/** This header holds the checks shared by the host tests in this directory.
+ * Every test is its own program built against the simulator port, it prints each failed check
+ * and exits with 1 if there was any. See the Makefile for building and running them.
+ */
+
+#include <stdio.h>
+
+static int testFailures;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        ++testFailures; \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    } \
+} while (0)
+
+#define CHECK_EQUAL(actual, expected) do { \
+    long long actualValue = (long long)(actual); \
+    long long expectedValue = (long long)(expected); \
+    if (actualValue != expectedValue) { \
+        ++testFailures; \
+        printf("%s:%d: check failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+    } \
+} while (0)
+
+/**
+ * Prints the outcome of the test, returns the exit code of the test program
+ */
+static inline int testResult(const char *name) {
+    printf("%s: %s\n", name, testFailures ? "FAILED" : "passed");
+    return testFailures ? 1 : 0;
+}
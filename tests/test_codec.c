@@ -0,0 +1,265 @@
+#include "Test.h"
+#include "../CANPacket.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(CAN_HARDWARE_FLOAT16)
+#define TEST_NAME "test_codec (CAN_HARDWARE_FLOAT16)"
+#elif defined(CAN_HEADER_ONLY)
+#define TEST_NAME "test_codec (CAN_HEADER_ONLY)"
+#else
+#define TEST_NAME "test_codec"
+#endif
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    return bits;
+}
+
+static float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+static uint16_t storeFloat16(float value) {
+    uint8_t data[2];
+    CANStoreFloat16(data, value);
+    return data[0] | data[1] << 8;
+}
+
+static float loadFloat16(uint16_t half) {
+    uint8_t data[2] = {half & 0xFF, half >> 8};
+    return CANLoadFloat16(data);
+}
+
+/**
+ * Reference decoding of half precision floats, NaNs keep their sign and payload
+ */
+static uint32_t float16Reference(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint16_t exp = (half >> 10) & 0x1F;
+    uint16_t mantissa = half & 0x3FF;
+    if (exp == 0x1F) {
+        return sign | 0x7F800000 | (uint32_t)mantissa << 13;
+    }
+    float magnitude = exp ? ldexpf(mantissa | 0x400, exp - 25) : ldexpf(mantissa, -24);
+    return sign | floatBits(magnitude);
+}
+
+/**
+ * Every half precision code decodes exactly and stores back to itself, NaNs store as 0x7FFF
+ */
+static void testFloat16Codes(void) {
+    for (uint32_t half = 0; half <= 0xFFFF; ++half) {
+        float value = loadFloat16(half);
+        CHECK_EQUAL(floatBits(value), float16Reference(half));
+        bool nan = (half & 0x7FFF) > 0x7C00;
+        CHECK_EQUAL(storeFloat16(value), nan ? 0x7FFF : half);
+    }
+}
+
+/**
+ * Halfway between two neighbouring codes rounds away from 0, anything closer to one of them rounds to it
+ * The largest finite code rounds up to infinity
+ */
+static void testFloat16Rounding(void) {
+    for (uint32_t half = 0; half < 0xFC00; ++half) {
+        if ((half & 0x7FFF) >= 0x7C00) {
+            continue;
+        }
+        float low = loadFloat16(half);
+        float high = (half & 0x7FFF) == 0x7BFF ? copysignf(65536.0f, low) : loadFloat16(half + 1);
+        // Exact, both have at most 11 significant bits
+        float middle = (low + high) / 2;
+        float away = copysignf(INFINITY, low);
+        CHECK_EQUAL(storeFloat16(middle), half + 1);
+        CHECK_EQUAL(storeFloat16(nextafterf(middle, 0.0f)), half);
+        CHECK_EQUAL(storeFloat16(nextafterf(middle, away)), half + 1);
+    }
+    CHECK_EQUAL(storeFloat16(1e10f), 0x7C00);
+    CHECK_EQUAL(storeFloat16(-1e10f), 0xFC00);
+    CHECK_EQUAL(storeFloat16(ldexpf(1.0f, -26)), 0x0000);
+    CHECK_EQUAL(storeFloat16(-ldexpf(1.0f, -26)), 0x8000);
+    CHECK_EQUAL(storeFloat16(-NAN), 0x7FFF);
+}
+
+/**
+ * Every brain float code decodes to its upper bits and stores back to itself, the dropped half rounds away from 0
+ */
+static void testBFloat16Codes(void) {
+    for (uint32_t code = 0; code <= 0xFFFF; ++code) {
+        uint8_t data[2] = {code & 0xFF, code >> 8};
+        float value = CANLoadBFloat16(data);
+        CHECK_EQUAL(floatBits(value), code << 16);
+        CANStoreBFloat16(data, value);
+        CHECK_EQUAL(CANLoadUInt16(data), code);
+        CANStoreBFloat16(data, bitsFloat(code << 16 | 0x7FFF));
+        CHECK_EQUAL(CANLoadUInt16(data), code);
+        CANStoreBFloat16(data, bitsFloat(code << 16 | 0x8000));
+        CHECK_EQUAL(CANLoadUInt16(data), (code + 1) & 0xFFFF);
+    }
+}
+
+/**
+ * Every 24 bit code round trips through the 24 bit formats
+ */
+static void testDense24(void) {
+    uint8_t data[3];
+    for (uint32_t code = 0; code <= 0xFFFFFF; ++code) {
+        CANStoreUInt24(data, code);
+        CHECK_EQUAL(CANLoadUInt24(data), code);
+        int32_t signedCode = (int32_t)(code << 8) >> 8;
+        CANStoreInt24(data, signedCode);
+        CHECK_EQUAL(CANLoadInt24(data), signedCode);
+        CHECK_EQUAL(CANLoadUInt24(data), code);
+
+        float value = CANLoadBFloat24(data);
+        CHECK_EQUAL(floatBits(value), code << 8);
+        CANStoreBFloat24(data, value);
+        CHECK_EQUAL(CANLoadUInt24(data), code);
+
+        value = CANLoadUNorm24(data);
+        CHECK(value == (float)(code / 16777215.0));
+        CANStoreUNorm24(data, value);
+        CHECK_EQUAL(CANLoadUInt24(data), code);
+    }
+}
+
+/**
+ * Reference UNorm encoding, the product is exact in double precision
+ */
+static uint32_t unormReference(float value, uint32_t max) {
+    if (value >= 1.0f) {
+        return max;
+    }
+    if (!(value > 0.0f)) {
+        return 0;
+    }
+    return (uint32_t)floor((double)value * max + 0.5);
+}
+
+static uint32_t storeUNorm(float value, uint32_t max) {
+    uint8_t data[3] = {0};
+    if (max == 0xFF) {
+        CANStoreUNorm8(data, value);
+        return data[0];
+    } else if (max == 0xFFFF) {
+        CANStoreUNorm16(data, value);
+        return CANLoadUInt16(data);
+    }
+    CANStoreUNorm24(data, value);
+    return CANLoadUInt24(data);
+}
+
+/**
+ * Every 8 and 16 bit UNorm code round trips, values just below and above the midpoint between two codes
+ * round to the nearer one, and those and a sweep across all floats (including negative, out of range and NaN)
+ * match the reference for all three widths
+ */
+static void testUNorm(void) {
+    for (uint32_t code = 0; code <= 0xFFFF; ++code) {
+        uint8_t data[2] = {code & 0xFF, code >> 8};
+        float value = CANLoadUNorm16(data);
+        CHECK(value == (float)(code / 65535.0));
+        CHECK_EQUAL(storeUNorm(value, 0xFFFF), code);
+        if (code <= 0xFF) {
+            value = CANLoadUNorm8(data);
+            CHECK(value == (float)(code / 255.0));
+            CHECK_EQUAL(storeUNorm(value, 0xFF), code);
+        }
+    }
+    const uint32_t maxima[] = {0xFF, 0xFFFF, 0xFFFFFF};
+    for (int i = 0; i < 3; ++i) {
+        uint32_t max = maxima[i];
+        for (uint32_t code = 0; code < max; code += 1 + max / 0x10000) {
+            float middle = (float)((code + 0.5) / max);
+            float below = nextafterf(middle, 0.0f);
+            float above = nextafterf(middle, 1.0f);
+            CHECK_EQUAL(storeUNorm(below, max), unormReference(below, max));
+            CHECK_EQUAL(storeUNorm(middle, max), unormReference(middle, max));
+            CHECK_EQUAL(storeUNorm(above, max), unormReference(above, max));
+            // Floats are too coarse for this close to 1 with 24 bits
+            if (max <= 0xFFFF) {
+                CHECK_EQUAL(storeUNorm(below, max), code);
+                CHECK_EQUAL(storeUNorm(above, max), code + 1);
+            }
+        }
+    }
+    for (uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += 251) {
+        float value = bitsFloat((uint32_t)bits);
+        for (int i = 0; i < 3; ++i) {
+            CHECK_EQUAL(storeUNorm(value, maxima[i]), unormReference(value, maxima[i]));
+        }
+    }
+}
+
+#define ARRAY_VALUES 4099
+
+/**
+ * The array functions give the results of the scalar ones, packed and with a packet sized stride
+ */
+static void testArrays(void) {
+    static float values[ARRAY_VALUES];
+    static float loaded[ARRAY_VALUES];
+    static uint8_t encoded[ARRAY_VALUES * sizeof(CANPacket_t)];
+    // A sweep across all floats, and values around the midpoints between UNorm16 and UNorm8 codes
+    for (int i = 0; i < ARRAY_VALUES; ++i) {
+        float middle = (float)((i * 16 + 0.5) / (i % 4 == 3 ? 255 : 65535));
+        switch (i % 4) {
+            case 0: values[i] = bitsFloat((uint32_t)i * 4194301u); break;
+            case 1: values[i] = nextafterf(middle, 0.0f); break;
+            default: values[i] = middle; break;
+        }
+    }
+    values[0] = NAN;
+    values[1] = 1.0f;
+    values[2] = -0.0f;
+    const struct {
+        void (*store)(uint8_t *, float);
+        float (*load)(const uint8_t *);
+        void (*storeArray)(uint8_t *, size_t, const float *, size_t);
+        void (*loadArray)(const uint8_t *, size_t, float *, size_t);
+        size_t size;
+    } formats[] = {
+        {CANStoreFloat16, CANLoadFloat16, CANStoreFloat16Array, CANLoadFloat16Array, 2},
+        {CANStoreBFloat24, CANLoadBFloat24, CANStoreBFloat24Array, CANLoadBFloat24Array, 3},
+        {CANStoreBFloat16, CANLoadBFloat16, CANStoreBFloat16Array, CANLoadBFloat16Array, 2},
+        {CANStoreUNorm24, CANLoadUNorm24, CANStoreUNorm24Array, CANLoadUNorm24Array, 3},
+        {CANStoreUNorm16, CANLoadUNorm16, CANStoreUNorm16Array, CANLoadUNorm16Array, 2},
+        {CANStoreUNorm8, CANLoadUNorm8, CANStoreUNorm8Array, CANLoadUNorm8Array, 1},
+    };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        const size_t strides[] = {formats[f].size, sizeof(CANPacket_t)};
+        for (int s = 0; s < 2; ++s) {
+            size_t stride = strides[s];
+            formats[f].storeArray(encoded, stride, values, ARRAY_VALUES);
+            for (int i = 0; i < ARRAY_VALUES; ++i) {
+                uint8_t expected[3];
+                formats[f].store(expected, values[i]);
+                CHECK(memcmp(encoded + i * stride, expected, formats[f].size) == 0);
+            }
+            // Loads every code of the sweep, NaNs included
+            for (int i = 0; i < ARRAY_VALUES; ++i) {
+                uint32_t code = (uint32_t)i * 2654435761u;
+                memcpy(encoded + i * stride, &code, formats[f].size);
+            }
+            formats[f].loadArray(encoded, stride, loaded, ARRAY_VALUES);
+            for (int i = 0; i < ARRAY_VALUES; ++i) {
+                CHECK_EQUAL(floatBits(loaded[i]), floatBits(formats[f].load(encoded + i * stride)));
+            }
+        }
+    }
+}
+
+int main(void) {
+    testFloat16Codes();
+    testFloat16Rounding();
+    testBFloat16Codes();
+    testDense24();
+    testUNorm();
+    testArrays();
+    return testResult(TEST_NAME);
+}
@@ -0,0 +1,132 @@
+#include "Test.h"
+#include "../CANFilter.h"
+#include "../Ports/PortSim.h"
+
+#include <string.h>
+
+#define UUID_POS 3
+
+static uint32_t seed = 12345;
+
+static uint32_t randomNumber(void) {
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+}
+
+/**
+ * Reference matcher, the rules of a node with one of the subscribed devices after CANInit
+ */
+static bool referenceAccepts(const CANDevice_t *subscriptions, uint8_t count, uint16_t identifier) {
+    uint8_t uuid = (identifier >> UUID_POS) & 0x7F;
+    for (uint8_t i = 0; i < count; ++i) {
+        const CANDevice_t *device = &subscriptions[i];
+        bool anyDomain = device->peripheralDomain || device->motorDomain || device->powerDomain;
+        if ((device->deviceUUID || !anyDomain) && uuid == device->deviceUUID) {
+            return true;
+        }
+        if (uuid == 0 && ((device->peripheralDomain && (identifier & 0x01)) ||
+                          (device->motorDomain && (identifier & 0x02)) ||
+                          (device->powerDomain && (identifier & 0x04)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static CANDevice_t randomDevice(void) {
+    uint32_t bits = randomNumber();
+    return (CANDevice_t){
+        .peripheralDomain = bits & 1,
+        .motorDomain = (bits >> 1) & 1,
+        .powerDomain = (bits >> 2) & 1,
+        // Mostly nonzero UUIDs, clustered so that some of them merge
+        .deviceUUID = (bits >> 3) % 8 ? (bits >> 6) % 48 : 0
+    };
+}
+
+/**
+ * Every identifier in every plan against the reference: a plan never loses a subscribed identifier,
+ * an exact plan accepts nothing else, the budget holds and the bitmap agrees with the filters
+ */
+static void testPlans(void) {
+    CANDevice_t subscriptions[CAN_FILTER_MAX_SUBSCRIPTIONS];
+    uint32_t bitmap[CAN_FILTER_BITMAP_WORDS];
+    for (int round = 0; round < 200; ++round) {
+        uint8_t count = 1 + randomNumber() % CAN_FILTER_MAX_SUBSCRIPTIONS;
+        for (uint8_t i = 0; i < count; ++i) {
+            subscriptions[i] = randomDevice();
+        }
+        uint8_t maxFilters = 1 + randomNumber() % CAN_FILTER_MAX_FILTERS;
+        CANFilterPlan_t plan;
+        CHECK(CANFilterPlan(&plan, subscriptions, count, maxFilters));
+        CHECK(plan.count <= maxFilters);
+        CANFilterBitmap(&plan, bitmap);
+        for (uint16_t identifier = 0; identifier < 0x800; ++identifier) {
+            bool expected = referenceAccepts(subscriptions, count, identifier);
+            bool accepted = CANFilterAccepts(&plan, identifier);
+            CHECK(accepted || !expected);
+            CHECK(!plan.exact || accepted == expected);
+            CHECK_EQUAL(CANFilterBitmapAccepts(bitmap, identifier), accepted);
+        }
+    }
+}
+
+/**
+ * A node's own subscription and two peers fit the hardware exactly, a budget of one filter does not
+ */
+static void testBudget(void) {
+    CANDevice_t subscriptions[] = {
+        {.motorDomain = 1, .deviceUUID = 0x10},
+        {.deviceUUID = 0x11},
+        {.powerDomain = 1, .deviceUUID = 0x30}
+    };
+    CANFilterPlan_t plan;
+    CHECK(CANFilterPlan(&plan, subscriptions, 3, CAN_FILTER_MAX_FILTERS));
+    CHECK(plan.exact);
+    CHECK(CANFilterPlan(&plan, subscriptions, 3, 1));
+    CHECK_EQUAL(plan.count, 1);
+    CHECK(!plan.exact);
+    CHECK(!CANFilterPlan(&plan, subscriptions, 3, 0));
+    CHECK(!CANFilterPlan(&plan, subscriptions, CAN_FILTER_MAX_SUBSCRIPTIONS + 1, 1));
+}
+
+/**
+ * A simulated node with an installed plan receives exactly the identifiers the plan accepts
+ */
+static void testSimulatorFilters(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t host = {.deviceUUID = 0x01};
+    CANDevice_t device = {.motorDomain = 1, .deviceUUID = 0x10};
+    CANSimNode_t hostNode = {.bus = &bus};
+    CANSimNode_t deviceNode = {.bus = &bus};
+    CANInit(&hostNode, &host);
+    CANInit(&deviceNode, &device);
+
+    CANDevice_t subscriptions[] = {device, {.deviceUUID = 0x11}};
+    CANFilterPlan_t plan;
+    CHECK(CANFilterPlan(&plan, subscriptions, 2, 4));
+    CHECK_EQUAL(CANConfigureFilters(&deviceNode, &plan), CAN_OK);
+
+    int received = 0;
+    int expected = 0;
+    for (uint16_t identifier = 0; identifier < 0x800; identifier += 3) {
+        CANPacket_t packet = {0};
+        CANSetPacketHeader(&packet, identifier);
+        CHECK_EQUAL(CANSend(&hostNode, &packet), CAN_OK);
+        CANSimBusRunUntil(&bus, bus.now + 1000000);
+        expected += referenceAccepts(subscriptions, 2, identifier);
+        while (CANPollAndReceive(&deviceNode, &packet) > 0) {
+            CHECK(referenceAccepts(subscriptions, 2, CANGetPacketHeader(&packet)));
+            ++received;
+        }
+    }
+    CHECK_EQUAL(received, expected);
+}
+
+int main(void) {
+    testPlans();
+    testBudget();
+    testSimulatorFilters();
+    return testResult("test_filter");
+}
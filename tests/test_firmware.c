@@ -0,0 +1,174 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANFirmware.h"
+#include "../Ports/PortSim.h"
+
+#include <string.h>
+
+#define IMAGE_SIZE 10000
+#define IMAGE_BLOCKS ((IMAGE_SIZE + CAN_FIRMWARE_BLOCK_SIZE - 1) / CAN_FIRMWARE_BLOCK_SIZE)
+
+static CANSimBus_t bus;
+static CANSimNode_t hostNode;
+static CANSimNode_t deviceNode;
+static CANDevice_t host = {.deviceUUID = CAN_UUID_JETSON};
+static CANDevice_t device = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+static CANFirmwareStreamer_t streamer;
+static CANFirmwareReceiver_t receiver;
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t flash[IMAGE_BLOCKS * CAN_FIRMWARE_BLOCK_SIZE];
+static int flashWrites;
+static int dataFrames;
+static int dropFrame;
+static int commitFrames;
+static int dropCommit;
+static int streamStatus;
+
+static uint8_t writeFlash(void *context, uint32_t offset, const uint8_t *data, uint32_t length) {
+    (void)context;
+    ++flashWrites;
+    memcpy(flash + offset, data, length);
+    return CAN_OK;
+}
+
+static void onStreamDone(uint8_t status, void *context) {
+    (void)context;
+    streamStatus = status;
+}
+
+/**
+ * Runs host and device for a while, the device drops its data frame number dropFrame and its commit frame
+ * number dropCommit (counted from 1)
+ * pollHost false stops the host, as if it was interrupted
+ */
+static void run(uint64_t duration, bool pollHost) {
+    for (uint64_t end = bus.now + duration; bus.now < end;) {
+        CANSimBusRunUntil(&bus, bus.now + 20000);
+        CANPacket_t packet;
+        while (CANPollAndReceive(&hostNode, &packet) > 0) {
+            CANFirmwareStreamHandlePacket(&streamer, &packet);
+        }
+        while (CANPollAndReceive(&deviceNode, &packet) > 0) {
+            if ((packet.command & 0x7F) == CAN_COMMAND_ID__FIRMWARE_DATA && ++dataFrames == dropFrame) {
+                continue;
+            }
+            if ((packet.command & 0x7F) == CAN_COMMAND_ID__FIRMWARE_COMMIT && ++commitFrames == dropCommit) {
+                continue;
+            }
+            CANFirmwareReceiverHandlePacket(&receiver, &packet);
+            CHECK(receiver.received <= CAN_FIRMWARE_BLOCK_SIZE);
+        }
+        CANFirmwareReceiverPoll(&receiver);
+        if (pollHost) {
+            CANFirmwareStreamPoll(&streamer);
+        }
+    }
+}
+
+static void reset(void) {
+    CANSimBusInit(&bus, 1000000);
+    hostNode = (CANSimNode_t){.bus = &bus};
+    deviceNode = (CANSimNode_t){.bus = &bus};
+    CANInit(&hostNode, &host);
+    CANInit(&deviceNode, &device);
+    CANFirmwareReceiverInit(&receiver, &deviceNode, device, (CANFirmwareFlash_t){.write = writeFlash}, sizeof(flash));
+    memset(flash, 0, sizeof(flash));
+    flashWrites = 0;
+    dataFrames = 0;
+    dropFrame = 0;
+    commitFrames = 0;
+    dropCommit = 0;
+    streamStatus = -1;
+}
+
+static void testCRC(void) {
+    // Check value of CRC-32, continued across two calls
+    const uint8_t *check = (const uint8_t *)"123456789";
+    CHECK_EQUAL(CANFirmwareCRC(CANFirmwareCRC(0, check, 4), check + 4, 5), 0xCBF43926);
+}
+
+/**
+ * A frame dropped in block 2 fails that block's commit, the host restarts and the device answers with
+ * the blocks it already flashed, so the update continues from there and every block is written once
+ */
+static void testDroppedFrame(void) {
+    reset();
+    dropFrame = 2 * CAN_FIRMWARE_BLOCK_SIZE / CAN_FIRMWARE_DATA_LEN + 100;
+    CANFirmwareStreamStart(&streamer, &hostNode, host, device, image, IMAGE_SIZE, 0x1234, 50000, onStreamDone, NULL);
+    run(2000000000, true);
+
+    CHECK_EQUAL(streamStatus, CAN_OK);
+    CHECK(CANFirmwareReceiverComplete(&receiver));
+    CHECK(memcmp(flash, image, IMAGE_SIZE) == 0);
+    CHECK_EQUAL(receiver.badBlocks, 1);
+    CHECK_EQUAL(streamer.resumes, 1);
+    CHECK_EQUAL(flashWrites, IMAGE_BLOCKS);
+}
+
+/**
+ * Without the commit of a block, the data of the next one overruns it, the device rejects the block right away
+ * instead of writing past its buffer, and the update resumes
+ * Both buffers are tried, the first one while the second holds a verified block
+ */
+static void testDroppedCommit(void) {
+    for (int commit = 1; commit <= CAN_FIRMWARE_WINDOW + 1; ++commit) {
+        reset();
+        dropCommit = commit;
+        CANFirmwareStreamStart(&streamer, &hostNode, host, device, image, IMAGE_SIZE, 0x1234, 50000, onStreamDone, NULL);
+        run(2000000000, true);
+
+        CHECK_EQUAL(streamStatus, CAN_OK);
+        CHECK(memcmp(flash, image, IMAGE_SIZE) == 0);
+        CHECK_EQUAL(receiver.badBlocks, 1);
+        CHECK_EQUAL(streamer.resumes, 1);
+        CHECK_EQUAL(flashWrites, IMAGE_BLOCKS);
+    }
+}
+
+/**
+ * A new streamer for the same image picks up where an interrupted one stopped
+ */
+static void testResume(void) {
+    reset();
+    CANFirmwareStreamStart(&streamer, &hostNode, host, device, image, IMAGE_SIZE, 0x1235, 50000, onStreamDone, NULL);
+    run(50000000, true);
+    run(100000000, false);
+    uint32_t flashed = receiver.flashed;
+    CHECK(flashed > 0 && flashed < IMAGE_SIZE);
+    CHECK_EQUAL(flashed % CAN_FIRMWARE_BLOCK_SIZE, 0);
+
+    CANFirmwareStreamStart(&streamer, &hostNode, host, device, image, IMAGE_SIZE, 0x1235, 50000, onStreamDone, NULL);
+    run(2000000000, true);
+    CHECK_EQUAL(streamStatus, CAN_OK);
+    CHECK(memcmp(flash, image, IMAGE_SIZE) == 0);
+    CHECK_EQUAL(flashWrites, IMAGE_BLOCKS);
+
+    // A different image starts over
+    image[0] ^= 1;
+    CANFirmwareStreamStart(&streamer, &hostNode, host, device, image, IMAGE_SIZE, 0x1236, 50000, onStreamDone, NULL);
+    run(2000000000, true);
+    CHECK_EQUAL(streamStatus, CAN_OK);
+    CHECK(memcmp(flash, image, IMAGE_SIZE) == 0);
+    CHECK_EQUAL(flashWrites, 2 * IMAGE_BLOCKS);
+}
+
+static void testNoDevice(void) {
+    reset();
+    CANDevice_t absent = {.deviceUUID = CAN_UUID_BLDC_SHOULDER};
+    CANFirmwareStreamStart(&streamer, &hostNode, host, absent, image, IMAGE_SIZE, 0x1237, 5000, onStreamDone, NULL);
+    run(100000000, true);
+    CHECK_EQUAL(streamStatus, CAN_TIMEOUT);
+}
+
+int main(void) {
+    for (int i = 0; i < IMAGE_SIZE; ++i) {
+        image[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+    testCRC();
+    testDroppedFrame();
+    testDroppedCommit();
+    testResume();
+    testNoDevice();
+    return testResult("test_firmware");
+}
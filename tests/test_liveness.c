@@ -0,0 +1,46 @@
+#include "Test.h"
+#include "../CANLiveness.h"
+#include "../Ports/PortSim.h"
+
+static CANLivenessMonitor_t monitor;
+static int lostEvents;
+
+/**
+ * Unwatches the other device on the first loss, both share a wheel slot
+ */
+static void unwatchOther(CANDeviceUUID_t device, uint8_t event, const CANLivenessStatus_t *status, void *context) {
+    (void)status;
+    (void)context;
+    if (event == CAN_LIVENESS_EVENT_LOST && lostEvents++ == 0) {
+        CANLivenessUnwatch(&monitor, device == CAN_UUID_BLDC_BASE ? CAN_UUID_BLDC_SHOULDER : CAN_UUID_BLDC_BASE);
+    }
+}
+
+/**
+ * A callback unwatching the device that follows it in the slot must not get that device reported
+ */
+static void testUnwatchFromCallback(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+    CANSimNode_t node = {.bus = &bus};
+    CHECK_EQUAL(CANInit(&node, &jetson), CAN_OK);
+
+    CANLivenessInit(&monitor, &node, 1000);
+    CANLivenessSetCallback(&monitor, unwatchOther, NULL);
+    CHECK(CANLivenessWatch(&monitor, CAN_UUID_BLDC_BASE, 10000));
+    CHECK(CANLivenessWatch(&monitor, CAN_UUID_BLDC_SHOULDER, 10000));
+
+    CANSimBusRunUntil(&bus, 20000000);
+    CHECK_EQUAL(CANLivenessTick(&monitor), 1);
+    CHECK_EQUAL(lostEvents, 1);
+    uint8_t base = CANLivenessGet(&monitor, CAN_UUID_BLDC_BASE)->liveness;
+    uint8_t shoulder = CANLivenessGet(&monitor, CAN_UUID_BLDC_SHOULDER)->liveness;
+    CHECK((base == CAN_LIVENESS_LOST && shoulder == CAN_LIVENESS_UNWATCHED) ||
+          (base == CAN_LIVENESS_UNWATCHED && shoulder == CAN_LIVENESS_LOST));
+}
+
+int main(void) {
+    testUnwatchFromCallback();
+    return testResult("test_liveness");
+}
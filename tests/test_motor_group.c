@@ -0,0 +1,112 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANMotorGroup.h"
+#include "../Ports/PortSim.h"
+#include "../Packets/DecodeMotor.h"
+
+#define TIRES 4
+#define TIRE_GROUP 1
+#define ARM_GROUP 2
+
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+
+/**
+ * The four tires latch their setpoints and apply them on the trigger, which follows the setpoints
+ * in the same burst with no idle bus time in between, so every tire applies at the same instant
+ */
+static void testBurstAndTrigger(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANSimNode_t host = {.bus = &bus};
+    CANInit(&host, &jetson);
+
+    CANDevice_t devices[TIRES + 1];
+    CANSimNode_t nodes[TIRES + 1];
+    CANMotorLatch_t latches[TIRES + 1];
+    CANMotorSetpoint_t setpoints[TIRES];
+    for (int i = 0; i <= TIRES; ++i) {
+        devices[i] = (CANDevice_t){.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_FRONT_TIRE_LEFT + i};
+        nodes[i] = (CANSimNode_t){.bus = &bus};
+        CANInit(&nodes[i], &devices[i]);
+        // The fifth device is an arm joint in another group, it stays staged
+        CANMotorLatchInit(&latches[i], i < TIRES ? TIRE_GROUP : ARM_GROUP);
+        if (i < TIRES) {
+            setpoints[i] = (CANMotorSetpoint_t){devices[i], 1.5f * (i + 1), 0.25f};
+        }
+    }
+    CANPacket_t armSetpoint = CANMotorPacket_BLDC_SetInputVelocity(jetson, devices[TIRES], 9.0f, 0.0f);
+    CHECK_EQUAL(CANSend(&host, &armSetpoint), CAN_OK);
+    CANSimBusRunUntil(&bus, 1000000);
+    uint64_t burstStart = bus.now;
+    uint64_t busyBefore = bus.busyTime;
+    uint64_t framesBefore = bus.frames;
+
+    CHECK_EQUAL(CANMotorGroupSendVelocity(&host, jetson, setpoints, TIRES, TIRE_GROUP), TIRES);
+    CANSimBusRunUntil(&bus, 2000000);
+    CHECK_EQUAL(bus.frames - framesBefore, TIRES + 1);
+
+    for (int i = 0; i <= TIRES; ++i) {
+        CANPacket_t packet;
+        CANTimestamp_t timestamp;
+        int applied = 0;
+        while (CANPollAndReceiveTimestamped(&nodes[i], &packet, &timestamp) > 0) {
+            if (!CANMotorLatchReceive(&latches[i], &packet, &packet)) {
+                continue;
+            }
+            ++applied;
+            CHECK_EQUAL(packet.command & 0x7F, CAN_COMMAND_ID__BLDC_INPUT_VELOCITY);
+            CANMotorPacket_BLDC_SetInputVelocity_Decoded_t setpoint = CANMotorPacket_BLDC_SetInputVelocity_Decode(&packet);
+            CHECK(setpoint.velocity == setpoints[i].setpoint);
+            CHECK(setpoint.feedForwardTorque == setpoints[i].feedForward);
+            // Applied at the end of the trigger, the last frame of a burst that kept the bus busy throughout
+            CHECK_EQUAL(timestamp, burstStart + bus.busyTime - busyBefore);
+        }
+        CHECK_EQUAL(applied, i < TIRES ? 1 : 0);
+        CHECK_EQUAL(latches[i].staged, i == TIRES);
+    }
+}
+
+/**
+ * A full chunk of setpoints sends the trigger in a chunk of its own, still behind the last setpoint
+ */
+static void testFullChunk(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANSimNode_t host = {.bus = &bus};
+    CANInit(&host, &jetson);
+    CANDevice_t last = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE + CAN_MOTOR_GROUP_BATCH - 1};
+    CANSimNode_t lastNode = {.bus = &bus};
+    CANInit(&lastNode, &last);
+    CANMotorLatch_t latch;
+    CANMotorLatchInit(&latch, ARM_GROUP);
+
+    CANMotorSetpoint_t setpoints[CAN_MOTOR_GROUP_BATCH];
+    for (int i = 0; i < CAN_MOTOR_GROUP_BATCH; ++i) {
+        setpoints[i] = (CANMotorSetpoint_t){{.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE + i}, (float)i, 0.0f};
+    }
+    CHECK_EQUAL(CANMotorGroupSendPosition(&host, jetson, setpoints, CAN_MOTOR_GROUP_BATCH, ARM_GROUP), CAN_MOTOR_GROUP_BATCH);
+    CANSimBusRunUntil(&bus, 10000000);
+    CHECK_EQUAL(bus.frames, CAN_MOTOR_GROUP_BATCH + 1);
+
+    CANPacket_t packet;
+    int applied = 0;
+    while (CANPollAndReceive(&lastNode, &packet) > 0) {
+        if (CANMotorLatchReceive(&latch, &packet, &packet)) {
+            ++applied;
+            CHECK_EQUAL(packet.command & 0x7F, CAN_COMMAND_ID__BLDC_INPUT_POSITION);
+        }
+    }
+    CHECK_EQUAL(applied, 1);
+    CHECK_EQUAL(latch.applied, 1);
+
+    // Without a trigger only the setpoints go out
+    CHECK_EQUAL(CANMotorGroupSendPosition(&host, jetson, setpoints, 2, CAN_MOTOR_GROUP_NO_APPLY), 2);
+    CANSimBusRunUntil(&bus, 20000000);
+    CHECK_EQUAL(bus.frames, CAN_MOTOR_GROUP_BATCH + 3);
+}
+
+int main(void) {
+    testBurstAndTrigger();
+    testFullChunk();
+    return testResult("test_motor_group");
+}
@@ -0,0 +1,173 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANParameters.h"
+#include "../Ports/PortSim.h"
+
+#include <string.h>
+
+#define PARAMETERS 20
+#define MAX_IN_FLIGHT 4
+#define CLAMPED_ENDPOINT 0x0105 // the device stores at most CLAMP here
+#define CLAMP 50
+#define SILENT_ENDPOINT 0x0109  // the device never answers reads of it
+
+static CANSimBus_t bus;
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+static CANDevice_t bldc = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+static CANSimNode_t hostNode;
+static CANSimNode_t deviceNode;
+static CANRequestTracker_t tracker;
+static uint32_t registers[0x200];
+static int writes[0x200];
+
+/**
+ * The device side of an ODrive: stores direct writes and answers direct reads
+ */
+static void serveDevice(void) {
+    CANPacket_t packet;
+    while (CANPollAndReceive(&deviceNode, &packet) > 0) {
+        switch (packet.command & 0x7F) {
+            case CAN_COMMAND_ID__BLDC_DIRECT_WRITE: {
+                CANMotorPacket_BLDC_DirectWrite_Decoded_t write = CANMotorPacket_BLDC_DirectWrite_Decode(&packet);
+                registers[write.endpointID] = write.endpointID == CLAMPED_ENDPOINT && write.value > CLAMP ? CLAMP : write.value;
+                ++writes[write.endpointID];
+                break;
+            }
+            case CAN_COMMAND_ID__BLDC_DIRECT_READ: {
+                CANMotorPacket_BLDC_DirectRead_Decoded_t read = CANMotorPacket_BLDC_DirectRead_Decode(&packet);
+                if (read.endpointID == SILENT_ENDPOINT) {
+                    break;
+                }
+                CANPacket_t result = CANMotorPacket_BLDC_DirectReadResult(bldc, jetson, read.endpointID,
+                                                                          registers[read.endpointID]);
+                CHECK_EQUAL(CANSend(&deviceNode, &result), CAN_OK);
+                break;
+            }
+        }
+    }
+}
+
+static void setup(void) {
+    CANSimBusInit(&bus, 1000000);
+    hostNode = (CANSimNode_t){.bus = &bus};
+    deviceNode = (CANSimNode_t){.bus = &bus};
+    CANInit(&hostNode, &jetson);
+    CANInit(&deviceNode, &bldc);
+    CANRequestInit(&tracker, &hostNode);
+    memset(registers, 0, sizeof(registers));
+    memset(writes, 0, sizeof(writes));
+}
+
+/**
+ * Fills the host's transmit queue until only the given number of frames fit, with frames nobody listens to
+ */
+static void fillQueue(uint32_t room) {
+    CANPacket_t filler = {0};
+    CANSetPacketHeader(&filler, 0x7F << 3);
+    while (hostNode.txCount < CAN_SIM_QUEUE_SIZE - room) {
+        CHECK_EQUAL(CANSend(&hostNode, &filler), CAN_OK);
+    }
+}
+
+/**
+ * Polls the batch every 100 us of simulated time until it finishes, at most for a simulated second
+ */
+static void runBatch(CANParameterBatch_t *batch) {
+    for (int tick = 0; tick < 10000 && !CANParameterPoll(batch); ++tick) {
+        CHECK(batch->inFlight <= MAX_IN_FLIGHT);
+        CANSimBusRunUntil(&bus, bus.now + 100000);
+        serveDevice();
+        CANPacket_t packet;
+        while (CANPollAndReceive(&hostNode, &packet) > 0) {
+            CANRequestHandleResponse(&tracker, &packet);
+        }
+        CANRequestPoll(&tracker);
+    }
+    CHECK(CANParameterPoll(batch));
+}
+
+/**
+ * Every parameter is written once and read back, the clamped one reports the mismatch with the value
+ * the device kept and the unanswered one times out
+ */
+static void testWriteReadBack(void) {
+    setup();
+    CANParameter_t parameters[PARAMETERS];
+    for (int i = 0; i < PARAMETERS; ++i) {
+        parameters[i] = (CANParameter_t){.endpointID = 0x0100 + i, .value = 100 + i};
+    }
+    CANParameterBatch_t batch;
+    CANParameterWriteStart(&batch, &tracker, jetson, bldc, parameters, PARAMETERS, MAX_IN_FLIGHT, 5000);
+    runBatch(&batch);
+
+    CHECK_EQUAL(batch.succeeded, PARAMETERS - 2);
+    CHECK_EQUAL(batch.failed, 2);
+    for (int i = 0; i < PARAMETERS; ++i) {
+        CHECK_EQUAL(writes[parameters[i].endpointID], 1);
+        if (parameters[i].endpointID == CLAMPED_ENDPOINT) {
+            CHECK_EQUAL(parameters[i].status, CAN_ERROR);
+            CHECK_EQUAL(parameters[i].value, CLAMP);
+        } else if (parameters[i].endpointID == SILENT_ENDPOINT) {
+            CHECK_EQUAL(parameters[i].status, CAN_TIMEOUT);
+        } else {
+            CHECK_EQUAL(parameters[i].status, CAN_OK);
+            CHECK_EQUAL(parameters[i].value, 100 + i);
+        }
+    }
+    CHECK_EQUAL(tracker.pending, 0);
+}
+
+/**
+ * A full port makes the batch wait instead of failing parameters, and a read that did not fit
+ * behind its write is retried without writing again
+ */
+static void testBusyRetry(void) {
+    setup();
+    CANParameter_t parameters[PARAMETERS];
+    for (int i = 0; i < PARAMETERS; ++i) {
+        parameters[i] = (CANParameter_t){.endpointID = 0x0110 + i, .value = 7 * i};
+    }
+    CANParameterBatch_t batch;
+    // The timeout covers the wait behind a full queue
+    CANParameterWriteStart(&batch, &tracker, jetson, bldc, parameters, PARAMETERS, MAX_IN_FLIGHT, 50000);
+
+    fillQueue(0);
+    CHECK(!CANParameterPoll(&batch));
+    CHECK_EQUAL(batch.next, 0);
+    CHECK(!batch.nextWritten);
+    CHECK_EQUAL(batch.failed, 0);
+
+    // Room for the write of the first parameter but not for its read
+    CANSimBusStep(&bus);
+    CHECK(!CANParameterPoll(&batch));
+    CHECK_EQUAL(batch.next, 0);
+    CHECK(batch.nextWritten);
+    CHECK_EQUAL(batch.inFlight, 0);
+    CHECK_EQUAL(tracker.pending, 0);
+
+    runBatch(&batch);
+    CHECK_EQUAL(batch.succeeded, PARAMETERS);
+    CHECK_EQUAL(batch.failed, 0);
+    for (int i = 0; i < PARAMETERS; ++i) {
+        CHECK_EQUAL(writes[parameters[i].endpointID], 1);
+        CHECK_EQUAL(parameters[i].status, CAN_OK);
+    }
+
+    // Reading them back afterwards returns the values written
+    for (int i = 0; i < PARAMETERS; ++i) {
+        parameters[i].value = 0;
+    }
+    fillQueue(1);
+    CANParameterReadStart(&batch, &tracker, jetson, bldc, parameters, PARAMETERS, MAX_IN_FLIGHT, 50000);
+    runBatch(&batch);
+    CHECK_EQUAL(batch.succeeded, PARAMETERS);
+    for (int i = 0; i < PARAMETERS; ++i) {
+        CHECK_EQUAL(parameters[i].value, 7 * i);
+    }
+}
+
+int main(void) {
+    testWriteReadBack();
+    testBusyRetry();
+    return testResult("test_parameters");
+}
@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANRequest.h"
+#include "../Ports/PortSim.h"
+#include "../Packets/DecodeMotor.h"
+#include "../Packets/Universal.h"
+
+typedef struct {
+    int calls;
+    uint8_t status;
+    uint16_t endpointID;
+    uint32_t value;
+} Response_t;
+
+static void onResponse(uint8_t status, const CANPacket_t *response, void *context) {
+    Response_t *result = context;
+    ++result->calls;
+    result->status = status;
+    if (response && (response->command & 0x7F) == CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT) {
+        CANMotorPacket_BLDC_DirectReadResult_Decoded_t decoded = CANMotorPacket_BLDC_DirectReadResult_Decode(response);
+        result->endpointID = decoded.endpointID;
+        result->value = decoded.value;
+    }
+}
+
+static CANSimBus_t bus;
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+static CANDevice_t bldc = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+static CANSimNode_t hostNode;
+static CANSimNode_t deviceNode;
+static CANRequestTracker_t tracker;
+
+static void setup(void) {
+    CANSimBusInit(&bus, 1000000);
+    hostNode = (CANSimNode_t){.bus = &bus};
+    deviceNode = (CANSimNode_t){.bus = &bus};
+    CANInit(&hostNode, &jetson);
+    CANInit(&deviceNode, &bldc);
+    CANRequestInit(&tracker, &hostNode);
+}
+
+/**
+ * Runs the bus for a millisecond and hands everything the host received to the tracker
+ */
+static void step(void) {
+    CANSimBusRunUntil(&bus, bus.now + 1000000);
+    CANPacket_t packet;
+    while (CANPollAndReceive(&hostNode, &packet) > 0) {
+        CANRequestHandleResponse(&tracker, &packet);
+    }
+    CANRequestPoll(&tracker);
+}
+
+/**
+ * Two reads of different endpoints answered in reverse order each complete the request for their endpoint
+ */
+static void testMatchByEndpoint(void) {
+    setup();
+    Response_t first = {0};
+    Response_t second = {0};
+    CANPacket_t read = CANMotorPacket_BLDC_DirectRead(jetson, bldc, 0x10);
+    CHECK_EQUAL(CANRequestSend(&tracker, &read, 10000, onResponse, &first), CAN_OK);
+    read = CANMotorPacket_BLDC_DirectRead(jetson, bldc, 0x20);
+    CHECK_EQUAL(CANRequestSend(&tracker, &read, 10000, onResponse, &second), CAN_OK);
+    CHECK_EQUAL(tracker.pending, 2);
+
+    step();
+    CANPacket_t request;
+    int requests = 0;
+    while (CANPollAndReceive(&deviceNode, &request) > 0) {
+        CHECK_EQUAL(request.command, CAN_ACK(CAN_COMMAND_ID__BLDC_DIRECT_READ));
+        ++requests;
+    }
+    CHECK_EQUAL(requests, 2);
+
+    CANPacket_t result = CANMotorPacket_BLDC_DirectReadResult(bldc, jetson, 0x20, 222);
+    CHECK_EQUAL(CANSend(&deviceNode, &result), CAN_OK);
+    result = CANMotorPacket_BLDC_DirectReadResult(bldc, jetson, 0x10, 111);
+    CHECK_EQUAL(CANSend(&deviceNode, &result), CAN_OK);
+    step();
+
+    CHECK_EQUAL(first.calls, 1);
+    CHECK_EQUAL(first.status, CAN_OK);
+    CHECK_EQUAL(first.endpointID, 0x10);
+    CHECK_EQUAL(first.value, 111);
+    CHECK_EQUAL(second.calls, 1);
+    CHECK_EQUAL(second.endpointID, 0x20);
+    CHECK_EQUAL(second.value, 222);
+    CHECK_EQUAL(tracker.pending, 0);
+    CHECK_EQUAL(tracker.completed, 2);
+
+    // A result for an endpoint nobody asked for completes nothing
+    CHECK_EQUAL(CANRequestExpect(&tracker, CAN_UUID_BLDC_BASE, CAN_COMMAND_ID__BLDC_DIRECT_READ_RESULT,
+                                 true, 0x30, 10000, onResponse, &first), CAN_OK);
+    CHECK_EQUAL(CANSend(&deviceNode, &result), CAN_OK);
+    step();
+    CHECK_EQUAL(first.calls, 1);
+    CHECK_EQUAL(tracker.unmatched, 1);
+    CHECK_EQUAL(tracker.pending, 1);
+}
+
+/**
+ * Unkeyed responses complete the oldest request, a request without a response times out once
+ * and its late response is counted as unmatched
+ */
+static void testTimeout(void) {
+    setup();
+    Response_t older = {0};
+    Response_t newer = {0};
+    CANPacket_t get = CANMotorPacket_BLDC_GetEncoderEstimates(jetson, bldc, 0);
+    CHECK_EQUAL(CANRequestSend(&tracker, &get, 5000, onResponse, &older), CAN_OK);
+    step();
+    CHECK_EQUAL(CANRequestSend(&tracker, &get, 5000, onResponse, &newer), CAN_OK);
+
+    CANPacket_t estimates = CANMotorPacket_BLDC_EncoderEstimates(bldc, jetson, 1.0f, 2.0f);
+    CHECK_EQUAL(CANSend(&deviceNode, &estimates), CAN_OK);
+    step();
+    CHECK_EQUAL(older.calls, 1);
+    CHECK_EQUAL(older.status, CAN_OK);
+    CHECK_EQUAL(newer.calls, 0);
+
+    // The newer request was sent 1 ms after the older one and times out 5 ms after it was sent
+    for (int i = 0; i < 3; ++i) {
+        step();
+    }
+    CHECK_EQUAL(newer.calls, 0);
+    step();
+    CHECK_EQUAL(newer.calls, 1);
+    CHECK_EQUAL(newer.status, CAN_TIMEOUT);
+    CHECK_EQUAL(tracker.timedOut, 1);
+    CHECK_EQUAL(tracker.pending, 0);
+
+    CHECK_EQUAL(CANSend(&deviceNode, &estimates), CAN_OK);
+    step();
+    CHECK_EQUAL(newer.calls, 1);
+    CHECK_EQUAL(tracker.unmatched, 1);
+
+    // A command that expects no response and a broadcast are refused
+    CANPacket_t estop = CANUniversalPacket_EStop(jetson, bldc);
+    CHECK_EQUAL(CANRequestSend(&tracker, &estop, 5000, onResponse, &older), CAN_ERROR);
+    CANDevice_t everyone = {.motorDomain = 1};
+    get = CANMotorPacket_BLDC_GetEncoderEstimates(jetson, everyone, 0);
+    CHECK_EQUAL(CANRequestSend(&tracker, &get, 5000, onResponse, &older), CAN_ERROR);
+}
+
+int main(void) {
+    testMatchByEndpoint();
+    testTimeout();
+    return testResult("test_request");
+}
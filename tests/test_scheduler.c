@@ -0,0 +1,128 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANScheduler.h"
+#include "../Ports/PortSim.h"
+#include "../Packets/Universal.h"
+
+#define NODES 10
+#define PERIOD_MICROS 10000
+#define TICK_MICROS 100
+
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+
+static bool buildHeartbeat(CANPacket_t *packet, void *context) {
+    const CANDevice_t *self = context;
+    *packet = CANUniversalPacket_HeartBeat(*self, jetson, 0, 1);
+    return true;
+}
+
+/**
+ * Largest gap between neighbouring offsets on the circle of one period, sorts the offsets
+ */
+static uint32_t largestGap(uint32_t *offsets, int count, uint32_t period) {
+    for (int i = 1; i < count; ++i) {
+        for (int j = i; j > 0 && offsets[j - 1] > offsets[j]; --j) {
+            uint32_t swap = offsets[j];
+            offsets[j] = offsets[j - 1];
+            offsets[j - 1] = swap;
+        }
+    }
+    uint32_t largest = offsets[0] + period - offsets[count - 1];
+    for (int i = 1; i < count; ++i) {
+        if (offsets[i] - offsets[i - 1] > largest) {
+            largest = offsets[i] - offsets[i - 1];
+        }
+    }
+    return largest;
+}
+
+/**
+ * Automatic offsets stay within the period and leave no gap much larger than an even spread would
+ */
+static void testAutoOffsets(void) {
+    uint32_t offsets[CAN_SCHEDULER_MAX_ENTRIES];
+    for (int node = 0; node < NODES; ++node) {
+        offsets[node] = CANSchedulerAutoOffset(CAN_UUID_BLDC_FRONT_TIRE_LEFT + node, 0, PERIOD_MICROS);
+        CHECK(offsets[node] < PERIOD_MICROS);
+    }
+    CHECK(largestGap(offsets, NODES, PERIOD_MICROS) <= 2 * PERIOD_MICROS / NODES);
+
+    for (int8_t slot = 0; slot < CAN_SCHEDULER_MAX_ENTRIES; ++slot) {
+        offsets[slot] = CANSchedulerAutoOffset(CAN_UUID_BLDC_BASE, slot, PERIOD_MICROS);
+        CHECK(offsets[slot] < PERIOD_MICROS);
+    }
+    CHECK(largestGap(offsets, CAN_SCHEDULER_MAX_ENTRIES, PERIOD_MICROS) <= 2 * PERIOD_MICROS / CAN_SCHEDULER_MAX_ENTRIES);
+}
+
+/**
+ * Runs a heartbeat on every node for one simulated second, ticking every scheduler every TICK_MICROS
+ * A tick may start late by the frame on the bus when it is due, which bounds the jitter
+ * Checks the period seen by a listener and returns the longest time a heartbeat waited for the bus (ns)
+ */
+static uint64_t runHeartbeats(uint32_t offsetMicros) {
+    uint32_t jitterMicros = TICK_MICROS + CANSimFrameBits(0, (const uint8_t[8]){0}, 8, NULL);
+    static CANSimBus_t bus;
+    static CANSimNode_t nodes[NODES];
+    static CANDevice_t devices[NODES];
+    static CANScheduler_t schedulers[NODES];
+    CANSimBusInit(&bus, 1000000);
+    CANSimNode_t listener = {.bus = &bus};
+    CANInit(&listener, &jetson);
+    for (int i = 0; i < NODES; ++i) {
+        devices[i] = (CANDevice_t){.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_FRONT_TIRE_LEFT + i};
+        nodes[i] = (CANSimNode_t){.bus = &bus};
+        CANInit(&nodes[i], &devices[i]);
+        CANSchedulerInit(&schedulers[i], &nodes[i], devices[i].deviceUUID);
+        CHECK_EQUAL(CANSchedulerAdd(&schedulers[i], PERIOD_MICROS, offsetMicros, buildHeartbeat, &devices[i]), 0);
+    }
+
+    CANTimestamp_t last[NODES] = {0};
+    int received[NODES] = {0};
+    for (uint64_t time = 0; time <= 1000000000; time += TICK_MICROS * 1000) {
+        CANSimBusRunUntil(&bus, time);
+        for (int i = 0; time < 1000000000 && i < NODES; ++i) {
+            CANSchedulerRun(&schedulers[i]);
+        }
+        CANPacket_t packet;
+        CANTimestamp_t timestamp;
+        while (CANPollAndReceiveTimestamped(&listener, &packet, &timestamp) > 0) {
+            int node = packet.senderUUID - CAN_UUID_BLDC_FRONT_TIRE_LEFT;
+            if (received[node]++) {
+                int64_t error = (int64_t)(timestamp - last[node]) - PERIOD_MICROS * 1000;
+                CHECK(error <= jitterMicros * 1000 && error >= -(int64_t)jitterMicros * 1000);
+            }
+            last[node] = timestamp;
+        }
+    }
+
+    uint64_t maxDelay = 0;
+    for (int i = 0; i < NODES; ++i) {
+        CHECK_EQUAL(received[i], 1000000 / PERIOD_MICROS);
+        CANSchedulerStats_t stats;
+        CHECK(CANSchedulerGetStats(&schedulers[i], 0, &stats));
+        CHECK_EQUAL(stats.releases, received[i]);
+        CHECK_EQUAL(stats.missed, 0);
+        CHECK_EQUAL(stats.dropped, 0);
+        CHECK(stats.maxJitterMicros < jitterMicros);
+        if (nodes[i].stats.maxQueueingDelay > maxDelay) {
+            maxDelay = nodes[i].stats.maxQueueingDelay;
+        }
+    }
+    return maxDelay;
+}
+
+/**
+ * Spread offsets keep the heartbeats of all nodes from queueing behind each other, which they do when
+ * every node releases at the same instant
+ */
+static void testSpreadOnBus(void) {
+    uint32_t frameNanos = CANSimFrameBits(0x7FF, (const uint8_t[8]){0}, 8, NULL) * 1000;
+    CHECK(runHeartbeats(CAN_SCHEDULER_AUTO_OFFSET) <= frameNanos);
+    CHECK(runHeartbeats(0) >= (NODES - 1) * frameNanos / 2);
+}
+
+int main(void) {
+    testAutoOffsets();
+    testSpreadOnBus();
+    return testResult("test_scheduler");
+}
@@ -0,0 +1,276 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANDispatch.h"
+#include "../Packets/Universal.h"
+#include "../Packets/Motor.h"
+#include "../Packets/Peripheral.h"
+#include "../Packets/Power.h"
+#include "../Ports/PortSim.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CONTENTS_SIZE sizeof(((CANPacket_t *)0)->contents)
+
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+static CANDevice_t device = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+static CANDispatcher_t dispatcher;
+static int handlerCalls;
+static bool checkFields;
+
+// A sample value per field, exact in its format and different for every field of a packet (taken from its offset)
+#define SAMPLE_UInt8(offset)    ((uint8_t)(0xA0 + (offset)))
+#define SAMPLE_Int8(offset)     ((int8_t)(-90 + (int)(offset)))
+#define SAMPLE_Bool(offset)     true
+#define SAMPLE_UInt16(offset)   ((uint16_t)(0xBE00 + (offset)))
+#define SAMPLE_Int16(offset)    ((int16_t)(-12300 + (int)(offset)))
+#define SAMPLE_UInt32(offset)   (0xDEADBE00u + (uint32_t)(offset))
+#define SAMPLE_Int32(offset)    (-123456700 + (int32_t)(offset))
+#define SAMPLE_Float32(offset)  (3.25f + (float)(offset))
+#define SAMPLE_Float16(offset)  (-1.5f - (float)(offset))
+#define SAMPLE_BFloat24(offset) (2.5f + (float)(offset))
+#define SAMPLE_BFloat16(offset) (-0.75f - (float)(offset))
+#define SAMPLE_UNorm16(offset)  (((offset) + 1) / 65535.0f)
+#define SAMPLE_UNorm8(offset)   (((offset) + 1) / 255.0f)
+
+#define SAMPLE(NAME, FORMAT, FIELD) SAMPLE_##FORMAT(CAN_SCHEMA_OFFSET(NAME, FIELD))
+#define SAMPLE_ARG(NAME, FORMAT, FIELD) , SAMPLE(NAME, FORMAT, FIELD)
+
+// Normalized formats decode to the nearest float of the stored fraction, the rest is exact
+#define SAME_UNorm16(decoded, sample) (fabsf((decoded) - (sample)) < 1e-6f)
+#define SAME_UNorm8(decoded, sample)  (fabsf((decoded) - (sample)) < 1e-6f)
+#define SAME_UInt8    SAME_EXACT
+#define SAME_Int8     SAME_EXACT
+#define SAME_Bool     SAME_EXACT
+#define SAME_UInt16   SAME_EXACT
+#define SAME_Int16    SAME_EXACT
+#define SAME_UInt32   SAME_EXACT
+#define SAME_Int32    SAME_EXACT
+#define SAME_Float32  SAME_EXACT
+#define SAME_Float16  SAME_EXACT
+#define SAME_BFloat24 SAME_EXACT
+#define SAME_BFloat16 SAME_EXACT
+#define SAME_EXACT(decoded, sample) ((decoded) == (sample))
+
+#define CHECK_FIELD(NAME, FORMAT, FIELD) CHECK(SAME_##FORMAT(decoded->FIELD, SAMPLE(NAME, FORMAT, FIELD)));
+
+/**
+ * Defines name_Check, the dispatch handler of every packet
+ * For packets with generated builders it also compares each decoded field with its sample while checkFields is set
+ */
+#define DEFINE_HANDLER(NAME, COMMAND, KIND, FLAGS, TAIL) DEFINE_HANDLER_##KIND(NAME)
+#define DEFINE_HANDLER_AUTO(NAME)          DEFINE_HANDLER_FIELDS(NAME)
+#define DEFINE_HANDLER_CUSTOM_DECODE(NAME) DEFINE_HANDLER_FIELDS(NAME)
+#define DEFINE_HANDLER_CUSTOM_BUILD(NAME)  DEFINE_HANDLER_COUNT(NAME)
+#define DEFINE_HANDLER_CUSTOM(NAME)        DEFINE_HANDLER_COUNT(NAME)
+
+#define DEFINE_HANDLER_FIELDS(NAME)                                                                    \
+    static void NAME##_Check(const NAME##_Decoded_t *decoded, const CANPacket_t *packet, void *context) { \
+        (void)packet;                                                                                  \
+        (void)context;                                                                                 \
+        ++handlerCalls;                                                                                \
+        CHECK(decoded->sender.deviceUUID == jetson.deviceUUID);                                        \
+        CHECK(decoded->receiver.deviceUUID == device.deviceUUID);                                      \
+        if (checkFields) {                                                                             \
+            NAME##_FIELDS(CHECK_FIELD, NAME)                                                           \
+        }                                                                                              \
+    }
+
+#define DEFINE_HANDLER_COUNT(NAME)                                                                     \
+    static void NAME##_Check(const NAME##_Decoded_t *decoded, const CANPacket_t *packet, void *context) { \
+        (void)decoded;                                                                                 \
+        (void)packet;                                                                                  \
+        (void)context;                                                                                 \
+        ++handlerCalls;                                                                                \
+    }
+
+CAN_SCHEMA(DEFINE_HANDLER)
+
+#define REGISTER(NAME, COMMAND, KIND, FLAGS, TAIL) CHECK(NAME##_Register(&dispatcher, NAME##_Check, NULL));
+
+/**
+ * The length tables and the dispatcher accept exactly the lengths from the schema, with and without
+ * the acknowledgement bit, and a packet of a valid length reaches its handler
+ */
+#define CHECK_LENGTHS(NAME, COMMAND, KIND, FLAGS, TAIL)                                                      \
+    CHECK_EQUAL(CANSchemaMinLength(COMMAND), NAME##_LENGTH - (TAIL));                                        \
+    CHECK_EQUAL(CANSchemaMaxLength(CAN_ACK(COMMAND)), NAME##_LENGTH);                                        \
+    for (int length = 0; length <= (int)CONTENTS_SIZE; ++length) {                                          \
+        CANPacket_t packet = {.device = device, .contentsLength = (uint8_t)length, .command = (COMMAND),     \
+                              .senderUUID = jetson.deviceUUID};                                              \
+        bool valid = length >= NAME##_LENGTH - (TAIL) && length <= NAME##_LENGTH;                            \
+        for (int ack = 0; ack < 2; ++ack) {                                                                  \
+            packet.command = ack ? CAN_ACK(COMMAND) : (COMMAND);                                             \
+            handlerCalls = 0;                                                                                \
+            CHECK_EQUAL(CANDispatch(&dispatcher, &packet), valid ? CAN_DISPATCH_HANDLED : CAN_DISPATCH_BAD_LENGTH); \
+            CHECK_EQUAL(handlerCalls, valid);                                                                \
+        }                                                                                                    \
+    }
+
+static void testLengths(void) {
+    CANDispatchInit(&dispatcher);
+    CAN_SCHEMA(REGISTER)
+    CAN_SCHEMA(CHECK_LENGTHS)
+    CHECK_EQUAL(CANSchemaMinLength(0x7F), CAN_SCHEMA_UNKNOWN_LENGTH);
+    CHECK_EQUAL(CANPowerPacket_PowerStatus_LENGTH, 6);
+}
+
+/**
+ * Sends a packet from a node over the simulated bus and dispatches what the receiving node got
+ */
+static void sendAndDispatch(const CANPacket_t *packet) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANSimNode_t senderNode = {.bus = &bus};
+    CANSimNode_t receiverNode = {.bus = &bus};
+    CANInit(&senderNode, &jetson);
+    CANInit(&receiverNode, &device);
+    CHECK_EQUAL(CANSend(&senderNode, packet), CAN_OK);
+    CANSimBusRunUntil(&bus, 1000000);
+
+    CANPacket_t received;
+    handlerCalls = 0;
+    CHECK_EQUAL(CANPollAndReceive(&receiverNode, &received), 1);
+    CHECK_EQUAL(received.command, packet->command);
+    CHECK_EQUAL(received.contentsLength, packet->contentsLength);
+    CHECK(memcmp(received.contents, packet->contents, packet->contentsLength) == 0);
+    CHECK_EQUAL(CANDispatch(&dispatcher, &received), CAN_DISPATCH_HANDLED);
+    CHECK_EQUAL(handlerCalls, 1);
+}
+
+/**
+ * Builds every packet with a generated builder from the samples, sends it over the bus
+ * and checks each field its handler gets
+ */
+#define ROUND_TRIP(NAME, COMMAND, KIND, FLAGS, TAIL) ROUND_TRIP_##KIND(NAME, COMMAND, FLAGS)
+#define ROUND_TRIP_AUTO(NAME, COMMAND, FLAGS)          ROUND_TRIP_BUILT(NAME, COMMAND, FLAGS)
+#define ROUND_TRIP_CUSTOM_DECODE(NAME, COMMAND, FLAGS) ROUND_TRIP_BUILT(NAME, COMMAND, FLAGS)
+#define ROUND_TRIP_CUSTOM_BUILD(NAME, COMMAND, FLAGS)
+#define ROUND_TRIP_CUSTOM(NAME, COMMAND, FLAGS)
+
+#define ROUND_TRIP_BUILT(NAME, COMMAND, FLAGS) {                                                            \
+        CANPacket_t packet = NAME(jetson, device NAME##_FIELDS(SAMPLE_ARG, NAME));                          \
+        CHECK_EQUAL(packet.command, ((FLAGS) & CAN_SCHEMA_ACK) ? CAN_ACK(COMMAND) : (COMMAND));             \
+        CHECK_EQUAL(packet.priority, ((FLAGS) & CAN_SCHEMA_HIGH_PRIORITY) ? CAN_PRIORITY_HIGH : CAN_PRIORITY_LOW); \
+        CHECK_EQUAL(packet.contentsLength, NAME##_LENGTH);                                                  \
+        CHECK_EQUAL(packet.senderUUID, jetson.deviceUUID);                                                  \
+        checkFields = true;                                                                                 \
+        sendAndDispatch(&packet);                                                                           \
+        checkFields = false;                                                                                \
+    }
+
+static void testRoundTrips(void) {
+    CANDispatchInit(&dispatcher);
+    CAN_SCHEMA(REGISTER)
+    CAN_SCHEMA(ROUND_TRIP)
+}
+
+static CANMotorPacket_BLDC_SetInputPosition_Decoded_t position;
+static CANPeripheralPacket_SetServoAngle_Decoded_t servo;
+static CANPeripheralPacket_SetPWMDutyCycle_Decoded_t pwm;
+static CANUniversalPacket_FirmwareVersion_Decoded_t version;
+
+static void onPosition(const CANMotorPacket_BLDC_SetInputPosition_Decoded_t *decoded, const CANPacket_t *packet, void *context) {
+    (void)packet;
+    (void)context;
+    ++handlerCalls;
+    position = *decoded;
+}
+
+static void onServo(const CANPeripheralPacket_SetServoAngle_Decoded_t *decoded, const CANPacket_t *packet, void *context) {
+    (void)packet;
+    (void)context;
+    ++handlerCalls;
+    servo = *decoded;
+}
+
+static void onPWM(const CANPeripheralPacket_SetPWMDutyCycle_Decoded_t *decoded, const CANPacket_t *packet, void *context) {
+    (void)packet;
+    (void)context;
+    ++handlerCalls;
+    pwm = *decoded;
+}
+
+static void onVersion(const CANUniversalPacket_FirmwareVersion_Decoded_t *decoded, const CANPacket_t *packet, void *context) {
+    (void)packet;
+    (void)context;
+    ++handlerCalls;
+    version = *decoded;
+}
+
+/**
+ * The handwritten builders: clamps and argument orders that differ from the wire order
+ */
+static void testHandwritten(void) {
+    CANDispatchInit(&dispatcher);
+    CANMotorPacket_BLDC_SetInputPosition_Register(&dispatcher, onPosition, NULL);
+    CANPeripheralPacket_SetServoAngle_Register(&dispatcher, onServo, NULL);
+    CANPeripheralPacket_SetPWMDutyCycle_Register(&dispatcher, onPWM, NULL);
+    CANUniversalPacket_FirmwareVersion_Register(&dispatcher, onVersion, NULL);
+
+    // The feed forward velocity is clamped to the Int16 range the decoder reads
+    const float velocities[] = {1.25f, -1.5f, 100.0f, -100.0f, NAN};
+    const int16_t raw[] = {1250, -1500, 32767, -32768, 0};
+    for (int i = 0; i < 5; ++i) {
+        CANPacket_t packet = CANMotorPacket_BLDC_SetInputPosition(jetson, device, -2.5f, velocities[i]);
+        sendAndDispatch(&packet);
+        CHECK(position.position == -2.5f);
+        CHECK_EQUAL(position.feedForwardVelocityRaw, raw[i]);
+        CHECK(position.feedForwardVelocity == (float)(raw[i] * 0.001));
+    }
+
+    // The builder takes the id first, the angle comes first on the wire
+    CANPacket_t packet = CANPeripheralPacket_SetServoAngle(jetson, device, 7, 0x1234);
+    sendAndDispatch(&packet);
+    CHECK_EQUAL(servo.servo_id, 7);
+    CHECK_EQUAL(servo.servo_angle, 0x1234);
+
+    packet = CANPeripheralPacket_SetPWMDutyCycle(jetson, device, 3, 150.0f);
+    sendAndDispatch(&packet);
+    CHECK_EQUAL(pwm.peripheralID, 3);
+    CHECK(pwm.dutyCycle == 100.0f);
+    packet = CANPeripheralPacket_SetPWMDutyCycle(jetson, device, 3, -5.0f);
+    sendAndDispatch(&packet);
+    CHECK(pwm.dutyCycle == 0.0f);
+
+    // Shorter names shorten the packet, down to the dispatcher's minimum length
+    packet = CANUniversalPacket_FirmwareVersion(jetson, device, "odrv", 312);
+    CHECK_EQUAL(packet.contentsLength, CANUniversalPacket_FirmwareVersion_LENGTH);
+    sendAndDispatch(&packet);
+    CHECK_EQUAL(version.versionID, 312);
+    CHECK(memcmp(version.name, "odrv", 4) == 0);
+    packet = CANUniversalPacket_FirmwareVersion(jetson, device, "", 5);
+    CHECK_EQUAL(packet.contentsLength, CANSchemaMinLength(CAN_COMMAND_ID__VERSION));
+    sendAndDispatch(&packet);
+    CHECK_EQUAL(version.versionID, 5);
+
+    // The variable length packets decode the data they carry
+    const uint8_t data[6] = {1, 2, 3, 4, 5, 6};
+    packet = CANUniversalPacket_TransportFirst(jetson, device, 2, 9, data);
+    CHECK_EQUAL(packet.contentsLength, CANSchemaMinLength(CAN_COMMAND_ID__TRANSPORT_FIRST) + 2);
+    CANUniversalPacket_TransportFirst_Decoded_t first = CANUniversalPacket_TransportFirst_Decode(&packet);
+    CHECK_EQUAL(first.length, 2);
+    CHECK_EQUAL(first.tag, 9);
+    CHECK_EQUAL(first.dataLength, 2);
+    CHECK(memcmp(first.data, data, 2) == 0);
+
+    packet = CANUniversalPacket_TransportConsecutive(jetson, device, 4, data, 6);
+    CHECK_EQUAL(packet.contentsLength, CANSchemaMaxLength(CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE));
+    CANUniversalPacket_TransportConsecutive_Decoded_t consecutive = CANUniversalPacket_TransportConsecutive_Decode(&packet);
+    CHECK_EQUAL(consecutive.sequence, 4);
+    CHECK_EQUAL(consecutive.dataLength, CAN_TRANSPORT_CONSECUTIVE_DATA_LEN);
+    CHECK(memcmp(consecutive.data, data, CAN_TRANSPORT_CONSECUTIVE_DATA_LEN) == 0);
+
+    packet = CANUniversalPacket_FirmwareData(jetson, device, data, 4);
+    CHECK_EQUAL(packet.contentsLength, 4);
+    CANUniversalPacket_FirmwareData_Decoded_t firmware = CANUniversalPacket_FirmwareData_Decode(&packet);
+    CHECK_EQUAL(firmware.dataLength, 4);
+    CHECK(memcmp(firmware.data, data, 4) == 0);
+}
+
+int main(void) {
+    testLengths();
+    testRoundTrips();
+    testHandwritten();
+    return testResult("test_schema");
+}
@@ -0,0 +1,177 @@
+#include "Test.h"
+#include "../Ports/PortSim.h"
+
+#include <string.h>
+
+#define UUID_POS 3
+#define LOW_PRIORITY 0x400
+
+/**
+ * Queues a frame with a raw identifier on the node, tagged through its command so the receiver can tell frames apart
+ */
+static void sendIdentifier(CANSimNode_t *node, uint16_t identifier, CANCommand_t tag) {
+    CANPacket_t packet = {.command = tag};
+    CANSetPacketHeader(&packet, identifier);
+    CHECK_EQUAL(CANSend(node, &packet), CAN_OK);
+}
+
+/**
+ * Drains the node's receive queue into identifiers and tags, returns the number of frames
+ */
+static int receiveAll(CANSimNode_t *node, uint16_t *identifiers, CANCommand_t *tags, int max) {
+    CANPacket_t packet;
+    int count = 0;
+    while (count < max && CANPollAndReceive(node, &packet) > 0) {
+        identifiers[count] = CANGetPacketHeader(&packet);
+        tags[count] = packet.command;
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * CAN FD frames with alternating identifier and data bits, so the only stuff bits are the fixed ones
+ * Nominal phase: SOF through BRS (17) and CRC delimiter through interframe space (13)
+ * Data phase: ESI, DLC, data, stuff count (4), CRC and the fixed stuff bits
+ */
+static void testFDFrameBits(void) {
+    uint8_t data[20];
+    memset(data, 0x55, sizeof(data));
+    uint32_t nominalBits;
+    uint32_t dataBits;
+    uint32_t stuffBits;
+
+    // CRC17 with 6 fixed stuff bits
+    CANSimFDFrameBits(0x555, data, 8, &nominalBits, &dataBits, &stuffBits);
+    CHECK_EQUAL(nominalBits, 30);
+    CHECK_EQUAL(dataBits, 1 + 4 + 64 + 4 + 17 + 6);
+    CHECK_EQUAL(stuffBits, 6);
+
+    // CRC21 with 7 fixed stuff bits
+    CANSimFDFrameBits(0x555, data, 20, &nominalBits, &dataBits, &stuffBits);
+    CHECK_EQUAL(nominalBits, 30);
+    CHECK_EQUAL(dataBits, 1 + 4 + 160 + 4 + 21 + 7);
+    CHECK_EQUAL(stuffBits, 7);
+}
+
+/**
+ * The lowest identifier offered wins each arbitration, a FIFO node offers only the head of its queue
+ * while an ID ordered node offers its lowest identifier
+ */
+static void testArbitrationOrder(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t listenerDevice = {.peripheralDomain = 1, .motorDomain = 1, .powerDomain = 1, .deviceUUID = 0x20};
+    CANDevice_t devices[3] = {{.deviceUUID = 0x21}, {.deviceUUID = 0x22}, {.deviceUUID = 0x23}};
+    CANSimNode_t listener = {.bus = &bus};
+    CANSimNode_t fifo = {.bus = &bus};
+    CANSimNode_t single = {.bus = &bus};
+    CANSimNode_t ordered = {.bus = &bus, .idOrdered = true};
+    CANInit(&listener, &listenerDevice);
+    CANInit(&fifo, &devices[0]);
+    CANInit(&single, &devices[1]);
+    CANInit(&ordered, &devices[2]);
+
+    // Domain broadcasts, so only the listener accepts them
+    sendIdentifier(&fifo, LOW_PRIORITY | 0x04, 1);
+    sendIdentifier(&fifo, 0x01, 2);
+    sendIdentifier(&single, LOW_PRIORITY | 0x02, 3);
+    sendIdentifier(&ordered, LOW_PRIORITY | 0x01, 4);
+    sendIdentifier(&ordered, 0x02, 5);
+    CANSimBusRunUntil(&bus, 1000000);
+
+    uint16_t identifiers[8];
+    CANCommand_t tags[8];
+    CHECK_EQUAL(receiveAll(&listener, identifiers, tags, 8), 5);
+    // The high priority frame of the FIFO node waits behind its low priority head
+    const CANCommand_t expected[] = {5, 4, 3, 1, 2};
+    for (int i = 0; i < 5; ++i) {
+        CHECK_EQUAL(tags[i], expected[i]);
+    }
+    CHECK_EQUAL(bus.frames, 5);
+    CHECK_EQUAL(bus.collisions, 0);
+}
+
+/**
+ * A node after CANInit receives frames for its UUID and broadcasts to its domains, nothing else
+ */
+static void testFilterRejection(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t hostDevice = {.deviceUUID = 0x01};
+    CANDevice_t motorDevice = {.motorDomain = 1, .deviceUUID = 0x34};
+    CANSimNode_t host = {.bus = &bus};
+    CANSimNode_t motor = {.bus = &bus};
+    CANInit(&host, &hostDevice);
+    CANInit(&motor, &motorDevice);
+
+    const uint16_t accepted[] = {0x34 << UUID_POS, LOW_PRIORITY | 0x34 << UUID_POS, 0x02, LOW_PRIORITY | 0x06};
+    const uint16_t rejected[] = {0x35 << UUID_POS, 0x01, 0x04, 0x05, 0x01 << UUID_POS | 0x02};
+    for (int i = 0; i < 5; ++i) {
+        sendIdentifier(&host, rejected[i], 0x40 + i);
+        if (i < 4) {
+            sendIdentifier(&host, accepted[i], i);
+        }
+    }
+    CANSimBusRunUntil(&bus, 1000000);
+    CHECK_EQUAL(bus.frames, 9);
+    CHECK_EQUAL(host.stats.framesSent, 9);
+
+    uint16_t identifiers[16];
+    CANCommand_t tags[16];
+    CHECK_EQUAL(receiveAll(&motor, identifiers, tags, 16), 4);
+    for (int i = 0; i < 4; ++i) {
+        CHECK_EQUAL(identifiers[i], accepted[i]);
+        CHECK_EQUAL(tags[i], i);
+    }
+    CHECK_EQUAL(motor.stats.framesReceived, 4);
+}
+
+/**
+ * Two nodes offering the same identifier at once are counted as a collision on the bus and on both nodes,
+ * the node attached first sends first whichever queued first, and the other one follows on its own
+ */
+static void testEqualIdentifierTie(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t hostDevice = {.deviceUUID = 0x01};
+    CANDevice_t devices[2] = {{.deviceUUID = 0x10}, {.deviceUUID = 0x11}};
+    CANSimNode_t host = {.bus = &bus};
+    CANSimNode_t first = {.bus = &bus};
+    CANSimNode_t second = {.bus = &bus};
+    CANInit(&host, &hostDevice);
+    CANInit(&first, &devices[0]);
+    CANInit(&second, &devices[1]);
+
+    uint16_t identifier = 0x01 << UUID_POS;
+    sendIdentifier(&second, identifier, 2);
+    sendIdentifier(&first, identifier, 1);
+    CANSimBusRunUntil(&bus, 1000000);
+
+    uint16_t identifiers[4];
+    CANCommand_t tags[4];
+    CHECK_EQUAL(receiveAll(&host, identifiers, tags, 4), 2);
+    CHECK_EQUAL(tags[0], 1);
+    CHECK_EQUAL(tags[1], 2);
+    CHECK_EQUAL(bus.collisions, 1);
+    CHECK_EQUAL(first.stats.collisions, 1);
+    CHECK_EQUAL(second.stats.collisions, 1);
+    CHECK_EQUAL(host.stats.collisions, 0);
+
+    // Different priorities arbitrate normally
+    sendIdentifier(&first, LOW_PRIORITY | identifier, 3);
+    sendIdentifier(&second, identifier, 4);
+    CANSimBusRunUntil(&bus, 2000000);
+    CHECK_EQUAL(receiveAll(&host, identifiers, tags, 4), 2);
+    CHECK_EQUAL(tags[0], 4);
+    CHECK_EQUAL(tags[1], 3);
+    CHECK_EQUAL(bus.collisions, 1);
+}
+
+int main(void) {
+    testFDFrameBits();
+    testArbitrationOrder();
+    testFilterRejection();
+    testEqualIdentifierTie();
+    return testResult("test_sim");
+}
@@ -0,0 +1,167 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANStateCache.h"
+#include "../Ports/PortSim.h"
+#include "../Packets/Universal.h"
+#include "../Packets/Motor.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define WRITES 1000000
+
+static CANStateCache_t cache;
+static CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+static CANDevice_t bldc = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+
+/**
+ * Packets received on the simulated bus are cached with their receive timestamp, others are passed on
+ */
+static void testReceive(void) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANSimNode_t host = {.bus = &bus};
+    CANSimNode_t device = {.bus = &bus};
+    CANInit(&host, &jetson);
+    CANInit(&device, &bldc);
+    CANStateCacheInit(&cache);
+
+    CANMotorPacket_BLDC_EncoderEstimates_Decoded_t estimates;
+    CANTimestamp_t updated;
+    CHECK(!CANMotorPacket_BLDC_EncoderEstimates_Cached(&cache, CAN_UUID_BLDC_BASE, &estimates, &updated));
+
+    CANPacket_t packets[] = {
+        CANMotorPacket_BLDC_EncoderEstimates(bldc, jetson, 1.5f, -2.0f),
+        CANUniversalPacket_HeartBeat(bldc, jetson, 0x1234, 3),
+        CANUniversalPacket_Acknowledge(bldc, jetson, false, CAN_COMMAND_ID__BLDC_DIRECT_READ)
+    };
+    CHECK_EQUAL(CANSendBatch(&device, packets, 3), 3);
+    CANSimBusRunUntil(&bus, 1000000);
+
+    CANPacket_t packet;
+    CANTimestamp_t timestamp;
+    CANTimestamp_t received[3];
+    int count = 0;
+    while (CANPollAndReceiveTimestamped(&host, &packet, &timestamp) > 0) {
+        received[count] = timestamp;
+        CHECK_EQUAL(CANStateCacheUpdate(&cache, &packet, timestamp), count < 2);
+        ++count;
+    }
+    CHECK_EQUAL(count, 3);
+
+    CHECK(CANMotorPacket_BLDC_EncoderEstimates_Cached(&cache, CAN_UUID_BLDC_BASE, &estimates, &updated));
+    CHECK(estimates.position == 1.5f);
+    CHECK(estimates.velocity == -2.0f);
+    CHECK_EQUAL(updated, received[0]);
+    CANUniversalPacket_HeartBeat_Decoded_t heartbeat;
+    CHECK(CANUniversalPacket_HeartBeat_Cached(&cache, CAN_UUID_BLDC_BASE, &heartbeat, NULL));
+    CHECK_EQUAL(heartbeat.error, 0x1234);
+    CHECK_EQUAL(heartbeat.state, 3);
+    CHECK(!CANUniversalPacket_HeartBeat_Cached(&cache, CAN_UUID_BLDC_SHOULDER, &heartbeat, NULL));
+
+    // A truncated packet leaves the entry as it was
+    packet = CANUniversalPacket_HeartBeat(bldc, jetson, 0x5678, 4);
+    packet.contentsLength = 2;
+    CHECK(!CANStateCacheUpdate(&cache, &packet, 0));
+    CHECK(CANUniversalPacket_HeartBeat_Cached(&cache, CAN_UUID_BLDC_BASE, &heartbeat, NULL));
+    CHECK_EQUAL(heartbeat.error, 0x1234);
+}
+
+static atomic_bool readDone;
+static CANPacket_t readPacket;
+static CANTimestamp_t readTimestamp;
+
+static void *readHeartbeat(void *context) {
+    (void)context;
+    CHECK(CANStateCacheRead(&cache, CAN_UUID_BLDC_BASE, CAN_COMMAND_ID__HEARTBEAT, &readPacket, &readTimestamp));
+    atomic_store(&readDone, true);
+    return NULL;
+}
+
+/**
+ * A reader arriving while the writer is between the two sequence stores waits for the write to finish
+ * and returns the new packet, never the half written one
+ */
+static void testReadDuringWrite(void) {
+    CANStateCacheInit(&cache);
+    CANPacket_t old = CANUniversalPacket_HeartBeat(bldc, jetson, 1, 1);
+    CHECK(CANStateCacheUpdate(&cache, &old, 100));
+
+    // The first half of an update by hand: odd sequence, half of the new words stored
+    CANPacket_t new = CANUniversalPacket_HeartBeat(bldc, jetson, 2, 2);
+    CANTimestamp_t newTimestamp = 200;
+    uint32_t words[CAN_STATE_CACHE_WORDS] = {0};
+    memcpy(words, &new, sizeof(CANPacket_t));
+    memcpy((uint8_t *)words + sizeof(CANPacket_t), &newTimestamp, sizeof(CANTimestamp_t));
+    CANStateCacheEntry_t *entry = &cache.entries[CAN_UUID_BLDC_BASE][CANUniversalPacket_HeartBeat_CacheSlot];
+    uint32_t sequence = atomic_load(&entry->sequence);
+    atomic_store(&entry->sequence, sequence + 1);
+    for (uint8_t word = 0; word < CAN_STATE_CACHE_WORDS / 2; ++word) {
+        atomic_store(&entry->words[word], words[word]);
+    }
+
+    atomic_store(&readDone, false);
+    pthread_t reader;
+    CHECK_EQUAL(pthread_create(&reader, NULL, readHeartbeat, NULL), 0);
+    nanosleep(&(struct timespec){.tv_nsec = 20000000}, NULL);
+    CHECK(!atomic_load(&readDone));
+
+    for (uint8_t word = CAN_STATE_CACHE_WORDS / 2; word < CAN_STATE_CACHE_WORDS; ++word) {
+        atomic_store(&entry->words[word], words[word]);
+    }
+    atomic_store(&entry->sequence, sequence + 2);
+    pthread_join(reader, NULL);
+    CHECK(atomic_load(&readDone));
+    CHECK(memcmp(&readPacket, &new, sizeof(CANPacket_t)) == 0);
+    CHECK_EQUAL(readTimestamp, newTimestamp);
+}
+
+static atomic_bool writing;
+
+static void *writeHeartbeats(void *context) {
+    (void)context;
+    for (uint32_t i = 1; i <= WRITES; ++i) {
+        CANPacket_t packet = CANUniversalPacket_HeartBeat(bldc, jetson, i, (uint8_t)i);
+        CANStateCacheUpdate(&cache, &packet, i);
+    }
+    atomic_store(&writing, false);
+    return NULL;
+}
+
+/**
+ * A reader racing a writer only ever sees whole packets, each one stored together with its timestamp,
+ * and never an older packet after a newer one
+ */
+static void testConcurrentReads(void) {
+    CANStateCacheInit(&cache);
+    atomic_store(&writing, true);
+    pthread_t writer;
+    CHECK_EQUAL(pthread_create(&writer, NULL, writeHeartbeats, NULL), 0);
+
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t last = 0;
+    while (atomic_load(&writing)) {
+        CANUniversalPacket_HeartBeat_Decoded_t heartbeat;
+        CANTimestamp_t timestamp;
+        if (!CANUniversalPacket_HeartBeat_Cached(&cache, CAN_UUID_BLDC_BASE, &heartbeat, &timestamp)) {
+            continue;
+        }
+        ++reads;
+        if (heartbeat.state != (uint8_t)heartbeat.error || timestamp != heartbeat.error || heartbeat.error < last) {
+            ++torn;
+        }
+        last = heartbeat.error;
+    }
+    pthread_join(writer, NULL);
+    CHECK(reads > 0);
+    CHECK_EQUAL(torn, 0);
+}
+
+int main(void) {
+    testReceive();
+    testReadDuringWrite();
+    testConcurrentReads();
+    return testResult("test_state_cache");
+}
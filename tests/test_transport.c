@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "../CANDevices.h"
+#include "../CANTransport.h"
+#include "../Ports/PortSim.h"
+
+#include <string.h>
+
+#define PAYLOAD_LENGTH 40
+
+static uint8_t payload[PAYLOAD_LENGTH];
+static int sendStatus;
+static int deliveries;
+
+static void onSent(uint8_t status, void *context) {
+    (void)context;
+    sendStatus = status;
+}
+
+static void onPayload(CANDeviceUUID_t sender, uint8_t tag, const uint8_t *data, uint16_t length, void *context) {
+    (void)sender;
+    (void)tag;
+    (void)context;
+    if (length == PAYLOAD_LENGTH && memcmp(data, payload, length) == 0) {
+        ++deliveries;
+    }
+}
+
+/**
+ * Fills the transmit queue of a node with frames nobody listens to, so its next CANSend fails
+ */
+static void fillQueue(CANSimNode_t *node) {
+    CANPacket_t filler = {0};
+    CANSetPacketHeader(&filler, 0x7F << 3);
+    while (CANSend(node, &filler) == CAN_OK) {
+    }
+}
+
+/**
+ * Sends the payload while the receiver drops its consecutive frame number dropFrame (0 for none)
+ * and has a full transmit queue when it handles consecutive frame number fullFrame (0 for never)
+ * Runs for one simulated second, so stalled transfers time out
+ */
+static void runTransfer(uint8_t blockSize, int dropFrame, int fullFrame) {
+    CANSimBus_t bus;
+    CANSimBusInit(&bus, 1000000);
+    CANDevice_t jetson = {.deviceUUID = CAN_UUID_JETSON};
+    CANDevice_t bldc = {.motorDomain = 1, .deviceUUID = CAN_UUID_BLDC_BASE};
+    CANSimNode_t senderNode = {.bus = &bus};
+    CANSimNode_t receiverNode = {.bus = &bus};
+    CANInit(&senderNode, &jetson);
+    CANInit(&receiverNode, &bldc);
+
+    CANTransport_t sender;
+    CANTransport_t receiver;
+    CANTransportInit(&sender, &senderNode, jetson, 0, 0, 100000);
+    CANTransportInit(&receiver, &receiverNode, bldc, blockSize, 0, 100000);
+    CANTransportSetReceiveCallback(&receiver, onPayload, NULL);
+    sendStatus = -1;
+    deliveries = 0;
+    CHECK_EQUAL(CANTransportSend(&sender, bldc, 7, payload, PAYLOAD_LENGTH, onSent, NULL), CAN_OK);
+
+    int consecutive = 0;
+    for (uint64_t time = 0; time < 1000000000; time += 100000) {
+        CANSimBusRunUntil(&bus, time);
+        CANPacket_t packet;
+        while (CANPollAndReceive(&receiverNode, &packet) > 0) {
+            if ((packet.command & 0x7F) == CAN_COMMAND_ID__TRANSPORT_CONSECUTIVE) {
+                if (++consecutive == dropFrame) {
+                    continue;
+                }
+                if (consecutive == fullFrame) {
+                    fillQueue(&receiverNode);
+                }
+            }
+            CANTransportHandlePacket(&receiver, &packet);
+        }
+        while (CANPollAndReceive(&senderNode, &packet) > 0) {
+            CANTransportHandlePacket(&sender, &packet);
+        }
+        CANTransportPoll(&sender);
+        CANTransportPoll(&receiver);
+    }
+}
+
+static void testTransfer(void) {
+    runTransfer(0, 0, 0);
+    CHECK_EQUAL(sendStatus, CAN_OK);
+    CHECK_EQUAL(deliveries, 1);
+
+    runTransfer(2, 0, 0);
+    CHECK_EQUAL(sendStatus, CAN_OK);
+    CHECK_EQUAL(deliveries, 1);
+}
+
+static void testLostFrame(void) {
+    // Streaming without flow control, the receiver sees the gap at the next frame and aborts the sender
+    runTransfer(0, 3, 0);
+    CHECK_EQUAL(sendStatus, CAN_ERROR);
+    CHECK_EQUAL(deliveries, 0);
+
+    // Nothing follows the last frame, so neither side sees a gap and the sender times out
+    runTransfer(0, (PAYLOAD_LENGTH - CAN_TRANSPORT_FIRST_DATA_LEN + CAN_TRANSPORT_CONSECUTIVE_DATA_LEN - 1) /
+                CAN_TRANSPORT_CONSECUTIVE_DATA_LEN, 0);
+    CHECK_EQUAL(sendStatus, CAN_TIMEOUT);
+    CHECK_EQUAL(deliveries, 0);
+}
+
+static void testFullQueue(void) {
+    int frames = (PAYLOAD_LENGTH - CAN_TRANSPORT_FIRST_DATA_LEN + CAN_TRANSPORT_CONSECUTIVE_DATA_LEN - 1) /
+                 CAN_TRANSPORT_CONSECUTIVE_DATA_LEN;
+
+    // The abort after a gap waits for room in the queue instead of leaving the sender to time out
+    runTransfer(0, 2, 3);
+    CHECK_EQUAL(sendStatus, CAN_ERROR);
+    CHECK_EQUAL(deliveries, 0);
+
+    // So does the confirmation of the last frame, and continuing after a block
+    runTransfer(0, 0, frames);
+    CHECK_EQUAL(sendStatus, CAN_OK);
+    CHECK_EQUAL(deliveries, 1);
+
+    runTransfer(2, 0, 2);
+    CHECK_EQUAL(sendStatus, CAN_OK);
+    CHECK_EQUAL(deliveries, 1);
+}
+
+int main(void) {
+    for (int i = 0; i < PAYLOAD_LENGTH; ++i) {
+        payload[i] = (uint8_t)(i * 37 + 1);
+    }
+    testTransfer();
+    testLostFrame();
+    testFullQueue();
+    return testResult("test_transport");
+}